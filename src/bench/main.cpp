@@ -0,0 +1,689 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <engine/engine.h>
+
+// Headless render benchmark, also usable as a golden image test:
+//   stabby_render_bench [--frames N] [--size WxH] [--write-dir DIR]
+//                       [--golden-dir DIR] [--tolerance T]
+//                       [--backend gl|recording] [--shader-cache DIR]
+// With --write-dir the last frame of every scenario is written as a PAM
+// image, with --golden-dir it is compared against one and the exit code is
+// non-zero on mismatch. The recording backend skips all GPU work, which
+// isolates the CPU cost of culling and batching.
+
+namespace {
+
+struct Options {
+  int frames = 200;
+  int width = 1280;
+  int height = 720;
+  std::string writeDir;
+  std::string goldenDir;
+  std::string shaderCacheDir;
+  int tolerance = 2;
+  bool recording = false;
+};
+
+struct Scenario {
+  std::string name;
+  std::function<void()> render;
+};
+
+struct Resources {
+  std::shared_ptr<ste::Renderer2D> renderer;
+  std::shared_ptr<ste::TextRenderer> textRenderer;
+  std::optional<ste::Font> font;
+  // Sizes of one SDF face, drawn from a shared atlas
+  std::vector<ste::Font> sdfFonts;
+  std::optional<ste::Texture> texture;
+  std::optional<ste::Map> map;
+  std::shared_ptr<ste::TilemapRenderer> tilemapRenderer;
+  std::shared_ptr<ste::LightRenderer> lightRenderer;
+  std::vector<ste::Light> lights;
+  std::shared_ptr<ste::ParticleRenderer> particleRenderer;
+  std::vector<ste::ParticleEmitter> emitters;
+  std::vector<ste::Renderer2D::QuadDesc> quads;
+  glm::mat4 screenProjection{1.0f};
+  // Shared by the scenarios made of several passes, its pool persists
+  ste::RenderGraph renderGraph;
+};
+
+bool parseOptions(int argc, char *argv[], Options &options) {
+  for (int i = 1; i < argc; i++) {
+    const bool hasValue = i + 1 < argc;
+    if (!std::strcmp(argv[i], "--frames") && hasValue) {
+      options.frames = std::max(1, std::atoi(argv[++i]));
+    } else if (!std::strcmp(argv[i], "--size") && hasValue) {
+      if (std::sscanf(argv[++i], "%dx%d", &options.width, &options.height) !=
+          2) {
+        return false;
+      }
+    } else if (!std::strcmp(argv[i], "--write-dir") && hasValue) {
+      options.writeDir = argv[++i];
+    } else if (!std::strcmp(argv[i], "--golden-dir") && hasValue) {
+      options.goldenDir = argv[++i];
+    } else if (!std::strcmp(argv[i], "--shader-cache") && hasValue) {
+      options.shaderCacheDir = argv[++i];
+    } else if (!std::strcmp(argv[i], "--tolerance") && hasValue) {
+      options.tolerance = std::atoi(argv[++i]);
+    } else if (!std::strcmp(argv[i], "--backend") && hasValue) {
+      const std::string backend = argv[++i];
+      if (backend != "gl" && backend != "recording") {
+        return false;
+      }
+      options.recording = backend == "recording";
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Same content every run so frames can be compared against golden images
+void generateQuads(Resources &resources, const Options &options) {
+  std::mt19937 rng(1337);
+  std::uniform_real_distribution<float> x(0.0f, options.width);
+  std::uniform_real_distribution<float> y(0.0f, options.height);
+  std::uniform_real_distribution<float> size(4.0f, 24.0f);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+  resources.quads.resize(20000);
+  for (size_t i = 0; i < resources.quads.size(); i++) {
+    auto &quad = resources.quads[i];
+    quad.position = {x(rng), y(rng), 0.0f};
+    quad.size = {size(rng), size(rng)};
+    quad.color = {unit(rng), unit(rng), unit(rng), 0.8f};
+    quad.origin = {0.5f, 0.5f};
+    quad.rotation = i % 2 == 0 ? unit(rng) * 6.2831853f : 0.0f;
+  }
+}
+
+void generateMap(Resources &resources) {
+  // A large grid, most of it outside the view to exercise culling
+  ste::Map map;
+  map.addLayer("background");
+  for (int y = 0; y < 200; y++) {
+    for (int x = 0; x < 200; x++) {
+      map.addTile("background", (x + y) % 4, {x * 32.0f, y * 32.0f},
+                  {32.0f, 32.0f});
+    }
+  }
+  resources.map = std::move(map);
+}
+
+void generateTilemap(Resources &resources) {
+  // One texel per tile type with the same shades the "map" scenario uses
+  uint8_t shades[4 * 4];
+  for (int type = 0; type < 4; type++) {
+    const auto shade = static_cast<uint8_t>((0.4f + 0.15f * type) * 255.0f);
+    shades[type * 4 + 0] = shade;
+    shades[type * 4 + 1] = shade;
+    shades[type * 4 + 2] = shade;
+    shades[type * 4 + 3] = 255;
+  }
+
+  uint32_t atlas;
+  glGenTextures(1, &atlas);
+  ste::GLStateCache::get().bindTexture(atlas);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 4, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+               shades);
+
+  ste::TilemapRenderer::CreateInfo tilemapInfo;
+  tilemapInfo.atlasTexture = atlas;
+  tilemapInfo.atlasTiles = {4, 1};
+  resources.tilemapRenderer = ste::TilemapRenderer::create(tilemapInfo);
+  if (!resources.tilemapRenderer) {
+    std::cerr << "Skipping map_gpu: " << tilemapInfo.errorMsg << std::endl;
+    return;
+  }
+  resources.tilemapRenderer->build(*resources.map);
+}
+
+void generateLights(Resources &resources, const Options &options) {
+  ste::LightRenderer::CreateInfo lightInfo;
+  resources.lightRenderer = ste::LightRenderer::create(lightInfo);
+  if (!resources.lightRenderer) {
+    std::cerr << "Skipping lights: " << lightInfo.errorMsg << std::endl;
+    return;
+  }
+
+  // Hundreds of small lights, every third one a spot light
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  for (int i = 0; i < 500; i++) {
+    ste::Light light;
+    light.position = {unit(rng) * options.width, unit(rng) * options.height};
+    light.radius = 24.0f + unit(rng) * 72.0f;
+    light.intensity = 0.4f;
+    light.color = {unit(rng), unit(rng), unit(rng)};
+    if (i % 3 == 0) {
+      light.direction = {unit(rng) - 0.5f, unit(rng) - 0.5f};
+      light.innerAngle = 0.3f;
+      light.outerAngle = 0.7f;
+    }
+    resources.lights.push_back(light);
+  }
+}
+
+void generateEmitters(Resources &resources, const Options &options) {
+  ste::EmitterDesc desc;
+  desc.capacity = 5000;
+  desc.emissionRate = 0.0f;
+  desc.lifetimeMin = 1.0f;
+  desc.lifetimeMax = 3.0f;
+  desc.velocityMin = {-80.0f, -120.0f};
+  desc.velocityMax = {80.0f, 0.0f};
+  desc.gravity = {0.0f, 60.0f};
+  desc.spinMin = -3.0f;
+  desc.spinMax = 3.0f;
+  desc.colorCurve = {{0.0f, {1.0f, 0.8f, 0.2f, 1.0f}},
+                     {0.5f, {1.0f, 0.3f, 0.1f, 0.8f}},
+                     {1.0f, {0.2f, 0.2f, 0.2f, 0.0f}}};
+  desc.sizeCurve = {{0.0f, 2.0f}, {0.3f, 8.0f}, {1.0f, 4.0f}};
+
+  for (int i = 0; i < 4; i++) {
+    ste::ParticleEmitter emitter(desc);
+    emitter.setPosition(
+        {options.width * (i + 1) / 5.0f, options.height / 2.0f});
+    resources.emitters.push_back(std::move(emitter));
+  }
+}
+
+std::vector<Scenario> buildScenarios(Resources &resources,
+                                     const Options &options) {
+  auto &renderer = *resources.renderer;
+  std::vector<Scenario> scenarios;
+
+  scenarios.push_back({"quads", [&]() {
+                         renderer.beginScene(resources.screenProjection);
+                         for (const auto &quad : resources.quads) {
+                           renderer.drawQuad(quad.position, quad.size,
+                                             quad.color, quad.rotation,
+                                             quad.origin);
+                         }
+                         renderer.endScene();
+                       }});
+
+  scenarios.push_back({"quads_batched", [&]() {
+                         renderer.beginScene(resources.screenProjection);
+                         renderer.drawQuads(resources.quads);
+                         renderer.endScene();
+                       }});
+
+  // The quads at half resolution, stretched over the output the way
+  // dynamic resolution does when the GPU is over budget
+  ste::DynamicResolution::CreateInfo resolutionInfo;
+  resolutionInfo.width = options.width;
+  resolutionInfo.height = options.height;
+  if (auto resolution = ste::DynamicResolution::create(resolutionInfo)) {
+    resolution->setAutoScale(false);
+    resolution->setScale(0.5f);
+    scenarios.push_back(
+        {"quads_half_res", [&, resolution]() {
+           auto &graph = resources.renderGraph;
+           const auto world = resolution->createTarget(graph);
+
+           ste::RenderGraph::PassDesc desc;
+           desc.name = "Quads";
+           desc.write = world;
+           desc.clearColor = glm::vec4(0.1f, 0.1f, 0.1f, 1.0f);
+           desc.viewport = resolution->getRenderSize();
+           graph.addPass(std::move(desc),
+                         [&](const ste::RenderGraph::PassContext &) {
+                           renderer.beginScene(resources.screenProjection);
+                           renderer.drawQuads(resources.quads);
+                           renderer.endScene();
+                         });
+
+           resolution->addPresentPass(graph, world);
+           graph.execute(options.width, options.height);
+         }});
+  } else {
+    std::cerr << "Skipping quads_half_res: " << resolutionInfo.errorMsg
+              << std::endl;
+  }
+
+  // Full screen background layers under translucent and opaque sprites,
+  // every other sprite is opaque. The depth sorted variant draws the opaque
+  // quads front to back and has to match the plain one pixel for pixel, so
+  // depth follows the drawing order.
+  std::vector<ste::Renderer2D::QuadDesc> layerSprites(
+      resources.quads.begin(),
+      resources.quads.begin() + std::min<size_t>(resources.quads.size(), 4000));
+  for (size_t i = 0; i < layerSprites.size(); i++) {
+    layerSprites[i].position.z = 0.9f * i / layerSprites.size();
+    if (i % 2 == 0) {
+      layerSprites[i].color.w = 1.0f;
+    }
+  }
+  auto drawLayers = [&, layerSprites](bool depthSorting) {
+    renderer.setDepthSortingEnabled(depthSorting);
+    renderer.beginScene(resources.screenProjection);
+    const glm::vec2 screenSize = {static_cast<float>(options.width),
+                                  static_cast<float>(options.height)};
+    for (int layer = 0; layer < 6; layer++) {
+      const float shade = 0.2f + 0.1f * layer;
+      renderer.drawQuad(glm::vec3(0.0f, 0.0f, -0.9f + 0.15f * layer),
+                        screenSize, {shade, shade * 0.8f, shade * 0.6f, 1.0f});
+    }
+    renderer.drawQuads(layerSprites);
+    renderer.endScene();
+    renderer.setDepthSortingEnabled(false);
+  };
+  scenarios.push_back({"layers", [=]() { drawLayers(false); }});
+  scenarios.push_back({"layers_depth", [=]() { drawLayers(true); }});
+
+  if (resources.texture) {
+    scenarios.push_back(
+        {"sprites", [&]() {
+           const ste::Renderer2D::TextureInfo info{
+               resources.texture->getId(), resources.texture->getWidth(),
+               resources.texture->getHeight()};
+           renderer.beginScene(resources.screenProjection);
+           for (size_t i = 0; i < resources.quads.size(); i += 4) {
+             const auto &quad = resources.quads[i];
+             renderer.drawTexturedQuad(quad.position, info, {32.0f, 32.0f},
+                                       {1.0f, 1.0f, 1.0f, 1.0f}, quad.rotation,
+                                       {0.5f, 0.5f});
+           }
+           renderer.endScene();
+         }});
+  }
+
+  if (resources.font) {
+    scenarios.push_back(
+        {"text", [&]() {
+           renderer.beginScene(resources.screenProjection);
+           const float lineHeight = resources.font->getLineHeight();
+           for (int line = 0; line * lineHeight < options.height; line++) {
+             resources.textRenderer->renderText(
+                 *resources.font,
+                 "The quick brown fox jumps over the lazy dog " +
+                     std::to_string(line),
+                 {8.0f, line * lineHeight});
+           }
+           renderer.endScene();
+         }});
+  }
+
+  if (resources.font) {
+    // Same lines as "text" laid out once, every frame only copies them
+    auto labels = std::make_shared<std::vector<ste::Text>>();
+    const float lineHeight = resources.font->getLineHeight();
+    for (int line = 0; line * lineHeight < options.height; line++) {
+      labels->push_back(resources.textRenderer->createText(
+          *resources.font,
+          "The quick brown fox jumps over the lazy dog " +
+              std::to_string(line),
+          {8.0f, line * lineHeight}));
+    }
+    scenarios.push_back({"text_cached", [&, labels]() {
+                           renderer.beginScene(resources.screenProjection);
+                           for (auto &label : *labels) {
+                             label.render();
+                           }
+                           renderer.endScene();
+                         }});
+  }
+
+  if (!resources.sdfFonts.empty()) {
+    // Lines of every SDF size, all glyphs come from the same atlas pages
+    scenarios.push_back(
+        {"text_sdf", [&]() {
+           renderer.beginScene(resources.screenProjection);
+           float y = 0.0f;
+           for (int line = 0; y < options.height; line++) {
+             auto &font = resources.sdfFonts[line % resources.sdfFonts.size()];
+             resources.textRenderer->renderText(
+                 font,
+                 "The quick brown fox jumps over the lazy dog " +
+                     std::to_string(line),
+                 {8.0f, y});
+             y += font.getLineHeight();
+           }
+           renderer.endScene();
+         }});
+  }
+
+  if (resources.font) {
+    // A text heavy HUD panel drawn live every frame and from its cached
+    // target, both have to look the same
+    auto drawHud = [&](ste::Renderer2D &hudRenderer) {
+      const glm::vec2 size = {options.width * 0.5f, options.height * 0.75f};
+      hudRenderer.drawQuad(glm::vec2(0.0f), size, {0.0f, 0.0f, 0.0f, 0.5f});
+      hudRenderer.drawRect(glm::vec2(0.0f), size, {1.0f, 1.0f, 1.0f, 1.0f});
+      const float lineHeight = resources.font->getLineHeight();
+      for (int line = 0; (line + 1) * lineHeight < size.y; line++) {
+        resources.textRenderer->renderText(
+            *resources.font,
+            "Inventory slot " + std::to_string(line) +
+                ": a rather long item description that gets clipped",
+            {8.0f, 4.0f + line * lineHeight}, {1.0f, 0.9f, 0.6f, 1.0f});
+      }
+    };
+    for (const bool cached : {false, true}) {
+      auto ui = std::make_shared<ste::UILayer>(resources.renderer);
+      ui->addPanel({.position = {options.width / 4, options.height / 8},
+                    .size = {options.width * 0.5f, options.height * 0.75f},
+                    .draw = drawHud,
+                    .cached = cached});
+      scenarios.push_back({cached ? "hud_cached" : "hud", [&, ui]() {
+                             renderer.beginScene(resources.screenProjection);
+                             renderer.drawQuads(
+                                 std::span(resources.quads).first(2000));
+                             renderer.endScene();
+                             ui->addPasses(resources.renderGraph);
+                             resources.renderGraph.execute(options.width,
+                                                           options.height);
+                           }});
+    }
+  }
+
+  if (resources.map) {
+    scenarios.push_back(
+        {"map", [&]() {
+           ste::Camera2D camera(options.width, options.height);
+           camera.setPosition({3200.0f, 3200.0f});
+           renderer.beginScene(camera.getViewProjectionMatrix());
+           for (const auto &layer : resources.map->layers()) {
+             for (const auto &tile : layer.getTiles()) {
+               const float shade = 0.4f + 0.15f * tile.getTileType();
+               renderer.drawQuad(tile.getPosition(), tile.getSize(),
+                                 {shade, shade, shade, 1.0f});
+             }
+           }
+           renderer.endScene();
+         }});
+  }
+
+  if (resources.tilemapRenderer) {
+    scenarios.push_back(
+        {"map_gpu", [&]() {
+           ste::Camera2D camera(options.width, options.height);
+           camera.setPosition({3200.0f, 3200.0f});
+           renderer.beginScene(camera.getViewProjectionMatrix());
+           resources.tilemapRenderer->draw(renderer.getViewBounds());
+           renderer.endScene();
+         }});
+
+    // Every chunk of the map in view, one multi-draw against one draw per
+    // chunk. Both render the same image.
+    const auto drawWholeMap = [&](bool multiDrawIndirect) {
+      auto &tilemap = *resources.tilemapRenderer;
+      tilemap.setMultiDrawIndirect(multiDrawIndirect);
+      renderer.beginScene(
+          glm::ortho(0.0f, 6400.0f, 6400.0f, 0.0f, -1.0f, 1.0f));
+      tilemap.draw(renderer.getViewBounds());
+      renderer.endScene();
+      tilemap.setMultiDrawIndirect(true);
+    };
+    scenarios.push_back({"map_gpu_all", [=]() { drawWholeMap(true); }});
+    scenarios.push_back(
+        {"map_gpu_all_loop", [=]() { drawWholeMap(false); }});
+  }
+
+  if (resources.lightRenderer) {
+    scenarios.push_back(
+        {"lights", [&]() {
+           renderer.beginScene(resources.screenProjection);
+           renderer.drawQuad(glm::vec2(0.0f),
+                             {static_cast<float>(options.width),
+                              static_cast<float>(options.height)},
+                             {0.8f, 0.8f, 0.8f, 1.0f});
+           renderer.endScene();
+
+           auto &lights = *resources.lightRenderer;
+           lights.clear();
+           for (const auto &light : resources.lights) {
+             lights.addLight(light);
+           }
+           lights.addPasses(resources.renderGraph,
+                            ste::RenderGraph::BACKBUFFER,
+                            resources.screenProjection);
+           resources.renderGraph.execute(options.width, options.height);
+         }});
+  }
+
+  if (resources.particleRenderer) {
+    scenarios.push_back(
+        {"particles", [&]() {
+           // Fixed step so the frame stays reproducible for golden images
+           for (auto &emitter : resources.emitters) {
+             emitter.burst(emitter.getCapacity());
+             emitter.update(1.0f / 60.0f);
+           }
+           renderer.beginScene(resources.screenProjection);
+           renderer.endScene();
+           for (const auto &emitter : resources.emitters) {
+             resources.particleRenderer->draw(emitter);
+           }
+         }});
+  }
+
+  return scenarios;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    std::cerr << "Usage: " << argv[0]
+              << " [--frames N] [--size WxH] [--write-dir DIR]"
+                 " [--golden-dir DIR] [--tolerance T]"
+                 " [--backend gl|recording] [--shader-cache DIR]"
+              << std::endl;
+    return 2;
+  }
+
+  ste::HeadlessContext::CreateInfo contextInfo;
+  contextInfo.width = options.width;
+  contextInfo.height = options.height;
+  auto context = ste::HeadlessContext::create(contextInfo);
+  if (!context) {
+    std::cerr << "Failed to create headless context: " << contextInfo.errorMsg
+              << std::endl;
+    return 1;
+  }
+
+  std::cout << "GL_RENDERER: " << glGetString(GL_RENDERER) << std::endl;
+
+  auto &programCache = ste::ProgramCache::get();
+  if (!options.shaderCacheDir.empty() &&
+      !programCache.setDirectory(options.shaderCacheDir)) {
+    std::cerr << "Program binaries not supported, shader cache disabled"
+              << std::endl;
+  }
+  const auto startupStart = std::chrono::steady_clock::now();
+
+  Resources resources;
+  ste::Renderer2D::CreateInfo rendererInfo;
+  if (options.recording) {
+    // Nothing gets drawn, so there is nothing to compare either
+    rendererInfo.backend = std::make_shared<ste::RecordingRenderBackend>();
+    options.writeDir.clear();
+    options.goldenDir.clear();
+  }
+  resources.renderer = ste::Renderer2D::create(rendererInfo);
+  if (!resources.renderer) {
+    std::cerr << "Failed to create renderer: " << rendererInfo.errorMsg
+              << std::endl;
+    return 1;
+  }
+  std::cout << "Backend: " << resources.renderer->getBackend().getName()
+            << std::endl;
+  if (!options.recording) {
+    ste::ParticleRenderer::CreateInfo particleInfo;
+    resources.particleRenderer = ste::ParticleRenderer::create(particleInfo);
+    if (!resources.particleRenderer) {
+      std::cerr << "Skipping particles: " << particleInfo.errorMsg
+                << std::endl;
+    }
+  }
+  resources.textRenderer =
+      std::make_shared<ste::TextRenderer>(resources.renderer);
+  resources.screenProjection =
+      glm::ortho(0.0f, static_cast<float>(options.width),
+                 static_cast<float>(options.height), 0.0f, -1.0f, 1.0f);
+
+  // Optional assets, scenarios that need a missing one are skipped
+  ste::Font::CreateInfo fontInfo;
+  fontInfo.size = 16;
+  resources.font = ste::Font::createFromFile(
+      ste::getAssetPath("fonts/better-vcr.ttf"), fontInfo);
+  if (!resources.font) {
+    std::cerr << "Skipping text: " << fontInfo.errorMsg << std::endl;
+  }
+
+  for (const uint32_t size : {12u, 16u, 24u, 40u}) {
+    ste::Font::CreateInfo sdfInfo;
+    sdfInfo.size = size;
+    sdfInfo.sdf = true;
+    auto font = ste::Font::createFromFile(
+        ste::getAssetPath("fonts/better-vcr.ttf"), sdfInfo);
+    if (!font) {
+      std::cerr << "Skipping SDF text: " << sdfInfo.errorMsg << std::endl;
+      resources.sdfFonts.clear();
+      break;
+    }
+    resources.sdfFonts.push_back(std::move(*font));
+  }
+
+  // Printable ASCII is ready before the first frame, the SDF sizes share
+  // one atlas so warming one warms all
+  const ste::Font::CodepointRange ascii[] = {{0x20, 0x7e}};
+  if (resources.font) {
+    resources.font->prewarm(ascii);
+  }
+  if (!resources.sdfFonts.empty()) {
+    resources.sdfFonts.front().prewarm(ascii);
+  }
+
+  ste::Texture::CreateInfo textureInfo;
+  resources.texture = ste::Texture::createFromFile(
+      ste::getAssetPath("textures/albert.png"), textureInfo);
+  if (!resources.texture) {
+    std::cerr << "Skipping sprites: " << textureInfo.errorMsg << std::endl;
+  }
+
+  const double startupMs = std::chrono::duration<double, std::milli>(
+                               std::chrono::steady_clock::now() - startupStart)
+                               .count();
+
+  generateQuads(resources, options);
+  generateMap(resources);
+  if (!options.recording) {
+    generateTilemap(resources);
+    generateLights(resources, options);
+  }
+  generateEmitters(resources, options);
+
+  const auto cacheStats = programCache.getStats();
+  std::printf("Renderer setup: %.3f ms, program cache %u hits %u misses\n",
+              startupMs, cacheStats.hits, cacheStats.misses);
+
+  auto &profiler = ste::RenderProfiler::get();
+  profiler.setEnabled(true);
+
+  bool goldenMismatch = false;
+  std::printf("%-16s %10s %10s %8s %10s %10s\n", "scenario", "cpu ms",
+              "gpu ms", "draws", "quads", "culled");
+
+  for (const auto &scenario : buildScenarios(resources, options)) {
+    double gpuMs = 0.0;
+    int gpuSamples = 0;
+    ste::Renderer2D::Statistics stats;
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < options.frames; frame++) {
+      profiler.beginFrame();
+      resources.renderer->resetStats();
+      if (resources.particleRenderer) {
+        resources.particleRenderer->resetStats();
+      }
+      if (resources.tilemapRenderer) {
+        resources.tilemapRenderer->resetStats();
+      }
+
+      context->clearColor(0.1f, 0.1f, 0.1f, 1.0f);
+      scenario.render();
+
+      stats = resources.renderer->getStats();
+      if (resources.particleRenderer) {
+        // Particles count as quads, one instanced draw per emitter
+        const auto particleStats = resources.particleRenderer->getStats();
+        stats.drawCalls += particleStats.drawCalls;
+        stats.quadCount += particleStats.particleCount;
+      }
+      if (resources.tilemapRenderer) {
+        // A chunk is one quad
+        const auto tilemapStats = resources.tilemapRenderer->getStats();
+        stats.drawCalls += tilemapStats.drawCalls;
+        stats.quadCount += tilemapStats.chunksDrawn;
+        stats.culledQuads += tilemapStats.culledChunks;
+      }
+      profiler.endFrame();
+
+      // Keep the GPU in lock step so CPU time includes the actual rendering
+      glFinish();
+
+      const auto &report = profiler.getLastReport();
+      if (frame >= static_cast<int>(ste::RenderProfiler::FRAME_LATENCY)) {
+        gpuMs += report.gpuFrameMs;
+        gpuSamples++;
+      }
+    }
+    const double cpuMs = std::chrono::duration<double, std::milli>(
+                             std::chrono::steady_clock::now() - start)
+                             .count() /
+                         options.frames;
+
+    std::printf("%-16s %10.3f %10.3f %8u %10u %10u\n", scenario.name.c_str(),
+                cpuMs, gpuSamples > 0 ? gpuMs / gpuSamples : 0.0,
+                stats.drawCalls, stats.quadCount, stats.culledQuads);
+
+    const ste::Image image = context->readPixels();
+    if (!options.writeDir.empty()) {
+      const std::string path = options.writeDir + "/" + scenario.name + ".pam";
+      if (!image.writePAM(path)) {
+        std::cerr << "Failed to write " << path << std::endl;
+      }
+    }
+
+    if (!options.goldenDir.empty()) {
+      const std::string path =
+          options.goldenDir + "/" + scenario.name + ".pam";
+      auto golden = ste::Image::readPAM(path);
+      if (!golden) {
+        std::cerr << "Missing golden image " << path << std::endl;
+        goldenMismatch = true;
+        continue;
+      }
+
+      const ste::ImageDiff diff = ste::compareImages(
+          image, *golden, static_cast<uint8_t>(options.tolerance));
+      if (diff.sizeMismatch || diff.mismatchedPixels > 0) {
+        std::cerr << scenario.name << ": " << diff.mismatchedPixels
+                  << " pixels differ from the golden image (max delta "
+                  << static_cast<int>(diff.maxChannelDelta) << ")"
+                  << std::endl;
+        goldenMismatch = true;
+      }
+    }
+  }
+
+  return goldenMismatch ? 1 : 0;
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <filesystem>
 #include <iomanip>
 #include <map>
 #include <sstream>
@@ -27,10 +28,21 @@ struct Level {
   ste::Map map;
 };
 
+struct DebugOverlay {
+  ste::UILayer::PanelId panel = 0;
+  float lastRefresh = 0.0f;
+  // The stats are redrawn a few times a second, in between the cached panel
+  // is a single quad
+  float refreshInterval = 0.25f;
+};
+
 struct EditorState {
   Level currentLevel;
   Tools tools;
   bool debugMode = true;
+  DebugOverlay debugOverlay;
+  // This frame's dynamic resolution target in the render graph
+  ste::RenderGraph::Resource worldTarget = ste::RenderGraph::BACKBUFFER;
 };
 
 struct PlaceObject {
@@ -52,6 +64,13 @@ bool setupDefaultResources(ste::World &world) {
     return -1;
   }
 
+  // Cache linked shader programs between runs
+  if (char *prefPath = SDL_GetPrefPath("stabby", "editor")) {
+    ste::ProgramCache::get().setDirectory(std::filesystem::path(prefPath) /
+                                          "shader_cache");
+    SDL_free(prefPath);
+  }
+
   // Create an asset loader
   ste::AssetLoader::CreateInfo assetCreateInfo;
   auto assetLoader = ste::AssetLoader::create(assetCreateInfo);
@@ -72,8 +91,35 @@ bool setupDefaultResources(ste::World &world) {
     return false;
   }
 
+  // Map tiles are drawn from per-chunk index textures
+  ste::TilemapRenderer::CreateInfo tilemapCreateInfo;
+  auto tilemapRenderer = ste::TilemapRenderer::create(tilemapCreateInfo);
+  if (!tilemapRenderer) {
+    std::cerr << "Failed to create tilemap renderer: "
+              << tilemapCreateInfo.errorMsg << std::endl;
+    return false;
+  }
+
+  // The world is rendered at a resolution that keeps the GPU within 60 fps
+  ste::DynamicResolution::CreateInfo resolutionCreateInfo;
+  resolutionCreateInfo.width = window->getWidth();
+  resolutionCreateInfo.height = window->getHeight();
+  resolutionCreateInfo.targetFrameMs = 1000.0f / 60.0f;
+  auto dynamicResolution =
+      ste::DynamicResolution::create(resolutionCreateInfo);
+  if (!dynamicResolution) {
+    std::cerr << "Failed to create dynamic resolution target: "
+              << resolutionCreateInfo.errorMsg << std::endl;
+    return false;
+  }
+
+  // Render systems declare passes, the graph runs them at the end of the
+  // frame
+  auto renderGraph = std::make_shared<ste::RenderGraph>();
+
   // Setup the systems
   auto textRenderer = std::make_shared<ste::TextRenderer>(renderer);
+  auto uiLayer = std::make_shared<ste::UILayer>(renderer);
   auto audioManager = std::make_shared<ste::AudioManager>();
   auto inputManager = std::make_shared<ste::InputManager>();
 
@@ -87,10 +133,14 @@ bool setupDefaultResources(ste::World &world) {
   world.addResource(assetManager);
   world.addResource(audioManager);
   world.addResource(camera);
+  world.addResource(dynamicResolution);
   world.addResource(inputManager);
   world.addResource(renderer);
+  world.addResource(renderGraph);
   world.addResource(textRenderer);
+  world.addResource(tilemapRenderer);
   world.addResource(timer);
+  world.addResource(uiLayer);
   world.addResource(window);
 
   return true;
@@ -129,6 +179,9 @@ bool loadAssets(ste::World &world) {
     auto editorState = world.getResource<EditorState>();
     editorState->currentLevel.name = "default";
     editorState->currentLevel.map = std::move(*defaultMap);
+
+    world.getResource<ste::TilemapRenderer>()->build(
+        editorState->currentLevel.map);
   } catch (const std::exception &e) {
     std::cerr << "Failed to load default map: " << e.what() << std::endl;
     return false;
@@ -201,26 +254,12 @@ void placementTool(ste::World &world) {
   }
 }
 
-void renderDebugStats(ste::World &world) {
-  auto editorState = world.getResource<EditorState>();
-  auto renderer = world.getResource<ste::Renderer2D>();
+void drawDebugStats(ste::World &world, ste::Renderer2D &renderer) {
   auto textRenderer = world.getResource<ste::TextRenderer>();
-  auto window = world.getResource<ste::Window>();
   auto assetManager = world.getResource<ste::AssetManager>();
-
-  auto font = assetManager->get<ste::Font>("font");
-
-  if (!editorState->debugMode)
-    return;
-
-  // Draw the FPS counter
   auto timer = world.getResource<ste::GameTimer>();
-  auto camera = world.getResource<ste::Camera2D>();
 
-  // Set up the UI projection
-  const auto uiProjection =
-      glm::ortho(0.0f, (float)window->getWidth(), (float)window->getHeight(),
-                 0.0f, -1.0f, 1.0f);
+  auto font = assetManager->get<ste::Font>("font");
 
   // Get the FPS as a string, truncate it to 4 decimal places
   std::stringstream ss;
@@ -231,24 +270,54 @@ void renderDebugStats(ste::World &world) {
       textRenderer->createText(*font, "FPS: " + std::string(truncatedFps),
                                {16.0f, 16.0f}, {1.0f, 1.0f, 1.0f, 1.0f});
 
-  renderer->beginScene(uiProjection);
-
   // Draw a background for the FPS counter based on the width and height of the
   // text
   auto textSize = fpsText.getSize();
   auto textPosition = fpsText.getPosition();
-  renderer->drawQuad({textPosition.x - 8.0f, textPosition.y - 8.0f, 0.0f},
-                     {textSize.x + 16.0f, textSize.y + 16.0f},
-                     {0.0f, 0.0f, 0.0f, 0.5f}, 0.0f, {0.0f, 0.0f}, 1.0f,
-                     {1.0f, 1.0f, 1.0f, 1.0f});
+  const glm::vec2 backgroundPosition = {textPosition.x - 8.0f,
+                                        textPosition.y - 8.0f};
+  const glm::vec2 backgroundSize = {textSize.x + 16.0f, textSize.y + 16.0f};
+  renderer.drawQuad(backgroundPosition, backgroundSize,
+                    {0.0f, 0.0f, 0.0f, 0.5f});
+  renderer.drawRect(backgroundPosition, backgroundSize,
+                    {1.0f, 1.0f, 1.0f, 1.0f});
 
   // Render the FPS counter
   fpsText.render();
 
-  renderer->endScene();
+  // Render the profiler overlay below it
+  ste::RenderProfiler::get().drawOverlay(renderer, *textRenderer, *font,
+                                         {16.0f, textPosition.y + textSize.y +
+                                                     24.0f});
 }
 
-void renderTools(ste::World &world) {
+void renderDebugStats(ste::World &world) {
+  auto editorState = world.getResource<EditorState>();
+  auto uiLayer = world.getResource<ste::UILayer>();
+  auto renderGraph = world.getResource<ste::RenderGraph>();
+  auto timer = world.getResource<ste::GameTimer>();
+
+  // The overlay lives in a cached UI panel, refreshed at a fixed rate
+  auto &overlay = editorState->debugOverlay;
+  if (overlay.panel == 0) {
+    overlay.panel = uiLayer->addPanel(
+        {.position = {0.0f, 0.0f},
+         .size = {480.0f, 360.0f},
+         .draw = [&world](ste::Renderer2D &renderer) {
+           drawDebugStats(world, renderer);
+         }});
+  }
+
+  uiLayer->setPanelVisible(overlay.panel, editorState->debugMode);
+  if (timer->getTotalTime() - overlay.lastRefresh >= overlay.refreshInterval) {
+    uiLayer->markDirty(overlay.panel);
+    overlay.lastRefresh = timer->getTotalTime();
+  }
+
+  uiLayer->addPasses(*renderGraph);
+}
+
+void drawTools(ste::World &world) {
   auto camera = world.getResource<ste::Camera2D>();
   auto editorState = world.getResource<EditorState>();
   auto renderer = world.getResource<ste::Renderer2D>();
@@ -258,38 +327,107 @@ void renderTools(ste::World &world) {
   // Begin drawing the scene
   renderer->beginScene(camera->getViewProjectionMatrix());
 
+  // One screen pixel in world units, keeps lines crisp at any zoom
+  const float pixel = 1.0f / camera->getZoom();
+  const glm::vec2 gridSize = placementTool.gridSize;
+
+  // Grid lines over the visible area, batched with the cursor into a single
+  // draw call
+  const AABB &view = renderer->getViewBounds();
+  const glm::vec4 gridColor = {1.0f, 1.0f, 1.0f, 0.08f};
+  if (view.max.x - view.min.x < gridSize.x * 512.0f &&
+      view.max.y - view.min.y < gridSize.y * 512.0f) {
+    for (float x = std::floor(view.min.x / gridSize.x) * gridSize.x;
+         x <= view.max.x; x += gridSize.x) {
+      renderer->drawLine({x, view.min.y}, {x, view.max.y}, gridColor, pixel);
+    }
+    for (float y = std::floor(view.min.y / gridSize.y) * gridSize.y;
+         y <= view.max.y; y += gridSize.y) {
+      renderer->drawLine({view.min.x, y}, {view.max.x, y}, gridColor, pixel);
+    }
+  }
+
   // Draw the placement tool cursor
-  renderer->drawQuad(
-      {placementTool.cursorPosition.x, placementTool.cursorPosition.y, 0.0f},
-      {placementTool.gridSize.x, placementTool.gridSize.y},
-      {1.0f, 1.0f, 1.0f, 0.1f}, 0.0f, {0.0f, 0.0f}, 2.0f,
-      {1.0f, 1.0f, 1.0f, 1.0f});
+  renderer->drawQuad(placementTool.cursorPosition, gridSize,
+                     {1.0f, 1.0f, 1.0f, 0.1f});
+  renderer->drawRect(placementTool.cursorPosition, gridSize,
+                     {1.0f, 1.0f, 1.0f, 1.0f}, 2.0f * pixel);
 
   // End drawing the scene
   renderer->endScene();
 }
 
-void renderMap(ste::World &world) {
+void drawMap(ste::World &world) {
   auto camera = world.getResource<ste::Camera2D>();
-  auto editorState = world.getResource<EditorState>();
-  auto map = &editorState->currentLevel.map;
   auto renderer = world.getResource<ste::Renderer2D>();
+  auto tilemapRenderer = world.getResource<ste::TilemapRenderer>();
 
-  // Begin drawing the scene
+  // Begin drawing the scene, this binds the camera for the tilemap too
   renderer->beginScene(camera->getViewProjectionMatrix());
 
-  // Draw the map
-  for (const auto &layer : map->layers()) {
-    for (const auto &tile : layer.getTiles()) {
-      auto position = tile.getPosition();
-      auto size = tile.getSize();
-      renderer->drawQuad({position.x, position.y, 0.0f}, {size.x, size.y},
-                         {1.0f, 1.0f, 1.0f, 1.0f});
-    }
+  // Draw the map, one draw per visible chunk
+  tilemapRenderer->draw(renderer->getViewBounds());
 
-    // End drawing the scene
-    renderer->endScene();
-  }
+  // End drawing the scene
+  renderer->endScene();
+}
+
+void renderTools(ste::World &world) {
+  auto dynamicResolution = world.getResource<ste::DynamicResolution>();
+  auto editorState = world.getResource<EditorState>();
+  auto renderGraph = world.getResource<ste::RenderGraph>();
+
+  ste::RenderGraph::PassDesc desc;
+  desc.name = "Tools";
+  desc.write = editorState->worldTarget;
+  desc.viewport = dynamicResolution->getRenderSize();
+  renderGraph->addPass(std::move(desc),
+                       [&world](const ste::RenderGraph::PassContext &) {
+                         drawTools(world);
+                       });
+}
+
+void beginWorldRendering(ste::World &world) {
+  auto dynamicResolution = world.getResource<ste::DynamicResolution>();
+  auto editorState = world.getResource<EditorState>();
+  auto renderGraph = world.getResource<ste::RenderGraph>();
+
+  // Adapt the world resolution to the last measured GPU frame time
+  dynamicResolution->update(
+      ste::RenderProfiler::get().getLastReport().gpuFrameMs);
+  editorState->worldTarget = dynamicResolution->createTarget(*renderGraph);
+}
+
+void presentWorldRendering(ste::World &world) {
+  auto dynamicResolution = world.getResource<ste::DynamicResolution>();
+  auto editorState = world.getResource<EditorState>();
+  auto renderGraph = world.getResource<ste::RenderGraph>();
+
+  // UI rendered after this stays at native resolution
+  dynamicResolution->addPresentPass(*renderGraph, editorState->worldTarget);
+}
+
+void renderMap(ste::World &world) {
+  auto dynamicResolution = world.getResource<ste::DynamicResolution>();
+  auto editorState = world.getResource<EditorState>();
+  auto renderGraph = world.getResource<ste::RenderGraph>();
+
+  ste::RenderGraph::PassDesc desc;
+  desc.name = "Map";
+  desc.write = editorState->worldTarget;
+  desc.clearColor = glm::vec4(0.361f, 0.361f, 0.471f, 1.0f);
+  desc.viewport = dynamicResolution->getRenderSize();
+  renderGraph->addPass(std::move(desc),
+                       [&world](const ste::RenderGraph::PassContext &) {
+                         drawMap(world);
+                       });
+}
+
+void executeRenderGraph(ste::World &world) {
+  auto renderGraph = world.getResource<ste::RenderGraph>();
+  auto window = world.getResource<ste::Window>();
+
+  renderGraph->execute(window->getWidth(), window->getHeight());
 }
 
 } // namespace systems
@@ -299,20 +437,23 @@ namespace handlers {
 void objectPlacement(ste::World &world, const editor::PlaceObject &event) {
   auto editorState = world.getResource<editor::EditorState>();
   auto map = &editorState->currentLevel.map;
+  auto tilemapRenderer = world.getResource<ste::TilemapRenderer>();
 
   auto gridSize = editorState->tools.placementTool.gridSize;
 
   // If there's a tile at the position + half grid since it's center
   // positions, remove it
-  if (auto tile = map->getTileAt({event.position.x + gridSize.x / 2.0f,
-                                  event.position.y + gridSize.y / 2.0f})) {
+  const glm::vec2 center = event.position + gridSize / 2.0f;
+  if (auto tile = map->getTileAt(center)) {
     std::cout << "Removing object at: " << event.position.x << ", "
               << event.position.y << std::endl;
     map->removeTile("background", tile->tileId);
+    tilemapRenderer->setTileAt("background", center, std::nullopt);
   } else {
     std::cout << "Placing object at: " << event.position.x << ", "
               << event.position.y << std::endl;
     auto tileId = map->addTile("background", 0, event.position, gridSize);
+    tilemapRenderer->setTileAt("background", center, 0);
   }
 }
 
@@ -15,9 +15,14 @@ int main(int argc, char *argv[]) {
   world.addSystem("Input Management", systems::inputManagement);
   world.addSystem("Placement Tool", systems::placementTool);
 
+  world.addRenderSystem("Begin World Rendering",
+                        systems::beginWorldRendering);
   world.addRenderSystem("Render Map", systems::renderMap);
   world.addRenderSystem("Render Tools", systems::renderTools);
+  world.addRenderSystem("Present World Rendering",
+                        systems::presentWorldRendering);
   world.addRenderSystem("Render Debug Stats", systems::renderDebugStats);
+  world.addRenderSystem("Execute Render Graph", systems::executeRenderGraph);
 
   world.subscribe<editor::PlaceObject>(handlers::objectPlacement);
 
@@ -25,6 +30,10 @@ int main(int argc, char *argv[]) {
   bool running = true;
   auto window = world.getResource<ste::Window>();
   auto timer = world.getResource<ste::GameTimer>();
+  auto renderer = world.getResource<ste::Renderer2D>();
+  auto assetLoader = world.getResource<ste::AssetLoader>();
+  auto &profiler = ste::RenderProfiler::get();
+  profiler.setEnabled(true);
 
   // The editor loop...
   while (running) {
@@ -40,16 +49,21 @@ int main(int argc, char *argv[]) {
       }
     }
 
+    // Finish background shader compiles and apply hot reloads
+    assetLoader->update();
+
+    // Start profiling the frame
+    profiler.beginFrame();
+    renderer->resetStats();
+
     // Update the world and it's systems
     world.update(timer->getDeltaTime());
 
-    // Clear the window
-    window->clearColor(0.361f, 0.361f, 0.471f, 1.0f);
-
-    // Render the world
+    // Render the world, the present pass covers the whole window
     world.render();
 
     // Swap the buffers
+    profiler.endFrame();
     window->swapBuffers();
 
     // Limit the frame rate
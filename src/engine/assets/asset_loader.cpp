@@ -1,5 +1,7 @@
 #include "asset_loader.h"
 
+#include <iostream>
+
 namespace ste {
 
 std::shared_ptr<AssetLoader> AssetLoader::create(CreateInfo &createInfo) {
@@ -19,9 +21,12 @@ AssetLoader::~AssetLoader() { clear(); }
 
 AssetLoader::AssetLoader(AssetLoader &&other) noexcept
     : m_threadPool(std::move(other.m_threadPool)),
-      m_assets(std::move(other.m_assets)),
       m_totalAssets(other.m_totalAssets.load()),
-      m_loadedAssets(other.m_loadedAssets.load()) {}
+      m_loadedAssets(other.m_loadedAssets.load()) {
+  std::lock_guard<std::mutex> otherLock(other.m_assetsMutex);
+  m_assets = std::move(other.m_assets);
+  takeHotReload(other);
+}
 
 AssetLoader &AssetLoader::operator=(AssetLoader &&other) noexcept {
   if (this != &other) {
@@ -30,9 +35,11 @@ AssetLoader &AssetLoader::operator=(AssetLoader &&other) noexcept {
     std::lock_guard<std::mutex> lock(m_assetsMutex);
     std::lock_guard<std::mutex> otherLock(other.m_assetsMutex);
 
+    unwatchAllShaders();
     m_assets = std::move(other.m_assets);
     m_totalAssets = other.m_totalAssets.load();
     m_loadedAssets = other.m_loadedAssets.load();
+    takeHotReload(other);
   }
   return *this;
 }
@@ -52,14 +59,18 @@ AssetHandle<T> AssetLoader::load(const std::string &path) {
   try {
     m_totalAssets++;
 
-    // Load Shader
+    // Load Shader, compiled in the background and finished by update() or
+    // the first use()
     if constexpr (std::is_same_v<T, Shader>) {
       Shader::CreateInfo createInfo;
-      if (auto shader = Shader::createFromFilesystem(
+      if (auto shader = Shader::createFromFilesystemAsync(
               path + ".vert", path + ".frag", createInfo)) {
         auto asset = std::make_shared<Shader>(std::move(*shader));
         m_assets.try_emplace(path, asset, 1);
         m_loadedAssets++;
+        if (m_hotReload) {
+          watchShader(path);
+        }
         return AssetHandle<T>(asset);
       } else {
         m_totalAssets--;
@@ -92,16 +103,20 @@ AssetHandle<T> AssetLoader::load(const std::string &path) {
     } else if constexpr (std::is_same_v<T, Font>) {
       Font::CreateInfo createInfo;
 
-      // Get the font size from the path
+      // Get the font size from the path, "@16:sdf" asks for distance field
+      // glyphs shared with the other sizes of the file
       size_t sizePos = path.find('@');
       if (sizePos != std::string::npos) {
         createInfo.size = std::stoi(path.substr(sizePos + 1));
+        createInfo.sdf = path.find(":sdf", sizePos) != std::string::npos;
       }
 
       // Strip the font size from the path
       std::string actualPath =
           (sizePos != std::string::npos) ? path.substr(0, sizePos) : path;
 
+      // Every size of a file shares one mapping of it, which stays open
+      // while any of their entries is loaded
       if (auto font = Font::createFromFile(actualPath, createInfo)) {
         auto asset = std::make_shared<Font>(std::move(*font));
         m_assets.try_emplace(path, asset, 1);
@@ -154,6 +169,9 @@ template <typename T> void AssetLoader::remove(const std::string &path) {
   auto it = m_assets.find(path);
   if (it != m_assets.end() && it->second.isType<T>()) {
     if (--it->second.refCount == 0) {
+      if constexpr (std::is_same_v<T, Shader>) {
+        unwatchShader(path);
+      }
       m_assets.erase(it);
       m_totalAssets--;
       m_loadedAssets--;
@@ -163,6 +181,7 @@ template <typename T> void AssetLoader::remove(const std::string &path) {
 
 void AssetLoader::clear() {
   std::lock_guard<std::mutex> lock(m_assetsMutex);
+  unwatchAllShaders();
   m_assets.clear();
   m_totalAssets = 0;
   m_loadedAssets = 0;
@@ -173,6 +192,118 @@ float AssetLoader::getLoadProgress() const {
   return total > 0 ? static_cast<float>(m_loadedAssets.load()) / total : 1.0f;
 }
 
+void AssetLoader::update() {
+  // Outside the lock, reload callbacks take it. The watcher has its own
+  // lock against watchShader() and unwatchShader().
+  m_fileWatcher.poll();
+
+  std::lock_guard<std::mutex> lock(m_assetsMutex);
+  for (auto &[path, entry] : m_assets) {
+    if (!entry.isType<Shader>()) {
+      continue;
+    }
+
+    auto shader = std::static_pointer_cast<Shader>(entry.asset);
+    auto compiling = [&shader]() {
+      return shader->isReloading() ||
+             shader->getStatus() == Shader::Status::Pending;
+    };
+    if (!compiling()) {
+      continue;
+    }
+
+    // Report once, when the compile finishes
+    shader->poll();
+    if (!compiling() && !shader->getErrorMsg().empty()) {
+      std::cerr << "Shader " << path << " failed: " << shader->getErrorMsg()
+                << std::endl;
+    }
+  }
+}
+
+void AssetLoader::setHotReload(bool enabled) {
+  std::lock_guard<std::mutex> lock(m_assetsMutex);
+  if (enabled == m_hotReload) {
+    return;
+  }
+  m_hotReload = enabled;
+
+  for (const auto &[path, entry] : m_assets) {
+    if (!entry.isType<Shader>()) {
+      continue;
+    }
+    if (enabled) {
+      watchShader(path);
+    } else {
+      unwatchShader(path);
+    }
+  }
+}
+
+void AssetLoader::watchShader(const std::string &path) {
+  auto &ids = m_shaderWatches[path];
+  if (!ids.empty()) {
+    return;
+  }
+
+  // Either stage changing recompiles both, the old program keeps drawing
+  // until the new one links
+  auto reload = [this, path](const std::filesystem::path &) {
+    std::lock_guard<std::mutex> lock(m_assetsMutex);
+    auto it = m_assets.find(path);
+    if (it == m_assets.end() || !it->second.isType<Shader>()) {
+      return;
+    }
+
+    Shader::CreateInfo createInfo;
+    auto shader = std::static_pointer_cast<Shader>(it->second.asset);
+    if (!shader->reloadFromFilesystem(path + ".vert", path + ".frag",
+                                      createInfo)) {
+      std::cerr << "Shader " << path << " reload failed: "
+                << createInfo.errorMsg << std::endl;
+    }
+  };
+  ids.push_back(m_fileWatcher.watch(path + ".vert", reload));
+  ids.push_back(m_fileWatcher.watch(path + ".frag", reload));
+}
+
+void AssetLoader::unwatchShader(const std::string &path) {
+  auto it = m_shaderWatches.find(path);
+  if (it == m_shaderWatches.end()) {
+    return;
+  }
+  for (auto id : it->second) {
+    m_fileWatcher.unwatch(id);
+  }
+  m_shaderWatches.erase(it);
+}
+
+void AssetLoader::unwatchAllShaders() {
+  for (const auto &[path, ids] : m_shaderWatches) {
+    for (auto id : ids) {
+      m_fileWatcher.unwatch(id);
+    }
+  }
+  m_shaderWatches.clear();
+}
+
+void AssetLoader::takeHotReload(AssetLoader &other) {
+  // The watches of `other` capture it, its shaders are watched again from
+  // here
+  other.unwatchAllShaders();
+  m_hotReload = other.m_hotReload;
+  other.m_hotReload = false;
+  if (!m_hotReload) {
+    return;
+  }
+
+  for (const auto &[path, entry] : m_assets) {
+    if (entry.isType<Shader>()) {
+      watchShader(path);
+    }
+  }
+}
+
 // Explicit template instantiations
 template AssetHandle<Shader> AssetLoader::load<Shader>(const std::string &);
 template std::future<AssetHandle<Shader>>
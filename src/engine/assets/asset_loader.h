@@ -10,6 +10,7 @@
 #include <unordered_map>
 #include <vector>
 
+#include "engine/assets/file_watcher.h"
 #include "engine/async/thread_pool.h"
 #include "engine/audio/audio_file.h"
 #include "engine/rendering/fonts.h"
@@ -53,7 +54,9 @@ public:
   AssetLoader(AssetLoader &&other) noexcept;
   AssetLoader &operator=(AssetLoader &&other) noexcept;
 
-  // Synchronous loading
+  // Synchronous loading. Shaders come back still compiling, only file
+  // errors are thrown for them, compile and link errors are reported by
+  // update() and the shader's getStatus().
   template <typename T> AssetHandle<T> load(const std::string &path);
 
   // Asynchronous loading
@@ -72,6 +75,14 @@ public:
   // Get asset load progress (0.0f - 1.0f)
   float getLoadProgress() const;
 
+  // Shaders compile in the background, call once per frame on the GL
+  // thread to finish them and to apply hot reloads
+  void update();
+
+  // Recompile shaders when their .vert or .frag file changes
+  void setHotReload(bool enabled);
+  bool isHotReloadEnabled() const { return m_hotReload; }
+
 private:
   struct AssetEntry {
     std::shared_ptr<void> asset;
@@ -85,11 +96,22 @@ private:
     template <typename T> bool isType() const { return typeId == &typeid(T); }
   };
 
+  void watchShader(const std::string &path);
+  void unwatchShader(const std::string &path);
+  void unwatchAllShaders();
+  // Moves the hot reload state of `other`, whose assets were just moved here
+  void takeHotReload(AssetLoader &other);
+
   std::unique_ptr<ThreadPool> m_threadPool;
   std::unordered_map<std::string, AssetEntry> m_assets;
   mutable std::mutex m_assetsMutex;
   std::atomic<size_t> m_totalAssets{0};
   std::atomic<size_t> m_loadedAssets{0};
+
+  bool m_hotReload = false;
+  FileWatcher m_fileWatcher;
+  std::unordered_map<std::string, std::vector<FileWatcher::WatchId>>
+      m_shaderWatches;
 };
 
 } // namespace ste
\ No newline at end of file
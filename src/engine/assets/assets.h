@@ -1,4 +1,5 @@
 #pragma once
 
 #include "asset_loader.h"
+#include "file_watcher.h"
 #include "asset_manager.h"
\ No newline at end of file
@@ -0,0 +1,61 @@
+#include "file_watcher.h"
+
+#include <algorithm>
+
+namespace ste {
+
+namespace {
+std::filesystem::file_time_type lastWriteTime(
+    const std::filesystem::path &path) {
+  // Missing files (e.g. mid-save by an editor) read as the epoch
+  std::error_code error;
+  auto time = std::filesystem::last_write_time(path, error);
+  return error ? std::filesystem::file_time_type() : time;
+}
+} // namespace
+
+FileWatcher::FileWatcher(std::chrono::milliseconds interval)
+    : m_interval(interval), m_lastPoll(std::chrono::steady_clock::now()) {}
+
+FileWatcher::WatchId FileWatcher::watch(const std::filesystem::path &path,
+                                        Callback callback) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  const WatchId id = m_nextId++;
+  m_entries.push_back({id, path, lastWriteTime(path), std::move(callback)});
+  return id;
+}
+
+void FileWatcher::unwatch(WatchId id) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  std::erase_if(m_entries, [id](const Entry &entry) { return entry.id == id; });
+}
+
+size_t FileWatcher::poll() {
+  // Collect under the lock, callbacks may watch or unwatch files and take
+  // locks of their own that are held around watch() and unwatch()
+  std::vector<std::pair<Callback, std::filesystem::path>> changed;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const auto now = std::chrono::steady_clock::now();
+    if (now - m_lastPoll < m_interval) {
+      return 0;
+    }
+    m_lastPoll = now;
+
+    for (auto &entry : m_entries) {
+      const auto lastWrite = lastWriteTime(entry.path);
+      if (lastWrite != entry.lastWrite &&
+          lastWrite != std::filesystem::file_time_type()) {
+        entry.lastWrite = lastWrite;
+        changed.emplace_back(entry.callback, entry.path);
+      }
+    }
+  }
+
+  for (const auto &[callback, path] : changed) {
+    callback(path);
+  }
+  return changed.size();
+}
+
+} // namespace ste
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace ste {
+
+// Watches files by polling their modification time. A poll is a stat() per
+// file at most every interval, cheap enough to call once per frame, and
+// callbacks run on the polling thread so they can touch GL objects. Files
+// can be watched and unwatched from any thread, callbacks run without the
+// watcher's lock held.
+class FileWatcher {
+public:
+  using WatchId = uint32_t;
+  using Callback = std::function<void(const std::filesystem::path &)>;
+
+  explicit FileWatcher(
+      std::chrono::milliseconds interval = std::chrono::milliseconds(250));
+
+  WatchId watch(const std::filesystem::path &path, Callback callback);
+  void unwatch(WatchId id);
+
+  // Checks the files if the interval elapsed and calls back for every
+  // changed one, returns the number of changes
+  size_t poll();
+
+private:
+  struct Entry {
+    WatchId id;
+    std::filesystem::path path;
+    std::filesystem::file_time_type lastWrite;
+    Callback callback;
+  };
+
+  std::mutex m_mutex;
+  std::chrono::milliseconds m_interval;
+  std::chrono::steady_clock::time_point m_lastPoll;
+  std::vector<Entry> m_entries;
+  WatchId m_nextId{1};
+};
+
+} // namespace ste
@@ -1 +1,2 @@
-#include "dialogs.h"
\ No newline at end of file
+#include "dialogs.h"
+#include "ui_layer.h"
\ No newline at end of file
@@ -0,0 +1,193 @@
+#include "ui_layer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace ste {
+
+UILayer::UILayer(std::shared_ptr<Renderer2D> renderer)
+    : m_renderer(std::move(renderer)) {}
+
+UILayer::PanelId UILayer::addPanel(PanelDesc desc) {
+  const PanelId id = m_nextId++;
+  m_panels.push_back(Panel{.id = id, .desc = std::move(desc)});
+  return id;
+}
+
+void UILayer::removePanel(PanelId id) {
+  std::erase_if(m_panels, [id](const Panel &panel) { return panel.id == id; });
+}
+
+UILayer::Panel *UILayer::findPanel(PanelId id) {
+  auto it = std::ranges::find(m_panels, id, &Panel::id);
+  return it != m_panels.end() ? &*it : nullptr;
+}
+
+void UILayer::setPanelPosition(PanelId id, const glm::vec2 &position) {
+  if (Panel *panel = findPanel(id)) {
+    panel->desc.position = position;
+  }
+}
+
+void UILayer::setPanelSize(PanelId id, const glm::vec2 &size) {
+  if (Panel *panel = findPanel(id)) {
+    if (panel->desc.size != size) {
+      panel->desc.size = size;
+      panel->dirty = true;
+    }
+  }
+}
+
+void UILayer::setPanelVisible(PanelId id, bool visible) {
+  if (Panel *panel = findPanel(id)) {
+    panel->visible = visible;
+  }
+}
+
+void UILayer::markDirty(PanelId id) {
+  if (Panel *panel = findPanel(id)) {
+    panel->dirty = true;
+  }
+}
+
+void UILayer::markAllDirty() {
+  for (auto &panel : m_panels) {
+    panel.dirty = true;
+  }
+}
+
+bool UILayer::updateTarget(Panel &panel) {
+  const int width = static_cast<int>(std::ceil(panel.desc.size.x));
+  const int height = static_cast<int>(std::ceil(panel.desc.size.y));
+  if (width <= 0 || height <= 0) {
+    return false;
+  }
+
+  if (!panel.target || panel.target->getWidth() != width ||
+      panel.target->getHeight() != height) {
+    RenderTarget::CreateInfo targetInfo;
+    targetInfo.width = width;
+    targetInfo.height = height;
+    targetInfo.filter = GL_NEAREST; // drawn 1:1 on screen
+    panel.target = RenderTarget::create(targetInfo);
+    if (!panel.target) {
+      std::cerr << "Failed to create UI panel target: " << targetInfo.errorMsg
+                << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+void UILayer::redrawPanel(Panel &panel) {
+  // Top left maps to the first texel row so the target is drawn with the
+  // usual texture coordinates. Alpha blending leaves the content
+  // premultiplied, which is how it's composited.
+  const glm::mat4 projection =
+      glm::ortho(0.0f, static_cast<float>(panel.target->getWidth()), 0.0f,
+                 static_cast<float>(panel.target->getHeight()), -1.0f, 1.0f);
+  m_renderer->beginScene(projection);
+  panel.desc.draw(*m_renderer);
+  m_renderer->endScene();
+
+  panel.dirty = false;
+  m_stats.panelRedraws++;
+}
+
+void UILayer::addPasses(RenderGraph &graph, RenderGraph::Resource output) {
+  // Scenes can't nest, so all cached content is brought up to date in its
+  // own passes before the screen pass reads it
+  std::vector<RenderGraph::Resource> cachedTargets;
+  for (auto &panel : m_panels) {
+    if (!panel.visible || !panel.desc.cached) {
+      continue;
+    }
+
+    const bool redraw = panel.dirty && updateTarget(panel);
+    if (!panel.target) {
+      continue;
+    }
+
+    const auto target = graph.importTarget("UI Panel", *panel.target);
+    cachedTargets.push_back(target);
+    if (!redraw) {
+      continue;
+    }
+
+    RenderGraph::PassDesc redrawDesc;
+    redrawDesc.name = "UI Panel";
+    redrawDesc.write = target;
+    redrawDesc.clearColor = glm::vec4(0.0f);
+    graph.addPass(std::move(redrawDesc),
+                  [this, id = panel.id](const RenderGraph::PassContext &) {
+                    if (Panel *panel = findPanel(id)) {
+                      redrawPanel(*panel);
+                    }
+                  });
+  }
+
+  RenderGraph::PassDesc desc;
+  desc.name = "UI";
+  desc.reads = std::move(cachedTargets);
+  desc.write = output;
+  graph.addPass(std::move(desc), [this](const RenderGraph::PassContext &ctx) {
+    drawPanels(ctx.getOutputSize());
+  });
+}
+
+void UILayer::drawPanels(const glm::ivec2 &screenSize) {
+  const glm::mat4 screenProjection =
+      glm::ortho(0.0f, static_cast<float>(screenSize.x),
+                 static_cast<float>(screenSize.y), 0.0f, -1.0f, 1.0f);
+
+  // Consecutive cached panels share a scene and usually a batch, panels
+  // drawn live get their own scene translated to the panel
+  bool screenSceneOpen = false;
+  for (auto &panel : m_panels) {
+    if (!panel.visible) {
+      continue;
+    }
+
+    if (panel.desc.cached) {
+      if (!panel.target) {
+        continue;
+      }
+      if (!screenSceneOpen) {
+        m_renderer->beginScene(screenProjection);
+        screenSceneOpen = true;
+      }
+
+      const glm::vec2 size = {static_cast<float>(panel.target->getWidth()),
+                              static_cast<float>(panel.target->getHeight())};
+      // Snapped to whole pixels so the texels map 1:1
+      m_renderer->setBlendMode(BlendMode::Premultiplied);
+      m_renderer->drawTexturedQuad(
+          glm::round(panel.desc.position),
+          {panel.target->getColorTexture(), panel.target->getWidth(),
+           panel.target->getHeight()},
+          size);
+      m_stats.cachedPanelsDrawn++;
+    } else {
+      if (screenSceneOpen) {
+        m_renderer->endScene();
+        screenSceneOpen = false;
+      }
+
+      m_renderer->beginScene(glm::translate(
+          screenProjection, glm::vec3(panel.desc.position, 0.0f)));
+      m_renderer->pushClipRect({0.0f, 0.0f}, panel.desc.size);
+      panel.desc.draw(*m_renderer);
+      m_renderer->endScene();
+    }
+    m_stats.panelsDrawn++;
+  }
+
+  if (screenSceneOpen) {
+    m_renderer->endScene();
+  }
+}
+
+} // namespace ste
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "engine/rendering/render_graph.h"
+#include "engine/rendering/render_target.h"
+#include "engine/rendering/renderer_2d.h"
+
+namespace ste {
+
+// Retained UI drawn on top of the scene in screen pixels. Every panel is a
+// callback drawing in panel local coordinates (top left is 0, 0) clipped to
+// the panel. Cached panels are drawn into their own render target, imported
+// into the RenderGraph, and only redrawn when marked dirty, every other frame
+// they cost a single textured quad no matter how much text they hold.
+class UILayer {
+public:
+  using PanelId = uint32_t;
+  using DrawCallback = std::function<void(Renderer2D &renderer)>;
+
+  struct PanelDesc {
+    glm::vec2 position{0.0f};
+    glm::vec2 size{0.0f};
+    DrawCallback draw;
+    // Panels whose content rarely changes, others are drawn every frame
+    bool cached = true;
+  };
+
+  struct Statistics {
+    uint32_t panelsDrawn = 0;
+    uint32_t cachedPanelsDrawn = 0;
+    uint32_t panelRedraws = 0; // cached panels rendered into their target
+  };
+
+  explicit UILayer(std::shared_ptr<Renderer2D> renderer);
+  UILayer(const UILayer &) = delete;
+  UILayer &operator=(const UILayer &) = delete;
+
+  // Panels are drawn in the order they were added
+  PanelId addPanel(PanelDesc desc);
+  void removePanel(PanelId id);
+
+  // Moving a cached panel doesn't redraw it, resizing does
+  void setPanelPosition(PanelId id, const glm::vec2 &position);
+  void setPanelSize(PanelId id, const glm::vec2 &size);
+  void setPanelVisible(PanelId id, bool visible);
+  // The next frame redraws the panel's cached content
+  void markDirty(PanelId id);
+  void markAllDirty();
+
+  // Adds a pass per dirty cached panel redrawing its target and a pass
+  // drawing all visible panels over `output`. Panels can't be added or
+  // removed until the graph has executed.
+  void addPasses(RenderGraph &graph,
+                 RenderGraph::Resource output = RenderGraph::BACKBUFFER);
+
+  void resetStats() { m_stats = Statistics(); }
+  Statistics getStats() const { return m_stats; }
+
+private:
+  struct Panel {
+    PanelId id;
+    PanelDesc desc;
+    bool visible = true;
+    bool dirty = true;
+    std::optional<RenderTarget> target;
+  };
+
+  Panel *findPanel(PanelId id);
+  // (Re)creates the target of a dirty cached panel at its current size
+  bool updateTarget(Panel &panel);
+  void redrawPanel(Panel &panel);
+  void drawPanels(const glm::ivec2 &screenSize);
+
+  std::shared_ptr<Renderer2D> m_renderer;
+  std::vector<Panel> m_panels;
+  PanelId m_nextId{1};
+  Statistics m_stats{};
+};
+
+} // namespace ste
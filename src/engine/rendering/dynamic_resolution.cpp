@@ -0,0 +1,203 @@
+#include "dynamic_resolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <glad/glad.h>
+
+#include "gl_state.h"
+
+namespace ste {
+
+namespace {
+// Fullscreen triangle from gl_VertexID: (-1,-1), (3,-1), (-1,3)
+const char *presentVertexShaderSource = R"(
+        #version 330 core
+        out vec2 v_TexCoord;
+
+        void main() {
+            vec2 ndc = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2) * 2.0 - 1.0;
+            v_TexCoord = ndc * 0.5 + 0.5;
+            gl_Position = vec4(ndc, 0.0, 1.0);
+        }
+    )";
+
+// Samples the rendered region only, clamped half a texel inside it so
+// bilinear filtering doesn't pull in stale texels beyond its edge
+const char *presentFragmentShaderSource = R"(
+        #version 330 core
+        out vec4 FragColor;
+
+        in vec2 v_TexCoord;
+
+        uniform sampler2D u_World;
+        uniform vec2 u_UVScale;
+        uniform vec2 u_UVMax;
+
+        void main() {
+            FragColor = texture(u_World, min(v_TexCoord * u_UVScale, u_UVMax));
+        }
+    )";
+} // namespace
+
+std::shared_ptr<DynamicResolution>
+DynamicResolution::create(CreateInfo &createInfo) {
+  if (createInfo.width <= 0 || createInfo.height <= 0) {
+    createInfo.success = false;
+    createInfo.errorMsg = "Output size must be positive";
+    return nullptr;
+  }
+  if (createInfo.minScale <= 0.0f || createInfo.minScale > createInfo.maxScale) {
+    createInfo.success = false;
+    createInfo.errorMsg = "Scale range must be positive and ordered";
+    return nullptr;
+  }
+
+  Shader::CreateInfo shaderInfo;
+  auto presentShader = Shader::createFromMemory(
+      presentVertexShaderSource, presentFragmentShaderSource, shaderInfo);
+  if (!presentShader) {
+    createInfo.success = false;
+    createInfo.errorMsg = std::move(shaderInfo.errorMsg);
+    return nullptr;
+  }
+  presentShader->use();
+  presentShader->setUniform("u_World", 0);
+
+  // Corners come from gl_VertexID, the VAO has no attributes
+  uint32_t vao;
+  glGenVertexArrays(1, &vao);
+
+  return std::make_shared<DynamicResolution>(std::move(*presentShader), vao,
+                                             createInfo);
+}
+
+DynamicResolution::DynamicResolution(Shader &&presentShader, uint32_t vao,
+                                     const CreateInfo &createInfo)
+    : m_presentShader(std::move(presentShader)), m_VAO(vao),
+      m_width(createInfo.width),
+      m_height(createInfo.height), m_minScale(createInfo.minScale),
+      m_maxScale(createInfo.maxScale), m_depth(createInfo.depth),
+      m_scale(createInfo.maxScale),
+      m_targetFrameMs(createInfo.targetFrameMs) {}
+
+DynamicResolution::~DynamicResolution() {
+  GLStateCache::get().onVertexArrayDeleted(m_VAO);
+  glDeleteVertexArrays(1, &m_VAO);
+}
+
+bool DynamicResolution::resize(int width, int height) {
+  if (width <= 0 || height <= 0) {
+    return false;
+  }
+
+  m_width = width;
+  m_height = height;
+  return true;
+}
+
+void DynamicResolution::setScale(float scale) {
+  m_scale = std::clamp(scale, m_minScale, m_maxScale);
+}
+
+glm::ivec2 DynamicResolution::getTargetSize() const {
+  return {std::max(1, static_cast<int>(std::ceil(m_width * m_maxScale))),
+          std::max(1, static_cast<int>(std::ceil(m_height * m_maxScale)))};
+}
+
+glm::ivec2 DynamicResolution::getRenderSize() const {
+  const glm::ivec2 targetSize = getTargetSize();
+  const int width = static_cast<int>(std::lround(m_width * m_scale));
+  const int height = static_cast<int>(std::lround(m_height * m_scale));
+  return {std::clamp(width, 1, targetSize.x),
+          std::clamp(height, 1, targetSize.y)};
+}
+
+void DynamicResolution::update(double gpuFrameMs) {
+  if (!m_autoScale || gpuFrameMs <= 0.0) {
+    return;
+  }
+
+  m_smoothedMs = m_smoothedMs > 0.0
+                     ? m_smoothedMs + (gpuFrameMs - m_smoothedMs) *
+                                          m_settings.smoothing
+                     : gpuFrameMs;
+
+  if (m_cooldown > 0) {
+    m_cooldown--;
+    return;
+  }
+
+  const double upper = m_targetFrameMs * m_settings.upperThreshold;
+  const double lower = m_targetFrameMs * m_settings.lowerThreshold;
+  m_overBudgetFrames = m_smoothedMs > upper ? m_overBudgetFrames + 1 : 0;
+  m_underBudgetFrames = m_smoothedMs < lower ? m_underBudgetFrames + 1 : 0;
+
+  // GPU time grows with the pixel count, the scale that would land in the
+  // middle of the dead band
+  const double aim = (upper + lower) * 0.5;
+  const auto predicted =
+      static_cast<float>(m_scale * std::sqrt(aim / m_smoothedMs));
+
+  float scale = m_scale;
+  if (m_overBudgetFrames >= m_settings.framesBeforeDecrease) {
+    // Shrinking has to be quick, jump there in one step
+    scale = std::clamp(predicted, m_minScale, m_scale);
+  } else if (m_underBudgetFrames >= m_settings.framesBeforeIncrease) {
+    // Growing is cautious, a bounded step that never overshoots the band
+    scale = std::max(std::min({m_scale + m_settings.increaseStep, predicted,
+                               m_maxScale}),
+                     m_scale);
+  }
+
+  if (scale != m_scale) {
+    if (scale < m_scale) {
+      m_stats.decreases++;
+    } else {
+      m_stats.increases++;
+    }
+    m_scale = scale;
+    m_overBudgetFrames = 0;
+    m_underBudgetFrames = 0;
+    m_cooldown = m_settings.cooldownFrames;
+    // Samples from the old resolution no longer apply
+    m_smoothedMs = 0.0;
+  }
+}
+
+RenderGraph::Resource
+DynamicResolution::createTarget(RenderGraph &graph) const {
+  const glm::ivec2 targetSize = getTargetSize();
+  RenderGraph::TargetDesc desc;
+  desc.width = targetSize.x;
+  desc.height = targetSize.y;
+  desc.depth = m_depth;
+  return graph.createTarget("World", desc);
+}
+
+void DynamicResolution::addPresentPass(RenderGraph &graph,
+                                       RenderGraph::Resource target) const {
+  RenderGraph::PassDesc desc;
+  desc.name = "Present";
+  desc.reads = {target};
+  auto present = [this, target](const RenderGraph::PassContext &ctx) {
+    // A textured draw rather than a blit, blits into a multisampled
+    // backbuffer can't scale
+    const glm::vec2 size(getRenderSize());
+    const glm::vec2 targetSize(ctx.getSize(target));
+    auto &state = GLStateCache::get();
+
+    state.setScissorTestEnabled(false);
+    state.setDepthMode(DepthMode::None);
+    state.setBlendMode(BlendMode::None);
+    m_presentShader.use();
+    m_presentShader.setUniform("u_UVScale", size / targetSize);
+    m_presentShader.setUniform("u_UVMax", (size - 0.5f) / targetSize);
+    state.bindTexture(0, ctx.getTexture(target));
+    state.bindVertexArray(m_VAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+  };
+  graph.addPass(std::move(desc), std::move(present));
+}
+
+} // namespace ste
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <glm/glm.hpp>
+
+#include "render_graph.h"
+#include "shader.h"
+
+namespace ste {
+
+// Renders the world at a resolution that follows the GPU frame time. The
+// graph target is sized for the largest scale so it is pooled across scale
+// changes, world passes draw into it through a smaller viewport and the
+// present pass stretches that region over the backbuffer so UI drawn
+// afterwards stays at native resolution. The world target is single
+// sampled, a multisampled window only antialiases what is drawn after the
+// present pass.
+//
+// The controller has a dead band between lowerThreshold and upperThreshold
+// of the budget, scales down after a few frames over budget and only scales
+// up after a longer stretch well under it, so the scale settles instead of
+// oscillating.
+class DynamicResolution {
+public:
+  struct CreateInfo {
+    std::string errorMsg;
+    bool success = true;
+    int width = 0; // output size in pixels
+    int height = 0;
+    float targetFrameMs = 16.6f; // GPU budget per frame
+    float minScale = 0.5f;
+    float maxScale = 1.0f;
+    bool depth = false; // for Renderer2D's depth sorted passes
+  };
+
+  struct Settings {
+    // Fractions of the budget bounding the dead band
+    float upperThreshold = 0.95f;
+    float lowerThreshold = 0.75f;
+    uint32_t framesBeforeDecrease = 6;
+    uint32_t framesBeforeIncrease = 60;
+    // Frames ignored after a change, GPU timings lag a few frames behind
+    uint32_t cooldownFrames = 15;
+    float increaseStep = 0.1f;
+    float smoothing = 0.2f; // weight of the newest sample
+  };
+
+  struct Statistics {
+    uint32_t decreases = 0;
+    uint32_t increases = 0;
+  };
+
+  static std::shared_ptr<DynamicResolution> create(CreateInfo &createInfo);
+
+  DynamicResolution(Shader &&presentShader, uint32_t vao,
+                    const CreateInfo &createInfo);
+  ~DynamicResolution();
+  DynamicResolution(const DynamicResolution &) = delete;
+  DynamicResolution &operator=(const DynamicResolution &) = delete;
+
+  // Follows a new output size, the scale is kept
+  bool resize(int width, int height);
+
+  // Feeds the GPU time of a finished frame, e.g. the RenderProfiler's last
+  // report. Samples of zero (no timer data) are ignored.
+  void update(double gpuFrameMs);
+
+  // Declares this frame's world target, passes writing it should set
+  // PassDesc::viewport to getRenderSize()
+  RenderGraph::Resource createTarget(RenderGraph &graph) const;
+  // Adds a pass stretching the rendered region of the world target over the
+  // backbuffer
+  void addPresentPass(RenderGraph &graph, RenderGraph::Resource target) const;
+
+  // Disabling automatic scaling keeps the scale set with setScale()
+  void setAutoScale(bool enabled) { m_autoScale = enabled; }
+  bool isAutoScale() const { return m_autoScale; }
+  void setScale(float scale);
+  float getScale() const { return m_scale; }
+  glm::ivec2 getRenderSize() const;
+
+  void setTargetFrameMs(float targetFrameMs) { m_targetFrameMs = targetFrameMs; }
+  float getTargetFrameMs() const { return m_targetFrameMs; }
+  Settings &getSettings() { return m_settings; }
+  double getSmoothedFrameMs() const { return m_smoothedMs; }
+
+  void resetStats() { m_stats = Statistics(); }
+  Statistics getStats() const { return m_stats; }
+
+private:
+  glm::ivec2 getTargetSize() const;
+
+  Shader m_presentShader;
+  uint32_t m_VAO{0};
+  int m_width;
+  int m_height;
+  float m_minScale;
+  float m_maxScale;
+  bool m_depth;
+  float m_scale;
+  float m_targetFrameMs;
+  bool m_autoScale = true;
+  Settings m_settings{};
+
+  double m_smoothedMs = 0.0;
+  uint32_t m_overBudgetFrames = 0;
+  uint32_t m_underBudgetFrames = 0;
+  uint32_t m_cooldown = 0;
+
+  Statistics m_stats{};
+};
+
+} // namespace ste
@@ -1,9 +1,112 @@
 #include "fonts.h"
 
+#include FT_MODULE_H
+#include <algorithm>
+#include <functional>
+#include <future>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <mutex>
+#include <thread>
+
+#include "gl_state.h"
+#include "quad_kernels.h"
+#include "render_profiler.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#endif
 
 namespace ste {
 
+namespace {
+void setSdfSpread(FT_Library library) {
+  // Applies to the SDF renderer of the whole library
+  const FT_Int spread = Font::SDF_SPREAD;
+  FT_Property_Set(library, "sdf", "spread", &spread);
+}
+
+// Renders a glyph with `face` alone, so workers can use it with their own
+bool rasterizeGlyph(FT_Face face, uint32_t codepoint, bool sdf,
+                    FontAtlas::GlyphBitmap &bitmap) {
+  // SDF glyphs are rendered from the outline below
+  if (FT_Load_Char(face, codepoint, sdf ? FT_LOAD_DEFAULT : FT_LOAD_RENDER) !=
+      0) {
+    return false;
+  }
+
+  FT_GlyphSlot glyph = face->glyph;
+  bitmap.codepoint = codepoint;
+  bitmap.advance = glyph->advance.x >> 6;
+  if (sdf) {
+    if (glyph->format != FT_GLYPH_FORMAT_OUTLINE ||
+        glyph->outline.n_points == 0) {
+      // Blank glyphs like spaces only need their metrics
+      return true;
+    }
+    // The bitmap grows by the spread on every side, the bearings with it
+    if (FT_Render_Glyph(glyph, FT_RENDER_MODE_SDF) != 0) {
+      return false;
+    }
+  }
+
+  const FT_Bitmap &source = glyph->bitmap;
+  bitmap.width = source.width;
+  bitmap.height = source.rows;
+  bitmap.bearingX = glyph->bitmap_left;
+  bitmap.bearingY = glyph->bitmap_top;
+  bitmap.pixels.resize(static_cast<size_t>(source.width) * source.rows);
+  for (uint32_t row = 0; row < source.rows; row++) {
+    std::copy_n(source.buffer + static_cast<ptrdiff_t>(row) * source.pitch,
+                source.width,
+                bitmap.pixels.data() + static_cast<size_t>(row) * source.width);
+  }
+  return true;
+}
+
+FT_Error openFace(FT_Library library, const FontFile &file, FT_Face &face) {
+  const std::span<const uint8_t> data = file.getData();
+  return FT_New_Memory_Face(library, data.data(),
+                            static_cast<FT_Long>(data.size()), 0, &face);
+}
+
+// Worker side of Font::prewarm
+std::vector<FontAtlas::GlyphBitmap>
+rasterizeGlyphs(std::shared_ptr<FontFile> file, uint32_t size, bool sdf,
+                std::span<const uint32_t> codepoints) {
+  std::vector<FontAtlas::GlyphBitmap> glyphs;
+  FT_Library library;
+  if (FT_Init_FreeType(&library) != 0) {
+    return glyphs;
+  }
+  if (sdf) {
+    setSdfSpread(library);
+  }
+
+  FT_Face face;
+  if (openFace(library, *file, face) == 0) {
+    if (FT_Set_Pixel_Sizes(face, 0, size) == 0) {
+      glyphs.reserve(codepoints.size());
+      for (uint32_t codepoint : codepoints) {
+        FontAtlas::GlyphBitmap glyph;
+        if (rasterizeGlyph(face, codepoint, sdf, glyph)) {
+          glyphs.push_back(std::move(glyph));
+        }
+      }
+    }
+    FT_Done_Face(face);
+  }
+  FT_Done_FreeType(library);
+  return glyphs;
+}
+} // namespace
+
 FontLibrary::FontLibrary() {
   if (FT_Init_FreeType(&m_library) != 0) {
     m_error = "Failed to initialize FreeType";
@@ -16,36 +119,69 @@ FontLibrary::~FontLibrary() {
   }
 }
 
-FontAtlas::FontAtlas(uint32_t width, uint32_t height)
-    : m_width(width), m_height(height) {
+FontAtlas::FontAtlas(uint32_t width, uint32_t height, uint32_t maxPages)
+    : m_width(width), m_height(height),
+      m_maxPages(std::clamp(maxPages, 1u, MAX_PAGES)) {}
 
-  // Create texture atlas
-  glGenTextures(1, &m_textureId);
-  GLenum error = glGetError();
-  if (error != GL_NO_ERROR) {
-    std::cerr << "Failed to generate texture. Error: " << error << std::endl;
-    return;
+FontAtlas::~FontAtlas() {
+  for (uint32_t texture : m_textures) {
+    GLStateCache::get().onTextureDeleted(texture);
+    glDeleteTextures(1, &texture);
   }
+}
 
-  // Try binding BEFORE initialization
-  glBindTexture(GL_TEXTURE_2D, m_textureId);
-  error = glGetError();
-  if (error != GL_NO_ERROR) {
-    return;
+FontAtlas::FontAtlas(FontAtlas &&other) noexcept
+    : m_width(other.m_width), m_height(other.m_height),
+      m_maxPages(other.m_maxPages), m_pages(std::move(other.m_pages)),
+      m_textures(std::move(other.m_textures)), m_useStamp(other.m_useStamp),
+      m_version(other.m_version), m_stats(other.m_stats),
+      m_glyphs(std::move(other.m_glyphs)) {
+  other.m_pages.clear();
+  other.m_textures.clear();
+}
+
+FontAtlas &FontAtlas::operator=(FontAtlas &&other) noexcept {
+  if (this != &other) {
+    for (uint32_t texture : m_textures) {
+      GLStateCache::get().onTextureDeleted(texture);
+      glDeleteTextures(1, &texture);
+    }
+
+    m_width = other.m_width;
+    m_height = other.m_height;
+    m_maxPages = other.m_maxPages;
+    m_pages = std::move(other.m_pages);
+    m_textures = std::move(other.m_textures);
+    m_useStamp = other.m_useStamp;
+    m_version = std::max(m_version, other.m_version) + 1;
+    m_stats = other.m_stats;
+    m_glyphs = std::move(other.m_glyphs);
+
+    other.m_pages.clear();
+    other.m_textures.clear();
   }
+  return *this;
+}
+
+bool FontAtlas::createPage() {
+  uint32_t texture;
+  glGenTextures(1, &texture);
+  GLStateCache::get().bindTexture(texture);
 
-  // Initialize with empty data
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, width, height, 0, GL_RED,
-               GL_UNSIGNED_BYTE, nullptr);
-  error = glGetError();
+  // Cleared so the padding around glyphs is transparent
+  std::vector<uint8_t> pixels(static_cast<size_t>(m_width) * m_height);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, m_width, m_height, 0, GL_RED,
+               GL_UNSIGNED_BYTE, pixels.data());
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  GLenum error = glGetError();
   if (error != GL_NO_ERROR) {
     std::cerr << "Error in glTexImage2D: " << error << std::endl;
-    return;
+    GLStateCache::get().onTextureDeleted(texture);
+    glDeleteTextures(1, &texture);
+    return false;
   }
 
-  // Now check if texture is valid
-  GLboolean isTexture = glIsTexture(m_textureId);
-
   // Set texture parameters
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -56,129 +192,272 @@ FontAtlas::FontAtlas(uint32_t width, uint32_t height)
   GLint swizzleMask[] = {GL_ONE, GL_ONE, GL_ONE, GL_RED};
   glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzleMask);
 
-  // Verify texture is still valid
-  isTexture = glIsTexture(m_textureId);
+  m_pages.push_back(Page{.texture = texture,
+                         .skyline = {SkylineNode{0, 0, m_width}},
+                         .lastUse = m_useStamp,
+                         .pixels = std::move(pixels)});
+  m_textures.push_back(texture);
+  return true;
+}
+
+void FontAtlas::clearPage(uint32_t pageIndex) {
+  Page &page = m_pages[pageIndex];
+  page.skyline = {SkylineNode{0, 0, m_width}};
+  std::erase_if(m_glyphs, [pageIndex](const auto &entry) {
+    const GlyphInfo &glyph = entry.second;
+    return glyph.page == pageIndex && glyph.width > 0 && glyph.height > 0;
+  });
+
+  std::ranges::fill(page.pixels, uint8_t{0});
+  uploadRegion(page, 0, 0, m_width, m_height);
 
-  // Unbind texture
-  glBindTexture(GL_TEXTURE_2D, 0);
+  m_version++;
+  m_stats.evictions++;
 }
 
-FontAtlas::~FontAtlas() {
-  if (m_textureId) {
-    glDeleteTextures(1, &m_textureId);
+void FontAtlas::touchPage(uint32_t page) {
+  if (page < m_pages.size()) {
+    m_pages[page].lastUse = m_useStamp;
   }
 }
 
-bool FontAtlas::findSpace(uint32_t width, uint32_t height, uint32_t &x,
-                          uint32_t &y) {
-  // If we can't fit on current row, move to next row
-  if (m_currentX + width > m_width) {
-    m_currentX = 0;
-    m_currentY += m_rowHeight;
-    m_rowHeight = 0;
+void FontAtlas::touchPages(uint32_t pageMask) {
+  for (uint32_t page = 0; pageMask != 0; page++, pageMask >>= 1) {
+    if (pageMask & 1) {
+      touchPage(page);
+    }
   }
+}
 
-  // Check if we have room vertically
-  if (m_currentY + height > m_height) {
+bool FontAtlas::fitSkyline(const Page &page, size_t index, uint32_t width,
+                           uint32_t height, uint32_t &y) const {
+  const uint32_t x = page.skyline[index].x;
+  if (x + width > m_width) {
     return false;
   }
 
-  // Update position and row height
-  x = m_currentX;
-  y = m_currentY;
-  m_currentX += width;
-  m_rowHeight = std::max(m_rowHeight, height);
+  // The rect rests on the highest node below it, the nodes span the whole
+  // page width so the loop ends before running out
+  y = 0;
+  uint32_t remaining = width;
+  for (size_t i = index; remaining > 0; i++) {
+    y = std::max(y, page.skyline[i].y);
+    if (y + height > m_height) {
+      return false;
+    }
+    remaining -= std::min(remaining, page.skyline[i].width);
+  }
   return true;
 }
 
-bool FontAtlas::addGlyph(uint32_t codepoint, const uint8_t *bitmap,
-                         uint32_t width, uint32_t height, int bearingX,
-                         int bearingY, int advance) {
-
-  if (m_textureId == 0) {
-    std::cerr << "Invalid texture ID (zero)" << std::endl;
+bool FontAtlas::findSpace(Page &page, uint32_t width, uint32_t height,
+                          uint32_t &x, uint32_t &y) {
+  // Bottom left rule, lowest top edge first and the narrowest node on ties
+  size_t bestIndex = page.skyline.size();
+  uint32_t bestTop = UINT32_MAX;
+  uint32_t bestWidth = UINT32_MAX;
+  for (size_t i = 0; i < page.skyline.size(); i++) {
+    uint32_t top;
+    if (!fitSkyline(page, i, width, height, top)) {
+      continue;
+    }
+    top += height;
+    if (top < bestTop ||
+        (top == bestTop && page.skyline[i].width < bestWidth)) {
+      bestIndex = i;
+      bestTop = top;
+      bestWidth = page.skyline[i].width;
+    }
+  }
+  if (bestIndex == page.skyline.size()) {
     return false;
   }
 
-  // Check texture validity at start of method
-  GLboolean isTexture = glIsTexture(m_textureId);
-  if (!isTexture) {
-    std::cerr << "Texture " << m_textureId << " is invalid at start of addGlyph"
-              << std::endl;
-    return false;
+  x = page.skyline[bestIndex].x;
+  y = bestTop - height;
+
+  // Raise the skyline over the new rect and cut the nodes it covers
+  auto &skyline = page.skyline;
+  skyline.insert(skyline.begin() + bestIndex, SkylineNode{x, bestTop, width});
+  for (size_t i = bestIndex + 1; i < skyline.size();) {
+    const SkylineNode &previous = skyline[i - 1];
+    const uint32_t previousEnd = previous.x + previous.width;
+    if (skyline[i].x >= previousEnd) {
+      break;
+    }
+
+    const uint32_t overlap = previousEnd - skyline[i].x;
+    if (skyline[i].width <= overlap) {
+      skyline.erase(skyline.begin() + i);
+      continue;
+    }
+    skyline[i].x += overlap;
+    skyline[i].width -= overlap;
+    break;
   }
 
-  // Find space in atlas
-  uint32_t x, y;
-  if (!findSpace(width, height, x, y)) {
-    std::cerr << "Could not find space for glyph" << std::endl;
-    return false;
+  // Merge neighbors at the same height
+  for (size_t i = 0; i + 1 < skyline.size();) {
+    if (skyline[i].y == skyline[i + 1].y) {
+      skyline[i].width += skyline[i + 1].width;
+      skyline.erase(skyline.begin() + i + 1);
+    } else {
+      i++;
+    }
   }
+  return true;
+}
 
-  // Verify bounds
-  if (x + width > m_width || y + height > m_height) {
-    std::cerr << "Glyph position exceeds atlas bounds" << std::endl;
-    return false;
+bool FontAtlas::allocate(uint32_t width, uint32_t height, uint32_t &page,
+                         uint32_t &x, uint32_t &y) {
+  for (page = 0; page < m_pages.size(); page++) {
+    if (findSpace(m_pages[page], width, height, x, y)) {
+      return true;
+    }
   }
 
-  // Set active texture unit
-  glActiveTexture(GL_TEXTURE0);
-  GLenum error = glGetError();
-  if (error != GL_NO_ERROR) {
-    std::cerr << "Error setting active texture: " << error << std::endl;
-    return false;
+  if (m_pages.size() < m_maxPages && createPage()) {
+    page = static_cast<uint32_t>(m_pages.size() - 1);
+    return findSpace(m_pages[page], width, height, x, y);
   }
 
-  // Bind texture
-  glBindTexture(GL_TEXTURE_2D, m_textureId);
-  error = glGetError();
-  if (error != GL_NO_ERROR) {
-    std::cerr << "Error binding texture in addGlyph: " << error << std::endl;
+  // Evict the least recently used page, unless it's in use right now
+  uint32_t coldest = UINT32_MAX;
+  for (uint32_t i = 0; i < m_pages.size(); i++) {
+    if (m_pages[i].lastUse != m_useStamp &&
+        (coldest == UINT32_MAX ||
+         m_pages[i].lastUse < m_pages[coldest].lastUse)) {
+      coldest = i;
+    }
+  }
+  if (coldest == UINT32_MAX) {
     return false;
   }
 
-  // Set pixel storage mode
-  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-  error = glGetError();
-  if (error != GL_NO_ERROR) {
-    std::cerr << "Error setting pixel storage mode: " << error << std::endl;
-    return false;
+  clearPage(coldest);
+  page = coldest;
+  return findSpace(m_pages[page], width, height, x, y);
+}
+
+const FontAtlas::GlyphInfo *
+FontAtlas::packGlyph(uint32_t codepoint, const uint8_t *bitmap, uint32_t width,
+                     uint32_t height, int bearingX, int bearingY,
+                     int advance, uint32_t &x, uint32_t &y) {
+  GlyphInfo info{};
+  info.bearingX = bearingX;
+  info.bearingY = bearingY;
+  info.advance = advance;
+  info.width = width;
+  info.height = height;
+
+  // Blank glyphs like spaces only need their metrics
+  if (width == 0 || height == 0) {
+    return &(m_glyphs[codepoint] = info);
   }
 
-  // Add glyph to texture
-  glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, GL_RED,
-                  GL_UNSIGNED_BYTE, bitmap);
-  error = glGetError();
-  if (error != GL_NO_ERROR) {
-    std::cerr << "Error in glTexSubImage2D: " << error << std::endl;
-    return false;
+  // Find space in atlas
+  uint32_t page;
+  if (width + PADDING > m_width || height + PADDING > m_height ||
+      !allocate(width + PADDING, height + PADDING, page, x, y)) {
+    std::cerr << "Could not find space for glyph " << codepoint << std::endl;
+    m_stats.failedGlyphs++;
+    return nullptr;
+  }
+
+  uint8_t *pixels = m_pages[page].pixels.data();
+  for (uint32_t row = 0; row < height; row++) {
+    std::copy_n(bitmap + static_cast<size_t>(row) * width, width,
+                pixels + static_cast<size_t>(y + row) * m_width + x);
   }
 
-  // Store glyph info
-  GlyphInfo info;
   info.u0 = static_cast<float>(x) / m_width;
   info.v0 = static_cast<float>(y) / m_height;
   info.u1 = static_cast<float>(x + width) / m_width;
   info.v1 = static_cast<float>(y + height) / m_height;
-  info.bearingX = bearingX;
-  info.bearingY = bearingY;
-  info.advance = advance;
-  info.width = width;
-  info.height = height;
+  info.page = page;
+  touchPage(page);
+  return &(m_glyphs[codepoint] = info);
+}
 
-  m_glyphs[codepoint] = info;
+void FontAtlas::uploadRegion(const Page &page, uint32_t x, uint32_t y,
+                             uint32_t width, uint32_t height) const {
+  RenderProfiler::CpuTimer timer(RenderProfiler::CpuCounter::Upload);
+  GLStateCache::get().bindTexture(page.texture);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, m_width);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, GL_RED,
+                  GL_UNSIGNED_BYTE,
+                  page.pixels.data() + static_cast<size_t>(y) * m_width + x);
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
 
-  // Verify texture is still valid
-  isTexture = glIsTexture(m_textureId);
-  if (!isTexture) {
-    std::cerr << "Texture became invalid after adding glyph" << std::endl;
+bool FontAtlas::addGlyph(uint32_t codepoint, const uint8_t *bitmap,
+                         uint32_t width, uint32_t height, int bearingX,
+                         int bearingY, int advance) {
+  uint32_t x, y;
+  const GlyphInfo *info = packGlyph(codepoint, bitmap, width, height,
+                                    bearingX, bearingY, advance, x, y);
+  if (!info) {
     return false;
   }
+  if (width > 0 && height > 0) {
+    uploadRegion(m_pages[info->page], x, y, width, height);
+  }
+  return true;
+}
+
+uint32_t FontAtlas::addGlyphs(std::span<const GlyphBitmap> glyphs) {
+  // Tallest first packs the skyline tighter
+  std::vector<const GlyphBitmap *> order;
+  order.reserve(glyphs.size());
+  for (const GlyphBitmap &glyph : glyphs) {
+    order.push_back(&glyph);
+  }
+  std::ranges::stable_sort(order, std::greater{}, &GlyphBitmap::height);
 
-  // Unbind texture
-  glBindTexture(GL_TEXTURE_2D, 0);
+  // Area written on each page, uploaded once at the end
+  struct Dirty {
+    uint32_t minX = UINT32_MAX, minY = UINT32_MAX;
+    uint32_t maxX = 0, maxY = 0;
+  };
+  std::vector<Dirty> dirty;
+
+  uint32_t added = 0;
+  for (const GlyphBitmap *glyph : order) {
+    const uint32_t evictions = m_stats.evictions;
+    uint32_t x, y;
+    const GlyphInfo *info = packGlyph(
+        glyph->codepoint, glyph->pixels.data(), glyph->width, glyph->height,
+        glyph->bearingX, glyph->bearingY, glyph->advance, x, y);
+    if (!info) {
+      continue;
+    }
+    added++;
+    if (glyph->width == 0 || glyph->height == 0) {
+      continue;
+    }
 
-  return true;
+    dirty.resize(m_pages.size());
+    if (m_stats.evictions != evictions) {
+      // The evicted page was uploaded cleared, only the new glyph counts
+      dirty[info->page] = Dirty();
+    }
+    Dirty &region = dirty[info->page];
+    region.minX = std::min(region.minX, x);
+    region.minY = std::min(region.minY, y);
+    region.maxX = std::max(region.maxX, x + glyph->width);
+    region.maxY = std::max(region.maxY, y + glyph->height);
+  }
+
+  for (uint32_t page = 0; page < dirty.size(); page++) {
+    const Dirty &region = dirty[page];
+    if (region.minX < region.maxX) {
+      uploadRegion(m_pages[page], region.minX, region.minY,
+                   region.maxX - region.minX, region.maxY - region.minY);
+    }
+  }
+  return added;
 }
 
 const FontAtlas::GlyphInfo *FontAtlas::getGlyph(uint32_t codepoint) const {
@@ -186,49 +465,89 @@ const FontAtlas::GlyphInfo *FontAtlas::getGlyph(uint32_t codepoint) const {
   return it != m_glyphs.end() ? &it->second : nullptr;
 }
 
-FontAtlas::FontAtlas(FontAtlas &&other) noexcept {
-  GLboolean isTexture = glIsTexture(other.m_textureId);
-
-  m_textureId = other.m_textureId;
-  m_width = other.m_width;
-  m_height = other.m_height;
-  m_currentX = other.m_currentX;
-  m_currentY = other.m_currentY;
-  m_rowHeight = other.m_rowHeight;
-  m_glyphs = std::move(other.m_glyphs);
-
-  other.m_textureId = 0;
-
-  // Verify our texture is valid after move
-  isTexture = glIsTexture(m_textureId);
+FontAtlas::Statistics FontAtlas::getStats() const {
+  Statistics stats = m_stats;
+  stats.pages = static_cast<uint32_t>(m_pages.size());
+  stats.glyphs = static_cast<uint32_t>(m_glyphs.size());
+  return stats;
 }
 
-FontAtlas &FontAtlas::operator=(FontAtlas &&other) noexcept {
-  if (this != &other) {
-    if (m_textureId != 0) {
-      glDeleteTextures(1, &m_textureId);
-    }
-
-    GLboolean isTexture = glIsTexture(other.m_textureId);
+FontFile::~FontFile() {
+#if defined(__unix__) || defined(__APPLE__)
+  if (m_mapped) {
+    munmap(const_cast<uint8_t *>(m_data), m_size);
+  }
+#endif
+}
 
-    m_textureId = other.m_textureId;
-    m_width = other.m_width;
-    m_height = other.m_height;
-    m_currentX = other.m_currentX;
-    m_currentY = other.m_currentY;
-    m_rowHeight = other.m_rowHeight;
-    m_glyphs = std::move(other.m_glyphs);
+std::shared_ptr<FontFile> FontFile::open(const std::string &path,
+                                         CreateInfo &createInfo) {
+  // Fonts may be loaded from the asset loader's worker threads
+  static std::mutex filesMutex;
+  static std::unordered_map<std::string, std::weak_ptr<FontFile>> files;
+  std::lock_guard<std::mutex> lock(filesMutex);
+  if (auto shared = files[path].lock()) {
+    return shared;
+  }
 
-    other.m_textureId = 0;
+  std::shared_ptr<FontFile> file(new FontFile(path));
+#if defined(__unix__) || defined(__APPLE__)
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  struct stat info {};
+  if (fd < 0 || fstat(fd, &info) != 0 || info.st_size <= 0) {
+    if (fd >= 0) {
+      close(fd);
+    }
+    createInfo.success = false;
+    createInfo.errorMsg = "Failed to open font file: " + path;
+    return nullptr;
+  }
 
-    // Verify our texture is valid after move
-    isTexture = glIsTexture(m_textureId);
+  // The mapping keeps the file alive, the descriptor isn't needed
+  void *data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ,
+                    MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    createInfo.success = false;
+    createInfo.errorMsg = "Failed to map font file: " + path;
+    return nullptr;
   }
-  return *this;
+  file->m_data = static_cast<const uint8_t *>(data);
+  file->m_size = static_cast<size_t>(info.st_size);
+  file->m_mapped = true;
+#else
+  std::ifstream stream(path, std::ios::binary);
+  if (stream) {
+    file->m_buffer.assign(std::istreambuf_iterator<char>(stream),
+                          std::istreambuf_iterator<char>());
+  }
+  if (file->m_buffer.empty()) {
+    createInfo.success = false;
+    createInfo.errorMsg = "Failed to open font file: " + path;
+    return nullptr;
+  }
+  file->m_data = file->m_buffer.data();
+  file->m_size = file->m_buffer.size();
+#endif
+
+  files[path] = file;
+  return file;
 }
 
 std::optional<Font> Font::createFromFile(const std::string &path,
                                          CreateInfo &createInfo) {
+  FontFile::CreateInfo fileInfo;
+  auto file = FontFile::open(path, fileInfo);
+  if (!file) {
+    createInfo.success = false;
+    createInfo.errorMsg = std::move(fileInfo.errorMsg);
+    return std::nullopt;
+  }
+  return create(std::move(file), createInfo);
+}
+
+std::optional<Font> Font::create(std::shared_ptr<FontFile> file,
+                                 CreateInfo &createInfo) {
   auto &library = FontLibrary::get();
   if (!library.isValid()) {
     createInfo.success = false;
@@ -237,56 +556,94 @@ std::optional<Font> Font::createFromFile(const std::string &path,
     return std::nullopt;
   }
 
+  // SDF faces are shared for as long as a font uses them, fonts may be
+  // loaded from the asset loader's worker threads
+  static std::mutex sdfMutex;
+  static std::unordered_map<const FontFile *, std::weak_ptr<Face>> sdfFaces;
+  std::unique_lock<std::mutex> sdfLock(sdfMutex, std::defer_lock);
+  if (createInfo.sdf) {
+    sdfLock.lock();
+    if (auto shared = sdfFaces[file.get()].lock()) {
+      return Font(std::move(shared), createInfo.size);
+    }
+  }
+
   FT_Face face;
-  if (FT_New_Face(library.getLibrary(), path.c_str(), 0, &face) != 0) {
+  if (openFace(library.getLibrary(), *file, face) != 0) {
     createInfo.success = false;
-    createInfo.errorMsg = "Failed to load font: " + path;
+    createInfo.errorMsg = "Failed to load font: " + file->getPath();
     return std::nullopt;
   }
 
-  if (FT_Set_Pixel_Sizes(face, 0, createInfo.size) != 0) {
+  const uint32_t renderSize =
+      createInfo.sdf ? SDF_RENDER_SIZE : createInfo.size;
+  if (FT_Set_Pixel_Sizes(face, 0, renderSize) != 0) {
     FT_Done_Face(face);
     createInfo.success = false;
     createInfo.errorMsg = "Failed to set font size";
     return std::nullopt;
   }
 
-  return Font(face, createInfo.size);
+  const FontFile *key = file.get();
+  auto shared = std::make_shared<Face>(std::move(file), face, createInfo);
+  if (createInfo.sdf) {
+    setSdfSpread(library.getLibrary());
+    sdfFaces[key] = shared;
+  }
+  return Font(std::move(shared), createInfo.size);
 }
 
-Font::Font(FT_Face face, uint32_t size) : m_face(face) {
-  // Check if texture is valid before any operations
-  GLboolean isTexture = glIsTexture(m_atlas.getTexture());
+Font::Face::Face(std::shared_ptr<FontFile> file, FT_Face face,
+                 const CreateInfo &createInfo)
+    : file(std::move(file)), face(face),
+      atlas(createInfo.atlasPageSize, createInfo.atlasPageSize,
+            createInfo.atlasMaxPages),
+      renderSize(createInfo.sdf ? SDF_RENDER_SIZE : createInfo.size),
+      sdf(createInfo.sdf), hasKerning(FT_HAS_KERNING(face)) {
+  if (!hasKerning) {
+    return;
+  }
 
-  m_lineHeight = static_cast<float>(m_face->size->metrics.height >> 6);
-  m_baseline = static_cast<float>(m_face->size->metrics.ascender >> 6);
+  denseKerning.resize(DENSE_KERNING_SIZE * DENSE_KERNING_SIZE);
+  for (uint32_t first = 0; first < DENSE_KERNING_SIZE; first++) {
+    for (uint32_t second = 0; second < DENSE_KERNING_SIZE; second++) {
+      denseKerning[first * DENSE_KERNING_SIZE + second] =
+          static_cast<int16_t>(lookupKerning(first + DENSE_KERNING_FIRST,
+                                             second + DENSE_KERNING_FIRST));
+    }
+  }
+}
 
-  // Check after setup
-  isTexture = glIsTexture(m_atlas.getTexture());
+Font::Face::~Face() {
+  if (face) {
+    FT_Done_Face(face);
+  }
 }
 
-Font::~Font() {
-  if (m_face) {
-    FT_Done_Face(m_face);
+Font::Font(std::shared_ptr<Face> face, uint32_t size)
+    : m_face(std::move(face)) {
+  const FT_Size_Metrics &metrics = m_face->face->size->metrics;
+  if (m_face->sdf) {
+    m_scale = static_cast<float>(size) / SDF_RENDER_SIZE;
   }
+  m_lineHeight = static_cast<float>(metrics.height >> 6) * m_scale;
+  m_baseline = static_cast<float>(metrics.ascender >> 6) * m_scale;
 }
 
 Font::Font(Font &&other) noexcept
-    : m_face(other.m_face), m_atlas(std::move(other.m_atlas)),
-      m_lineHeight(other.m_lineHeight), m_baseline(other.m_baseline) {
-  other.m_face = nullptr;
-}
+    : m_face(std::move(other.m_face)), m_scale(other.m_scale),
+      m_lineHeight(other.m_lineHeight), m_baseline(other.m_baseline),
+      m_version(other.m_version) {}
 
 Font &Font::operator=(Font &&other) noexcept {
   if (this != &other) {
-    if (m_face) {
-      FT_Done_Face(m_face);
-    }
-    m_face = other.m_face;
-    m_atlas = std::move(other.m_atlas);
+    // The version has to change even if the new atlas' is lower
+    const uint32_t version = (m_face ? getVersion() : m_version) + 1;
+    m_face = std::move(other.m_face);
+    m_scale = other.m_scale;
     m_lineHeight = other.m_lineHeight;
     m_baseline = other.m_baseline;
-    other.m_face = nullptr;
+    m_version = version - m_face->atlas.getVersion();
   }
   return *this;
 }
@@ -297,33 +654,92 @@ bool Font::cacheGlyph(uint32_t codepoint) {
     return true;
   }
 
-  // Load glyph
-  if (FT_Load_Char(m_face, codepoint, FT_LOAD_RENDER) != 0) {
+  FontAtlas::GlyphBitmap glyph;
+  if (!rasterizeGlyph(m_face->face, codepoint, m_face->sdf, glyph)) {
     return false;
   }
-
-  // Get glyph bitmap
-  FT_GlyphSlot glyph = m_face->glyph;
-  return m_atlas.addGlyph(codepoint, glyph->bitmap.buffer, glyph->bitmap.width,
-                          glyph->bitmap.rows, glyph->bitmap_left,
-                          glyph->bitmap_top, glyph->advance.x >> 6);
+  return m_face->atlas.addGlyph(codepoint, glyph.pixels.data(), glyph.width,
+                                glyph.height, glyph.bearingX, glyph.bearingY,
+                                glyph.advance);
 }
 
-float Font::getKerning(uint32_t first, uint32_t second) const {
-  if (!FT_HAS_KERNING(m_face)) {
-    return 0.0f;
+uint32_t Font::prewarm(std::span<const CodepointRange> ranges,
+                       uint32_t threadCount) {
+  std::vector<uint32_t> codepoints;
+  for (const CodepointRange &range : ranges) {
+    for (uint64_t codepoint = range.first; codepoint <= range.last;
+         codepoint++) {
+      const auto value = static_cast<uint32_t>(codepoint);
+      if (!getGlyphInfo(value) && FT_Get_Char_Index(m_face->face, value)) {
+        codepoints.push_back(value);
+      }
+    }
   }
+  if (codepoints.empty()) {
+    return 0;
+  }
+
+  // Every worker opens the face first, small requests use fewer of them
+  constexpr size_t MIN_GLYPHS_PER_WORKER = 32;
+  if (threadCount == 0) {
+    threadCount = std::max(1u, std::thread::hardware_concurrency());
+  }
+  const size_t workers = std::clamp<size_t>(
+      codepoints.size() / MIN_GLYPHS_PER_WORKER, 1, threadCount);
+  const size_t perWorker = (codepoints.size() + workers - 1) / workers;
+
+  std::vector<std::future<std::vector<FontAtlas::GlyphBitmap>>> futures;
+  const std::span<const uint32_t> all = codepoints;
+  for (size_t first = 0; first < all.size(); first += perWorker) {
+    futures.push_back(std::async(
+        std::launch::async, rasterizeGlyphs, m_face->file,
+        m_face->renderSize, m_face->sdf,
+        all.subspan(first, std::min(perWorker, all.size() - first))));
+  }
+
+  std::vector<FontAtlas::GlyphBitmap> glyphs;
+  glyphs.reserve(codepoints.size());
+  for (auto &future : futures) {
+    auto part = future.get();
+    std::ranges::move(part, std::back_inserter(glyphs));
+  }
+  return m_face->atlas.addGlyphs(glyphs);
+}
 
+int Font::Face::lookupKerning(uint32_t first, uint32_t second) const {
   FT_Vector kerning;
-  FT_Get_Kerning(m_face, FT_Get_Char_Index(m_face, first),
-                 FT_Get_Char_Index(m_face, second), FT_KERNING_DEFAULT,
+  FT_Get_Kerning(face, FT_Get_Char_Index(face, first),
+                 FT_Get_Char_Index(face, second), FT_KERNING_DEFAULT,
                  &kerning);
+  return static_cast<int>(kerning.x >> 6);
+}
+
+int Font::Face::getKerning(uint32_t first, uint32_t second) {
+  // Layouts start with no previous character
+  if (!hasKerning || first == 0) {
+    return 0;
+  }
+
+  if (first >= DENSE_KERNING_FIRST && first <= DENSE_KERNING_LAST &&
+      second >= DENSE_KERNING_FIRST && second <= DENSE_KERNING_LAST) {
+    return denseKerning[(first - DENSE_KERNING_FIRST) * DENSE_KERNING_SIZE +
+                        second - DENSE_KERNING_FIRST];
+  }
+
+  const uint64_t key = (static_cast<uint64_t>(first) << 32) | second;
+  auto [it, inserted] = sparseKerning.try_emplace(key, int16_t{0});
+  if (inserted) {
+    it->second = static_cast<int16_t>(lookupKerning(first, second));
+  }
+  return it->second;
+}
 
-  return static_cast<float>(kerning.x >> 6);
+float Font::getKerning(uint32_t first, uint32_t second) const {
+  return static_cast<float>(m_face->getKerning(first, second)) * m_scale;
 }
 
 const FontAtlas::GlyphInfo *Font::getGlyphInfo(uint32_t codepoint) const {
-  return m_atlas.getGlyph(codepoint);
+  return m_face->atlas.getGlyph(codepoint);
 }
 
 TextRenderer::TextRenderer(std::shared_ptr<Renderer2D> renderer)
@@ -335,10 +751,11 @@ TextRenderer::calculateMetrics(const Font &font,
   TextMetrics metrics{0.0f, font.getLineHeight(), font.getBaseline()};
 
   uint32_t prevChar = 0;
-  for (char c : text) {
-    uint32_t codepoint = static_cast<uint32_t>(c);
+  for (size_t offset = 0; offset < text.size();) {
+    const uint32_t codepoint = decodeUtf8(text, offset);
     if (const auto *glyph = font.getGlyphInfo(codepoint)) {
-      metrics.width += glyph->advance + font.getKerning(prevChar, codepoint);
+      metrics.width += glyph->advance * font.getScale() +
+                       font.getKerning(prevChar, codepoint);
       prevChar = codepoint;
     }
   }
@@ -346,66 +763,109 @@ TextRenderer::calculateMetrics(const Font &font,
   return metrics;
 }
 
-void TextRenderer::renderText(Font &font, const std::string &text,
-                              const glm::vec2 &position,
-                              const glm::vec4 &color) {
+void TextRenderer::layoutText(Font &font, std::string_view text,
+                              TextLayout &layout) {
+  layout.vertices.clear();
+  layout.pages = 0;
+
+  m_codepoints.clear();
+  for (size_t offset = 0; offset < text.size();) {
+    m_codepoints.push_back(decodeUtf8(text, offset));
+  }
 
-  // Cache glyphs first
-  for (char c : text) {
-    uint32_t codepoint = static_cast<uint32_t>(c);
+  // Mark the pages of the glyphs already cached as used before caching the
+  // others, so making room for those never evicts them
+  FontAtlas &atlas = font.getAtlas();
+  atlas.setUseStamp(m_renderer->getSceneCount());
+  for (uint32_t codepoint : m_codepoints) {
+    if (const auto *glyph = font.getGlyphInfo(codepoint)) {
+      atlas.touchPage(glyph->page);
+    }
+  }
+  for (uint32_t codepoint : m_codepoints) {
     if (!font.getGlyphInfo(codepoint)) {
       font.cacheGlyph(codepoint);
     }
   }
 
-  // Store original blend state
-  GLint blendSrc, blendDst;
-  glGetIntegerv(GL_BLEND_SRC_ALPHA, &blendSrc);
-  glGetIntegerv(GL_BLEND_DST_ALPHA, &blendDst);
-
-  // Set up text blending
-  glEnable(GL_BLEND);
-  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-  glm::vec2 pen = position;
+  glm::vec2 min{std::numeric_limits<float>::max()};
+  glm::vec2 max{std::numeric_limits<float>::lowest()};
+  float penX = 0.0f;
   uint32_t prevChar = 0;
-  uint32_t fontTexture = font.getAtlasTexture();
-
-  // Create a TextureInfo for the font atlas
-  Renderer2D::TextureInfo fontTextureInfo{
-      fontTexture,
-      0, // Width not needed for atlas
-      0, // Height not needed for atlas
-      0  // Will be assigned by drawTexturedQuad
-  };
+  // Glyphs of SDF fonts are scaled from the atlas size and marked for the
+  // distance field shader
+  const float scale = font.getScale();
+  const float outlineThickness = font.isSdf() ? -1.0f : 0.0f;
 
-  for (char c : text) {
-    uint32_t codepoint = static_cast<uint32_t>(c);
+  for (uint32_t codepoint : m_codepoints) {
     const auto *glyph = font.getGlyphInfo(codepoint);
     if (!glyph)
       continue;
 
     // Apply kerning
-    pen.x += font.getKerning(prevChar, codepoint);
+    penX += font.getKerning(prevChar, codepoint);
+
+    // Advance pen and update previous character
+    const float glyphX = penX;
+    penX += glyph->advance * scale;
+    prevChar = codepoint;
+    if (glyph->width == 0 || glyph->height == 0) {
+      continue;
+    }
 
-    // Calculate glyph position
-    float x = pen.x + glyph->bearingX;
     // Position relative to baseline
-    float y = pen.y + (font.getBaseline() - glyph->bearingY);
+    const float x = glyphX + glyph->bearingX * scale;
+    const float y = font.getBaseline() - glyph->bearingY * scale;
+    const glm::vec2 size = glm::vec2(glyph->width, glyph->height) * scale;
+
+    // White and with the page as texture index, the color and the page's
+    // slot are filled in when drawn
+    auto &vertices = layout.vertices;
+    vertices.resize(vertices.size() + 4);
+    quad_kernels::generateScalar(
+        {.position = {x, y, 0.0f},
+         .size = size,
+         .texCoords = {glyph->u0, glyph->v0, glyph->u1, glyph->v1}},
+        static_cast<float>(glyph->page), outlineThickness,
+        {0.0f, 0.0f, 0.0f, 0.0f},
+        &vertices[vertices.size() - 4]);
+    min = glm::min(min, glm::vec2(x, y));
+    max = glm::max(max, glm::vec2(x, y) + size);
+    layout.pages |= 1u << glyph->page;
+  }
 
-    // Draw glyph
-    m_renderer->drawTexturedQuad(
-        {x + glyph->width * 0.5f, y + glyph->height * 0.5f, 0.0f},
-        fontTextureInfo, {glyph->width, glyph->height}, color, 0.0f,
-        {0.5f, 0.5f}, {glyph->u0, glyph->v0, glyph->u1, glyph->v1});
+  layout.bounds = layout.vertices.empty() ? AABB() : AABB(min, max);
+  layout.width = penX;
+}
 
-    // Advance pen and update previous character
-    pen.x += glyph->advance;
-    prevChar = codepoint;
+void TextRenderer::renderLayout(Font &font, const TextLayout &layout,
+                                const glm::vec2 &position,
+                                const glm::vec4 &color) {
+  if (layout.vertices.empty()) {
+    return;
   }
 
+  FontAtlas &atlas = font.getAtlas();
+  atlas.setUseStamp(m_renderer->getSceneCount());
+  atlas.touchPages(layout.pages);
+
+  // Text is always alpha blended, the renderer tracks the previous mode so
+  // there is no need to query GL for it
+  const BlendMode previousBlendMode = m_renderer->getBlendMode();
+  m_renderer->setBlendMode(BlendMode::Alpha);
+
+  m_renderer->drawQuadRun(layout.vertices, atlas.getTextures(), layout.bounds,
+                          position, color);
+
   // Restore original blend state
-  glBlendFunc(blendSrc, blendDst);
+  m_renderer->setBlendMode(previousBlendMode);
+}
+
+void TextRenderer::renderText(Font &font, const std::string &text,
+                              const glm::vec2 &position,
+                              const glm::vec4 &color) {
+  layoutText(font, text, m_scratch);
+  renderLayout(font, m_scratch, position, color);
 }
 
 Text TextRenderer::createText(Font &font, const std::string &text,
@@ -416,28 +876,26 @@ Text TextRenderer::createText(Font &font, const std::string &text,
 
 Text::Text(TextRenderer &renderer, Font &font, std::string text,
            const glm::vec2 &position, const glm::vec4 &color)
-    : m_renderer(renderer), m_font(font), m_text(std::move(text)),
+    : m_renderer(renderer), m_font(&font), m_text(std::move(text)),
       m_position(position), m_color(color) {
-  updateMetricsIfNeeded();
+  updateLayoutIfNeeded();
 }
 
-void Text::updateMetricsIfNeeded() {
-  if (m_needsMetricsUpdate) {
-    TextRenderer::TextMetrics metrics =
-        m_renderer.calculateMetrics(m_font, m_text);
-    // The total height should account for the font's full line height
-    float totalHeight = m_font.getLineHeight();
-    m_cachedSize = {metrics.width, totalHeight};
-    m_needsMetricsUpdate = false;
+void Text::updateLayoutIfNeeded() {
+  if (!m_needsLayout && m_fontVersion == m_font->getVersion()) {
+    return;
   }
+
+  m_renderer.layoutText(*m_font, m_text, m_layout);
+  // The total height should account for the font's full line height
+  m_cachedSize = {m_layout.width, m_font->getLineHeight()};
+  m_fontVersion = m_font->getVersion();
+  m_needsLayout = false;
 }
 
 void Text::render() {
-  updateMetricsIfNeeded();
-
-  if (!m_text.empty()) {
-    m_renderer.renderText(m_font, m_text, m_position, m_color);
-  }
+  updateLayoutIfNeeded();
+  m_renderer.renderLayout(*m_font, m_layout, m_position, m_color);
 }
 
-} // namespace ste
\ No newline at end of file
+} // namespace ste
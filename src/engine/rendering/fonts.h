@@ -3,8 +3,11 @@
 #include <ft2build.h>
 #include FT_FREETYPE_H
 #include <memory>
+#include <span>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <vector>
 
 #include "engine/utils.h"
 
@@ -31,18 +34,79 @@ private:
   std::string m_error;
 };
 
-// Font Atlas for caching glyphs
+// A font file read into memory once and shared by every face opened from
+// it, e.g. all sizes of a family. The file is memory mapped where the
+// platform allows, FreeType then reads the glyphs straight from the
+// mapping. Files stay open while a font (or the asset loader) holds them.
+class FontFile {
+public:
+  struct CreateInfo {
+    std::string errorMsg;
+    bool success = true;
+  };
+
+  // Returns the file already open at `path` if there is one
+  static std::shared_ptr<FontFile> open(const std::string &path,
+                                        CreateInfo &createInfo);
+
+  ~FontFile();
+  FontFile(const FontFile &) = delete;
+  FontFile &operator=(const FontFile &) = delete;
+
+  std::span<const uint8_t> getData() const { return {m_data, m_size}; }
+  const std::string &getPath() const { return m_path; }
+
+private:
+  explicit FontFile(std::string path) : m_path(std::move(path)) {}
+
+  std::string m_path;
+  const uint8_t *m_data{nullptr};
+  size_t m_size{0};
+  bool m_mapped{false};
+  // Contents where files can't be mapped
+  std::vector<uint8_t> m_buffer;
+};
+
+// Glyph cache spread over atlas pages that are allocated on demand, each
+// packed with a skyline packer. Once every page is full the least recently
+// used page is cleared to make room. Pages used with the current use stamp
+// (the scene being drawn) are never cleared, their glyphs may still be
+// waiting in a batch.
 class FontAtlas {
 public:
+  // Bit masks of pages are 32 bits wide
+  static constexpr uint32_t MAX_PAGES = 32;
+  // Empty texels right and below each glyph so linear filtering doesn't
+  // pick up a neighbor
+  static constexpr uint32_t PADDING = 1;
+
   struct GlyphInfo {
     float u0, v0; // Texture coordinates
     float u1, v1;
     int bearingX, bearingY; // Offset from baseline
     int advance;            // Horizontal advance
     int width, height;      // Size of glyph
+    uint32_t page;          // Index into getTextures()
   };
 
-  FontAtlas(uint32_t width = 1024, uint32_t height = 1024);
+  // A glyph rasterized elsewhere, e.g. on a worker thread, to be packed
+  struct GlyphBitmap {
+    uint32_t codepoint = 0;
+    uint32_t width = 0, height = 0;
+    int bearingX = 0, bearingY = 0;
+    int advance = 0;
+    std::vector<uint8_t> pixels; // width * height, tightly packed
+  };
+
+  struct Statistics {
+    uint32_t pages = 0;
+    uint32_t glyphs = 0;
+    uint32_t evictions = 0; // pages cleared to make room
+    uint32_t failedGlyphs = 0;
+  };
+
+  FontAtlas(uint32_t width = 512, uint32_t height = 512,
+            uint32_t maxPages = 8);
   ~FontAtlas();
 
   // Delete copy operations
@@ -53,23 +117,70 @@ public:
   FontAtlas(FontAtlas &&other) noexcept;
   FontAtlas &operator=(FontAtlas &&other) noexcept;
 
-  // Get atlas texture
-  uint32_t getTexture() const { return m_textureId; }
+  // Page textures, GlyphInfo::page indexes into them
+  std::span<const uint32_t> getTextures() const { return m_textures; }
 
   // Add glyph to atlas
   bool addGlyph(uint32_t codepoint, const uint8_t *bitmap, uint32_t width,
                 uint32_t height, int bearingX, int bearingY, int advance);
+  // Packs all glyphs, tallest first, and uploads them with one call per
+  // page they landed on. Returns how many were added.
+  uint32_t addGlyphs(std::span<const GlyphBitmap> glyphs);
 
   // Get glyph info
   const GlyphInfo *getGlyph(uint32_t codepoint) const;
 
+  // Usage tracking for eviction, a page is recently used when touched with
+  // the current stamp
+  void setUseStamp(uint64_t stamp) { m_useStamp = stamp; }
+  void touchPage(uint32_t page);
+  void touchPages(uint32_t pageMask);
+
+  // Changes whenever glyphs are evicted, their UVs may now hold others
+  uint32_t getVersion() const { return m_version; }
+
+  Statistics getStats() const;
+
 private:
-  bool findSpace(uint32_t width, uint32_t height, uint32_t &x, uint32_t &y);
+  struct SkylineNode {
+    uint32_t x, y;
+    uint32_t width;
+  };
+
+  struct Page {
+    uint32_t texture;
+    // Top edge of the packed area, left to right over the page width
+    std::vector<SkylineNode> skyline;
+    uint64_t lastUse = 0;
+    // CPU copy of the texture, regions of it are uploaded
+    std::vector<uint8_t> pixels;
+  };
+
+  bool createPage();
+  void clearPage(uint32_t page);
+  // Places a glyph at `x`, `y` of a page and copies it into the page's
+  // pixels, the upload is left to the caller. nullptr if there was no room.
+  const GlyphInfo *packGlyph(uint32_t codepoint, const uint8_t *bitmap,
+                             uint32_t width, uint32_t height, int bearingX,
+                             int bearingY, int advance, uint32_t &x,
+                             uint32_t &y);
+  void uploadRegion(const Page &page, uint32_t x, uint32_t y, uint32_t width,
+                    uint32_t height) const;
+  // Finds room on some page, evicting the coldest one if needed
+  bool allocate(uint32_t width, uint32_t height, uint32_t &page, uint32_t &x,
+                uint32_t &y);
+  bool fitSkyline(const Page &page, size_t index, uint32_t width,
+                  uint32_t height, uint32_t &y) const;
+  bool findSpace(Page &page, uint32_t width, uint32_t height, uint32_t &x,
+                 uint32_t &y);
 
-  uint32_t m_textureId;
   uint32_t m_width, m_height;
-  uint32_t m_currentX{0}, m_currentY{0};
-  uint32_t m_rowHeight{0};
+  uint32_t m_maxPages;
+  std::vector<Page> m_pages;
+  std::vector<uint32_t> m_textures; // of m_pages, for getTextures()
+  uint64_t m_useStamp{0};
+  uint32_t m_version{0};
+  Statistics m_stats{};
 
   std::unordered_map<uint32_t, GlyphInfo> m_glyphs;
 };
@@ -77,16 +188,36 @@ private:
 // Font class
 class Font {
 public:
+  // SDF glyphs are rendered once at this size, the field covers SDF_SPREAD
+  // pixels either side of the outline
+  static constexpr uint32_t SDF_RENDER_SIZE = 48;
+  static constexpr int SDF_SPREAD = 8;
+
   struct CreateInfo {
     std::string errorMsg;
     bool success = true;
     uint32_t size = 16; // Font size in pixels
+    // Glyph atlas pages, allocated as glyphs are cached
+    uint32_t atlasPageSize = 512;
+    uint32_t atlasMaxPages = 8;
+    // Signed distance field glyphs. SDF fonts of the same file share the
+    // face and one atlas, every size and zoom level only scales the quads.
+    bool sdf = false;
+  };
+
+  // Inclusive range of Unicode codepoints
+  struct CodepointRange {
+    uint32_t first;
+    uint32_t last;
   };
 
   static std::optional<Font> createFromFile(const std::string &path,
                                             CreateInfo &createInfo);
+  // Opens a face over a shared file, any number of fonts may use one
+  static std::optional<Font> create(std::shared_ptr<FontFile> file,
+                                    CreateInfo &createInfo);
 
-  ~Font();
+  ~Font() = default;
   Font(const Font &) = delete;
   Font &operator=(const Font &) = delete;
   Font(Font &&other) noexcept;
@@ -96,23 +227,88 @@ public:
   float getKerning(uint32_t first, uint32_t second) const;
   float getLineHeight() const { return m_lineHeight; }
   float getBaseline() const { return m_baseline; }
+  // Glyph metrics are in atlas pixels, times the scale they're in pixels
+  // at this font's size. Always 1 unless the font is SDF.
+  float getScale() const { return m_scale; }
+  bool isSdf() const { return m_face->sdf; }
 
   // Load glyph into atlas
   bool cacheGlyph(uint32_t codepoint);
+  // Caches the glyphs of `ranges` ahead of time so text using them later
+  // doesn't hitch. They are rasterized on worker threads, each with its
+  // own FreeType library and a face over the shared file, then packed and
+  // uploaded with one call per atlas page. Call on the render thread.
+  // Codepoints without a glyph in the face are skipped. Returns the number
+  // of glyphs added.
+  uint32_t prewarm(std::span<const CodepointRange> ranges,
+                   uint32_t threadCount = 0);
   const FontAtlas::GlyphInfo *getGlyphInfo(uint32_t codepoint) const;
-  uint32_t getAtlasTexture() const { return m_atlas.getTexture(); }
+  FontAtlas &getAtlas() { return m_face->atlas; }
+  const FontAtlas &getAtlas() const { return m_face->atlas; }
+
+  // Changes whenever glyphs laid out before may have moved, e.g. when the
+  // atlas (maybe shared with other sizes) evicted a page or another font
+  // is moved into this one
+  uint32_t getVersion() const {
+    return m_version + m_face->atlas.getVersion();
+  }
 
 private:
-  Font(FT_Face face, uint32_t size);
+  // Pairs of printable ASCII are kerned from a dense table
+  static constexpr uint32_t DENSE_KERNING_FIRST = 0x20;
+  static constexpr uint32_t DENSE_KERNING_LAST = 0x7e;
+  static constexpr uint32_t DENSE_KERNING_SIZE =
+      DENSE_KERNING_LAST - DENSE_KERNING_FIRST + 1;
+
+  // FreeType face and the atlas of its glyphs
+  struct Face {
+    // The face reads from the file, it has to outlive it
+    std::shared_ptr<FontFile> file;
+    FT_Face face{nullptr};
+    FontAtlas atlas;
+    uint32_t renderSize;
+    bool sdf = false;
+
+    // Kerning in pixels at the render size. The dense table is filled at
+    // load, other pairs are looked up once and remembered, so layout only
+    // calls into FreeType for pairs it has never seen.
+    bool hasKerning = false;
+    std::vector<int16_t> denseKerning;
+    std::unordered_map<uint64_t, int16_t> sparseKerning;
+
+    Face(std::shared_ptr<FontFile> file, FT_Face face,
+         const CreateInfo &createInfo);
+    ~Face();
+
+    int getKerning(uint32_t first, uint32_t second);
+
+  private:
+    int lookupKerning(uint32_t first, uint32_t second) const;
+  };
+
+  Font(std::shared_ptr<Face> face, uint32_t size);
 
-  FT_Face m_face{nullptr};
-  FontAtlas m_atlas;
+  std::shared_ptr<Face> m_face;
+  float m_scale{1.0f};
   float m_lineHeight{0};
   float m_baseline{0};
+  uint32_t m_version{0};
+};
+
+// Glyph quads of a line of text relative to its top left. The texIndex of
+// every vertex is the atlas page, the slot is filled in when drawn.
+struct TextLayout {
+  std::vector<Renderer2D::Vertex> vertices;
+  AABB bounds;
+  float width = 0.0f; // pen advance
+  uint32_t pages = 0; // bit per atlas page used
 };
 
 class TextRenderer;
 
+// Text whose glyph quads are laid out once and kept, rendering copies them
+// into the batch. The layout is only rebuilt when the text or the font
+// changes, position and color are applied while copying.
 class Text {
 public:
   Text(TextRenderer &renderer, Font &font, std::string text,
@@ -125,31 +321,39 @@ public:
   const glm::vec2 &getPosition() const { return m_position; }
   const std::string &getText() const { return m_text; }
   const glm::vec4 &getColor() const { return m_color; }
+  Font &getFont() const { return *m_font; }
 
   // Simple setters for position and color
   void setPosition(const glm::vec2 &position) { m_position = position; }
   void setColor(const glm::vec4 &color) { m_color = color; }
 
-  // Text changes require metrics update
+  // Text and font changes require a new layout
   void setText(std::string text) {
     if (m_text != text) {
       m_text = std::move(text);
-      m_needsMetricsUpdate = true;
+      m_needsLayout = true;
+    }
+  }
+  void setFont(Font &font) {
+    if (m_font != &font) {
+      m_font = &font;
+      m_needsLayout = true;
     }
   }
 
 private:
-  void updateMetricsIfNeeded();
+  void updateLayoutIfNeeded();
 
   TextRenderer &m_renderer;
-  Font &m_font;
+  Font *m_font;
   std::string m_text;
   glm::vec2 m_position;
   glm::vec4 m_color;
 
-  // Cached text metrics
+  TextLayout m_layout;
   glm::vec2 m_cachedSize{0.0f, 0.0f};
-  bool m_needsMetricsUpdate{true};
+  uint32_t m_fontVersion{0};
+  bool m_needsLayout{true};
 };
 
 // Text renderer
@@ -163,14 +367,21 @@ public:
 
   explicit TextRenderer(std::shared_ptr<Renderer2D> renderer);
 
-  // Calculate text metrics
+  // Calculate text metrics of UTF-8 text, only cached glyphs count
   TextMetrics calculateMetrics(const Font &font, const std::string &text) const;
 
+  // Caches the glyphs of the UTF-8 `text` and lays out their quads
+  void layoutText(Font &font, std::string_view text, TextLayout &layout);
+
   // Render text
   void renderText(Font &font, const std::string &text,
                   const glm::vec2 &position,
                   const glm::vec4 &color = {1, 1, 1, 1});
 
+  // Draws a layout made with the same font, its pages count as used
+  void renderLayout(Font &font, const TextLayout &layout,
+                    const glm::vec2 &position, const glm::vec4 &color);
+
   // Create text object
   Text createText(Font &font, const std::string &text,
                   const glm::vec2 &position,
@@ -178,6 +389,10 @@ public:
 
 private:
   std::shared_ptr<Renderer2D> m_renderer;
+  // Layout of the last renderText call, reused to avoid allocations
+  TextLayout m_scratch;
+  // Decoded text of the last layout
+  std::vector<uint32_t> m_codepoints;
 };
 
 } // namespace ste
\ No newline at end of file
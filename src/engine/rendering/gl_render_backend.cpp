@@ -0,0 +1,469 @@
+#include "gl_render_backend.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "gl_state.h"
+#include "render_profiler.h"
+
+namespace ste {
+
+namespace {
+const char *vertexShaderSource = R"(
+        #version 330 core
+        layout (location = 0) in vec3 a_Position;
+        layout (location = 1) in vec4 a_Color;
+        layout (location = 2) in vec2 a_TexCoord;
+        layout (location = 3) in float a_TexIndex;
+        layout (location = 4) in float a_TilingFactor;
+        layout (location = 5) in float a_OutlineThickness;
+        layout (location = 6) in vec4 a_OutlineColor;
+
+        layout (std140) uniform SceneData {
+            mat4 u_ViewProjection;
+        };
+
+        out vec4 v_Color;
+        out vec2 v_TexCoord;
+        out float v_TexIndex;
+        out float v_TilingFactor;
+        out float v_OutlineThickness;
+        out vec4 v_OutlineColor;
+
+        void main() {
+            v_Color = a_Color;
+            v_TexCoord = a_TexCoord;
+            v_TexIndex = a_TexIndex;
+            v_TilingFactor = a_TilingFactor;
+            v_OutlineThickness = a_OutlineThickness;
+            v_OutlineColor = a_OutlineColor;
+            gl_Position = u_ViewProjection * vec4(a_Position, 1.0);
+        }
+    )";
+
+// Shared by all permutations, buildFragmentSource() puts the #version and
+// the STE_* defines of the enabled shader_features in front
+const char *fragmentShaderSource = R"(
+        out vec4 FragColor;
+
+        in vec4 v_Color;
+        in vec2 v_TexCoord;
+        in float v_TexIndex;
+        in float v_TilingFactor;
+        in float v_OutlineThickness;
+        in vec4 v_OutlineColor;
+
+        #if defined(STE_TEXTURED) || defined(STE_SDF_TEXT)
+        uniform sampler2D u_Textures[16];
+
+        // GLSL 3.30 only allows constant sampler array indices, strict
+        // drivers such as Mesa reject u_Textures[texIndex]
+        vec4 sampleTexture(int index, vec2 uv) {
+            switch (index) {
+            case 1: return texture(u_Textures[1], uv);
+            case 2: return texture(u_Textures[2], uv);
+            case 3: return texture(u_Textures[3], uv);
+            case 4: return texture(u_Textures[4], uv);
+            case 5: return texture(u_Textures[5], uv);
+            case 6: return texture(u_Textures[6], uv);
+            case 7: return texture(u_Textures[7], uv);
+            case 8: return texture(u_Textures[8], uv);
+            case 9: return texture(u_Textures[9], uv);
+            case 10: return texture(u_Textures[10], uv);
+            case 11: return texture(u_Textures[11], uv);
+            case 12: return texture(u_Textures[12], uv);
+            case 13: return texture(u_Textures[13], uv);
+            case 14: return texture(u_Textures[14], uv);
+            case 15: return texture(u_Textures[15], uv);
+            default: return texture(u_Textures[0], uv);
+            }
+        }
+        #endif
+
+        void main() {
+            #ifdef STE_SHAPES
+            // SDF circle, ring or arc: the local position is in v_TexCoord,
+            // the inner radius in v_OutlineThickness and the arc's start
+            // and sweep in v_OutlineColor.xy
+            if (v_TilingFactor < 0.0) {
+                float dist = length(v_TexCoord);
+                float edge = fwidth(dist);
+                float coverage = 1.0 - smoothstep(1.0 - edge, 1.0, dist);
+                if (v_OutlineThickness > 0.0) {
+                    coverage *= smoothstep(v_OutlineThickness - edge,
+                                           v_OutlineThickness, dist);
+                }
+                if (v_OutlineColor.y < 6.2831853) {
+                    float angle = mod(atan(v_TexCoord.y, v_TexCoord.x) -
+                                      v_OutlineColor.x, 6.2831853);
+                    coverage *= step(angle, v_OutlineColor.y);
+                }
+                if (coverage <= 0.0) {
+                    discard;
+                }
+                FragColor = vec4(v_Color.rgb, v_Color.a * coverage);
+                return;
+            }
+            #endif
+
+            #ifdef STE_SDF_TEXT
+            // Glyph from a distance field atlas, marked by a negative
+            // v_OutlineThickness. The alpha is the distance to the outline
+            // with 0.5 on the edge, smoothed over a screen pixel so the
+            // edge stays sharp at any scale.
+            if (v_OutlineThickness < 0.0) {
+                float dist =
+                    sampleTexture(int(v_TexIndex + 0.5), v_TexCoord).a;
+                float edge = fwidth(dist) * 0.5;
+                float coverage = smoothstep(0.5 - edge, 0.5 + edge, dist);
+                if (coverage <= 0.0) {
+                    discard;
+                }
+                FragColor = vec4(v_Color.rgb, v_Color.a * coverage);
+                return;
+            }
+            #endif
+
+            vec4 texColor = v_Color;
+
+            #ifdef STE_TEXTURED
+            // Sample texture if we have a valid texture index, slot 0 is
+            // the white texture and can be skipped
+            int texIndex = int(v_TexIndex + 0.5);
+            if (texIndex > 0) {
+                texColor *= sampleTexture(texIndex, v_TexCoord * v_TilingFactor);
+            }
+            #endif
+
+            #ifdef STE_OUTLINED
+            // Calculate pixel scale for each axis
+            vec2 dx = dFdx(v_TexCoord);
+            vec2 dy = dFdy(v_TexCoord);
+            vec2 texSize = vec2(length(vec2(dx.x, dy.x)), length(vec2(dx.y, dy.y))) * 2.0;
+            
+            // Calculate distance from edge in normalized UV space
+            vec2 uvDist = abs(v_TexCoord - 0.5) * 2.0;
+            
+            // Convert outline thickness to UV space separately for each axis
+            vec2 thickness = vec2(v_OutlineThickness) * texSize;
+            
+            // Check if we're in the outline region on either axis
+            vec2 inner = vec2(1.0) - thickness;
+            bool inOutline = uvDist.x > inner.x || uvDist.y > inner.y;
+            
+            FragColor = inOutline && v_OutlineThickness > 0.0 ? v_OutlineColor : texColor;
+            #else
+            FragColor = texColor;
+            #endif
+        }
+    )";
+
+std::string buildFragmentSource(uint32_t features) {
+  std::string source = "#version 330 core\n";
+  if (features & shader_features::Textured) {
+    source += "#define STE_TEXTURED\n";
+  }
+  if (features & shader_features::Outlined) {
+    source += "#define STE_OUTLINED\n";
+  }
+  if (features & shader_features::Shapes) {
+    source += "#define STE_SHAPES\n";
+  }
+  if (features & shader_features::SdfText) {
+    source += "#define STE_SDF_TEXT\n";
+  }
+  return source + fragmentShaderSource;
+}
+
+// Block binding and sampler units never change, set them once per program
+void configureShader(const Shader &shader) {
+  shader.bindUniformBlock("SceneData", GLRenderBackend::SCENE_DATA_BINDING);
+
+  int samplers[RenderBackend::MAX_TEXTURE_SLOTS];
+  for (int i = 0; i < RenderBackend::MAX_TEXTURE_SLOTS; i++) {
+    samplers[i] = i;
+  }
+  shader.use();
+  shader.setUniformArray("u_Textures", samplers);
+}
+} // namespace
+
+std::shared_ptr<GLRenderBackend>
+GLRenderBackend::create(CreateInfo &createInfo) {
+  // The full featured permutation can draw any batch, it's compiled right
+  // away so errors surface here. The specialized ones compile in the
+  // background, batches needing them use the full one until they're ready.
+  Permutations shaders;
+  Shader::CreateInfo shaderInfo;
+  shaders[shader_features::All] = Shader::createFromMemory(
+      vertexShaderSource, buildFragmentSource(shader_features::All),
+      shaderInfo);
+  if (!shaders[shader_features::All]) {
+    createInfo.success = false;
+    createInfo.errorMsg = std::move(shaderInfo.errorMsg);
+    return nullptr;
+  }
+
+  for (uint32_t features = 0; features < shader_features::All; features++) {
+    Shader::CreateInfo permutationInfo;
+    shaders[features] = Shader::createFromMemoryAsync(
+        vertexShaderSource, buildFragmentSource(features), permutationInfo);
+  }
+
+  auto &state = GLStateCache::get();
+
+  // Enable alpha blending
+  state.setBlendMode(BlendMode::Alpha);
+  state.setDepthMode(DepthMode::None);
+
+  // Create vertex array
+  uint32_t vao;
+  glGenVertexArrays(1, &vao);
+  state.bindVertexArray(vao);
+
+  // Create vertex buffer, every frame in flight draws from its own range
+  // through the base vertex so the attributes are only specified once
+  uint32_t vbo;
+  glGenBuffers(1, &vbo);
+  state.bindArrayBuffer(vbo);
+  glBufferData(GL_ARRAY_BUFFER,
+               MAX_VERTICES * sizeof(QuadVertex) * BUFFER_COUNT, nullptr,
+               GL_DYNAMIC_DRAW);
+
+  // Vertex attributes
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(QuadVertex),
+                        (const void *)offsetof(QuadVertex, position));
+
+  glEnableVertexAttribArray(1);
+  glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(QuadVertex),
+                        (const void *)offsetof(QuadVertex, color));
+
+  glEnableVertexAttribArray(2);
+  glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(QuadVertex),
+                        (const void *)offsetof(QuadVertex, texCoords));
+
+  glEnableVertexAttribArray(3);
+  glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(QuadVertex),
+                        (const void *)offsetof(QuadVertex, texIndex));
+
+  glEnableVertexAttribArray(4);
+  glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, sizeof(QuadVertex),
+                        (const void *)offsetof(QuadVertex, tilingFactor));
+
+  glEnableVertexAttribArray(5);
+  glVertexAttribPointer(5, 1, GL_FLOAT, GL_FALSE, sizeof(QuadVertex),
+                        (const void *)offsetof(QuadVertex, outlineThickness));
+
+  glEnableVertexAttribArray(6);
+  glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(QuadVertex),
+                        (const void *)offsetof(QuadVertex, outlineColor));
+
+  // Create and set up index buffer
+  uint32_t ibo;
+  glGenBuffers(1, &ibo);
+
+  std::vector<uint32_t> indices(MAX_INDICES);
+  uint32_t offset = 0;
+  for (uint32_t i = 0; i < MAX_INDICES; i += 6) {
+    indices[i + 0] = offset + 0;
+    indices[i + 1] = offset + 1;
+    indices[i + 2] = offset + 2;
+    indices[i + 3] = offset + 2;
+    indices[i + 4] = offset + 3;
+    indices[i + 5] = offset + 0;
+    offset += 4;
+  }
+
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t),
+               indices.data(), GL_STATIC_DRAW);
+
+  // Scene constants live in a uniform buffer updated once per beginScene
+  uint32_t ubo;
+  glGenBuffers(1, &ubo);
+  state.bindUniformBuffer(ubo);
+  glBufferData(GL_UNIFORM_BUFFER, sizeof(SceneData), nullptr, GL_DYNAMIC_DRAW);
+
+  return std::make_shared<GLRenderBackend>(std::move(shaders), vao, vbo, ibo,
+                                           ubo);
+}
+
+GLRenderBackend::GLRenderBackend(Permutations &&shaders, uint32_t vao,
+                                 uint32_t vbo, uint32_t ibo, uint32_t ubo)
+    : m_shaders(std::move(shaders)), m_VAO(vao), m_VBO(vbo), m_IBO(ibo),
+      m_UBO(ubo) {
+  configureShader(*m_shaders[shader_features::All]);
+  m_configured[shader_features::All] = true;
+
+  uint8_t whitePixel[4] = {255, 255, 255, 255};
+  glGenTextures(1, &m_whiteTexture);
+  GLStateCache::get().bindTexture(m_whiteTexture);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+               whitePixel);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+GLRenderBackend::~GLRenderBackend() {
+  // Clean up sync objects
+  for (uint32_t i = 0; i < BUFFER_COUNT; ++i) {
+    if (m_fences[i]) {
+      glDeleteSync(m_fences[i]);
+    }
+  }
+
+  auto &state = GLStateCache::get();
+  state.onVertexArrayDeleted(m_VAO);
+  state.onBufferDeleted(m_VBO);
+  state.onBufferDeleted(m_UBO);
+  state.onTextureDeleted(m_whiteTexture);
+
+  glDeleteVertexArrays(1, &m_VAO);
+  glDeleteBuffers(1, &m_VBO);
+  glDeleteBuffers(1, &m_IBO);
+  glDeleteBuffers(1, &m_UBO);
+  glDeleteTextures(1, &m_whiteTexture);
+}
+
+void GLRenderBackend::beginScene(const glm::mat4 &viewProjection) {
+  // Upload the scene constants once, every batch reads them from the UBO.
+  // The binding point is shared with other backends and renderers, so it's
+  // claimed again for each scene.
+  SceneData sceneData{viewProjection};
+  GLStateCache::get().bindUniformBufferBase(SCENE_DATA_BINDING, m_UBO);
+  glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(SceneData), &sceneData);
+  m_depthCleared = false;
+}
+
+void GLRenderBackend::endScene() {
+  // Other renderers draw after the scene without depth testing or clipping
+  auto &state = GLStateCache::get();
+  state.setDepthMode(DepthMode::None);
+  state.setScissorTestEnabled(false);
+}
+
+void GLRenderBackend::waitForBuffer(uint32_t bufferIndex) {
+  if (m_fences[bufferIndex]) {
+    RenderProfiler::CpuTimer timer(RenderProfiler::CpuCounter::Stall);
+
+    // Wait for the fence with a timeout, anything but an already signaled
+    // fence means the CPU got ahead of the GPU
+    GLenum result;
+    bool stalled = false;
+    do {
+      result =
+          glClientWaitSync(m_fences[bufferIndex], GL_SYNC_FLUSH_COMMANDS_BIT,
+                           MAX_SYNC_WAIT_NANOS);
+      stalled |= result != GL_ALREADY_SIGNALED;
+    } while (result == GL_TIMEOUT_EXPIRED);
+
+    if (stalled) {
+      RenderProfiler::get().addStall();
+    }
+
+    glDeleteSync(m_fences[bufferIndex]);
+    m_fences[bufferIndex] = nullptr;
+  }
+}
+
+const Shader &GLRenderBackend::selectShader(uint32_t features) {
+  features &= shader_features::All;
+  auto &shader = m_shaders[features];
+  if (!m_configured[features] && shader) {
+    // Batches draw with the full shader until the background compile is done
+    switch (shader->poll()) {
+    case Shader::Status::Pending:
+      break;
+    case Shader::Status::Ready:
+      configureShader(*shader);
+      m_configured[features] = true;
+      break;
+    case Shader::Status::Failed:
+      std::cerr << "Shader permutation " << features
+                << " failed, using the full shader: "
+                << shader->getErrorMsg() << std::endl;
+      shader.reset();
+      break;
+    }
+  }
+  return m_configured[features] ? *shader : *m_shaders[shader_features::All];
+}
+
+void GLRenderBackend::submit(const RenderBatch &batch) {
+  // Wait for the current buffer to be available
+  waitForBuffer(m_currentBuffer);
+
+  const auto dataSize =
+      static_cast<GLsizeiptr>(batch.vertices.size_bytes());
+  const auto bufferOffset = static_cast<GLintptr>(
+      m_currentBuffer * MAX_VERTICES * sizeof(QuadVertex));
+
+  auto &state = GLStateCache::get();
+
+  // Update buffer data
+  state.bindArrayBuffer(m_VBO);
+  {
+    RenderProfiler::CpuTimer timer(RenderProfiler::CpuCounter::Upload);
+    glBufferSubData(GL_ARRAY_BUFFER, bufferOffset, dataSize,
+                    batch.vertices.data());
+  }
+
+  // Slot 0 is always the white texture, the cache skips units that are
+  // already bound from the previous batch
+  state.bindTexture(0, m_whiteTexture);
+  for (uint32_t i = 1; i < batch.textures.size(); i++) {
+    state.bindTexture(i, batch.textures[i]);
+  }
+
+  state.setBlendMode(batch.blendMode);
+
+  // The depth buffer is only cleared for scenes that actually use it
+  if (batch.depthMode != DepthMode::None && !m_depthCleared) {
+    state.setDepthWriteEnabled(true);
+    state.setScissorTestEnabled(false);
+    glClear(GL_DEPTH_BUFFER_BIT);
+    m_depthCleared = true;
+  }
+  state.setDepthMode(batch.depthMode);
+
+  if (batch.clipRect) {
+    // Clip rectangles are resolved against the viewport at draw time, so
+    // they follow whatever target the scene renders into
+    int viewport[4];
+    state.getViewport(viewport);
+    const glm::vec4 &clip = *batch.clipRect;
+    const auto toPixel = [](float ndc, int origin, int extent) {
+      return origin + static_cast<int>(std::lround((ndc * 0.5f + 0.5f) *
+                                                   static_cast<float>(extent)));
+    };
+    const int minX = toPixel(clip.x, viewport[0], viewport[2]);
+    const int minY = toPixel(clip.y, viewport[1], viewport[3]);
+    const int maxX = toPixel(clip.z, viewport[0], viewport[2]);
+    const int maxY = toPixel(clip.w, viewport[1], viewport[3]);
+    state.setScissorTestEnabled(true);
+    state.setScissor(minX, minY, std::max(maxX - minX, 0),
+                     std::max(maxY - minY, 0));
+  } else {
+    state.setScissorTestEnabled(false);
+  }
+
+  // Draw, the base vertex selects the range of the buffer in use. Batches
+  // with the same features share the program, GLStateCache skips the
+  // switch.
+  selectShader(batch.shaderFeatures).use();
+  state.bindVertexArray(m_VAO);
+  glDrawElementsBaseVertex(GL_TRIANGLES, batch.indexCount, GL_UNSIGNED_INT,
+                           nullptr,
+                           static_cast<GLint>(m_currentBuffer * MAX_VERTICES));
+
+  // Place fence for this buffer
+  m_fences[m_currentBuffer] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+  // Move to next buffer
+  m_currentBuffer = (m_currentBuffer + 1) % BUFFER_COUNT;
+}
+
+} // namespace ste
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include <glad/glad.h>
+
+#include "render_backend.h"
+#include "shader.h"
+
+namespace ste {
+
+// OpenGL 3.3+ backend. Batches are uploaded into a ring of BUFFER_COUNT
+// vertex ranges guarded by fences, scene constants live in a uniform buffer.
+// Each batch is drawn with the shader permutation matching its
+// shader_features, so the program only changes at batch boundaries.
+class GLRenderBackend : public RenderBackend {
+public:
+  // Uniform buffer binding of the std140 SceneData block (u_ViewProjection),
+  // other GL renderers can bind their block here to share the scene camera
+  static constexpr uint32_t SCENE_DATA_BINDING = 0;
+
+  struct CreateInfo {
+    std::string errorMsg;
+    bool success = true;
+  };
+
+  // Shader per shader_features combination, nullopt when it failed to
+  // compile. The full featured one is always present.
+  using Permutations =
+      std::array<std::optional<Shader>, shader_features::PermutationCount>;
+
+  static std::shared_ptr<GLRenderBackend> create(CreateInfo &createInfo);
+
+  GLRenderBackend(Permutations &&shaders, uint32_t vao, uint32_t vbo,
+                  uint32_t ibo, uint32_t ubo);
+  ~GLRenderBackend() override;
+  GLRenderBackend(const GLRenderBackend &) = delete;
+  GLRenderBackend &operator=(const GLRenderBackend &) = delete;
+
+  const char *getName() const override { return "opengl"; }
+
+  void beginScene(const glm::mat4 &viewProjection) override;
+  void endScene() override;
+  void submit(const RenderBatch &batch) override;
+
+private:
+  static constexpr uint32_t BUFFER_COUNT = 3;
+  static constexpr uint64_t MAX_SYNC_WAIT_NANOS = 1000000000;
+
+  // Per-scene constants, mirrors the std140 SceneData block in the shaders
+  struct SceneData {
+    glm::mat4 viewProjection;
+  };
+
+  Permutations m_shaders;
+  // Permutations whose compile was checked and uniforms set
+  std::array<bool, shader_features::PermutationCount> m_configured{};
+  uint32_t m_VAO{0};
+  uint32_t m_VBO{0};
+  uint32_t m_IBO{0};
+  uint32_t m_UBO{0};
+  uint32_t m_whiteTexture{0};
+
+  uint32_t m_currentBuffer{0};
+  bool m_depthCleared{false};
+  GLsync m_fences[BUFFER_COUNT]{nullptr};
+
+  void waitForBuffer(uint32_t bufferIndex);
+  // Falls back to the full featured shader while a permutation compiles or
+  // if it failed
+  const Shader &selectShader(uint32_t features);
+};
+
+} // namespace ste
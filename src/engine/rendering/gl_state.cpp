@@ -0,0 +1,417 @@
+#include "gl_state.h"
+
+namespace ste {
+
+void GLStateCache::useProgram(uint32_t program) {
+  if (m_program == program) {
+    m_stats.elidedCalls++;
+    return;
+  }
+
+  glUseProgram(program);
+  m_program = program;
+  m_stats.issuedCalls++;
+}
+
+void GLStateCache::bindVertexArray(uint32_t vao) {
+  if (m_vao == vao) {
+    m_stats.elidedCalls++;
+    return;
+  }
+
+  glBindVertexArray(vao);
+  m_vao = vao;
+  m_stats.issuedCalls++;
+}
+
+void GLStateCache::bindArrayBuffer(uint32_t buffer) {
+  if (m_arrayBuffer == buffer) {
+    m_stats.elidedCalls++;
+    return;
+  }
+
+  glBindBuffer(GL_ARRAY_BUFFER, buffer);
+  m_arrayBuffer = buffer;
+  m_stats.issuedCalls++;
+}
+
+void GLStateCache::bindUniformBuffer(uint32_t buffer) {
+  if (m_uniformBuffer == buffer) {
+    m_stats.elidedCalls++;
+    return;
+  }
+
+  glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+  m_uniformBuffer = buffer;
+  m_stats.issuedCalls++;
+}
+
+void GLStateCache::bindUniformBufferBase(uint32_t index, uint32_t buffer) {
+  if (index < MAX_UNIFORM_BUFFER_BINDINGS &&
+      m_uniformBufferBases[index] == buffer) {
+    m_stats.elidedCalls++;
+    return;
+  }
+
+  glBindBufferBase(GL_UNIFORM_BUFFER, index, buffer);
+  if (index < MAX_UNIFORM_BUFFER_BINDINGS) {
+    m_uniformBufferBases[index] = buffer;
+  }
+  m_uniformBuffer = buffer;
+  m_stats.issuedCalls++;
+}
+
+void GLStateCache::bindFramebuffer(uint32_t framebuffer) {
+  if (m_framebuffer == framebuffer) {
+    m_stats.elidedCalls++;
+    return;
+  }
+
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  m_framebuffer = framebuffer;
+  m_stats.issuedCalls++;
+  m_stats.framebufferSwitches++;
+}
+
+void GLStateCache::setViewport(int x, int y, int width, int height) {
+  if (m_viewport[0] == x && m_viewport[1] == y && m_viewport[2] == width &&
+      m_viewport[3] == height) {
+    m_stats.elidedCalls++;
+    return;
+  }
+
+  glViewport(x, y, width, height);
+  m_viewport[0] = x;
+  m_viewport[1] = y;
+  m_viewport[2] = width;
+  m_viewport[3] = height;
+  m_stats.issuedCalls++;
+}
+
+void GLStateCache::getViewport(int (&viewport)[4]) {
+  if (m_viewport[2] < 0) {
+    glGetIntegerv(GL_VIEWPORT, m_viewport);
+  }
+  for (int i = 0; i < 4; i++) {
+    viewport[i] = m_viewport[i];
+  }
+}
+
+void GLStateCache::setScissorTestEnabled(bool enabled) {
+  if (m_scissorEnabled == static_cast<int>(enabled)) {
+    m_stats.elidedCalls++;
+    return;
+  }
+
+  if (enabled) {
+    glEnable(GL_SCISSOR_TEST);
+  } else {
+    glDisable(GL_SCISSOR_TEST);
+  }
+  m_scissorEnabled = static_cast<int>(enabled);
+  m_stats.issuedCalls++;
+}
+
+void GLStateCache::setScissor(int x, int y, int width, int height) {
+  if (m_scissor[0] == x && m_scissor[1] == y && m_scissor[2] == width &&
+      m_scissor[3] == height) {
+    m_stats.elidedCalls++;
+    return;
+  }
+
+  glScissor(x, y, width, height);
+  m_scissor[0] = x;
+  m_scissor[1] = y;
+  m_scissor[2] = width;
+  m_scissor[3] = height;
+  m_stats.issuedCalls++;
+}
+
+void GLStateCache::setActiveUnit(uint32_t unit) {
+  if (m_activeUnit == unit) {
+    return;
+  }
+
+  glActiveTexture(GL_TEXTURE0 + unit);
+  m_activeUnit = unit;
+  m_stats.issuedCalls++;
+}
+
+void GLStateCache::bindTexture(uint32_t unit, uint32_t texture) {
+  if (unit >= MAX_TEXTURE_UNITS) {
+    setActiveUnit(unit);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    m_stats.issuedCalls++;
+    return;
+  }
+
+  if (m_textures[unit] == texture) {
+    m_stats.elidedCalls++;
+    return;
+  }
+
+  setActiveUnit(unit);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  m_textures[unit] = texture;
+  m_stats.issuedCalls++;
+}
+
+void GLStateCache::bindTexture(uint32_t texture) {
+  bindTexture(m_activeUnit == UNKNOWN ? 0 : m_activeUnit, texture);
+}
+
+void GLStateCache::bindTextureBuffer(uint32_t unit, uint32_t texture) {
+  if (unit < MAX_TEXTURE_UNITS && m_textures[unit] == texture) {
+    m_stats.elidedCalls++;
+    return;
+  }
+
+  setActiveUnit(unit);
+  glBindTexture(GL_TEXTURE_BUFFER, texture);
+  if (unit < MAX_TEXTURE_UNITS) {
+    m_textures[unit] = texture;
+  }
+  m_stats.issuedCalls++;
+}
+
+void GLStateCache::bindTextureArray(uint32_t unit, uint32_t texture) {
+  if (unit < MAX_TEXTURE_UNITS && m_textures[unit] == texture) {
+    m_stats.elidedCalls++;
+    return;
+  }
+
+  setActiveUnit(unit);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+  if (unit < MAX_TEXTURE_UNITS) {
+    m_textures[unit] = texture;
+  }
+  m_stats.issuedCalls++;
+}
+
+void GLStateCache::setBlendEnabled(bool enabled) {
+  if (m_blendEnabled == static_cast<int>(enabled)) {
+    m_stats.elidedCalls++;
+    return;
+  }
+
+  if (enabled) {
+    glEnable(GL_BLEND);
+  } else {
+    glDisable(GL_BLEND);
+  }
+  m_blendEnabled = static_cast<int>(enabled);
+  m_stats.issuedCalls++;
+}
+
+void GLStateCache::setBlendFunc(GLenum src, GLenum dst) {
+  setBlendFuncSeparate(src, dst, src, dst);
+}
+
+void GLStateCache::setBlendFuncSeparate(GLenum srcColor, GLenum dstColor,
+                                        GLenum srcAlpha, GLenum dstAlpha) {
+  if (m_blendSrc == srcColor && m_blendDst == dstColor &&
+      m_blendSrcAlpha == srcAlpha && m_blendDstAlpha == dstAlpha) {
+    m_stats.elidedCalls++;
+    return;
+  }
+
+  glBlendFuncSeparate(srcColor, dstColor, srcAlpha, dstAlpha);
+  m_blendSrc = srcColor;
+  m_blendDst = dstColor;
+  m_blendSrcAlpha = srcAlpha;
+  m_blendDstAlpha = dstAlpha;
+  m_stats.issuedCalls++;
+}
+
+void GLStateCache::setBlendEquation(GLenum equation) {
+  if (m_blendEquation == equation) {
+    m_stats.elidedCalls++;
+    return;
+  }
+
+  glBlendEquation(equation);
+  m_blendEquation = equation;
+  m_stats.issuedCalls++;
+}
+
+void GLStateCache::setBlendMode(BlendMode mode) {
+  switch (mode) {
+  case BlendMode::None:
+    setBlendEnabled(false);
+    break;
+
+  // Destination alpha accumulates coverage (the "over" operator), so
+  // offscreen targets end up premultiplied and composite correctly
+  case BlendMode::Alpha:
+    setBlendEnabled(true);
+    setBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE,
+                         GL_ONE_MINUS_SRC_ALPHA);
+    setBlendEquation(GL_FUNC_ADD);
+    break;
+
+  case BlendMode::Premultiplied:
+    setBlendEnabled(true);
+    setBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    setBlendEquation(GL_FUNC_ADD);
+    break;
+
+  case BlendMode::Additive:
+    setBlendEnabled(true);
+    setBlendFunc(GL_SRC_ALPHA, GL_ONE);
+    setBlendEquation(GL_FUNC_ADD);
+    break;
+
+  case BlendMode::Multiply:
+    setBlendEnabled(true);
+    setBlendFunc(GL_DST_COLOR, GL_ZERO);
+    setBlendEquation(GL_FUNC_ADD);
+    break;
+
+  case BlendMode::Screen:
+    setBlendEnabled(true);
+    setBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_COLOR);
+    setBlendEquation(GL_FUNC_ADD);
+    break;
+
+  case BlendMode::Subtract:
+    setBlendEnabled(true);
+    setBlendFunc(GL_SRC_ALPHA, GL_ONE);
+    setBlendEquation(GL_FUNC_REVERSE_SUBTRACT);
+    break;
+  }
+}
+
+void GLStateCache::setDepthTestEnabled(bool enabled) {
+  if (m_depthTestEnabled == static_cast<int>(enabled)) {
+    m_stats.elidedCalls++;
+    return;
+  }
+
+  if (enabled) {
+    glEnable(GL_DEPTH_TEST);
+  } else {
+    glDisable(GL_DEPTH_TEST);
+  }
+  m_depthTestEnabled = static_cast<int>(enabled);
+  m_stats.issuedCalls++;
+}
+
+void GLStateCache::setDepthWriteEnabled(bool enabled) {
+  if (m_depthWriteEnabled == static_cast<int>(enabled)) {
+    m_stats.elidedCalls++;
+    return;
+  }
+
+  glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+  m_depthWriteEnabled = static_cast<int>(enabled);
+  m_stats.issuedCalls++;
+}
+
+void GLStateCache::setDepthFunc(GLenum func) {
+  if (m_depthFunc == func) {
+    m_stats.elidedCalls++;
+    return;
+  }
+
+  glDepthFunc(func);
+  m_depthFunc = func;
+  m_stats.issuedCalls++;
+}
+
+void GLStateCache::setDepthMode(DepthMode mode) {
+  switch (mode) {
+  case DepthMode::None:
+    setDepthTestEnabled(false);
+    break;
+
+  // Opaque quads are drawn front to back, at equal depth the first one
+  // drawn wins
+  case DepthMode::Opaque:
+    setDepthTestEnabled(true);
+    setDepthWriteEnabled(true);
+    setDepthFunc(GL_LESS);
+    break;
+
+  // Transparent quads draw over opaque ones at the same depth
+  case DepthMode::Transparent:
+    setDepthTestEnabled(true);
+    setDepthWriteEnabled(false);
+    setDepthFunc(GL_LEQUAL);
+    break;
+  }
+}
+
+void GLStateCache::onProgramDeleted(uint32_t program) {
+  if (m_program == program) {
+    m_program = UNKNOWN;
+  }
+}
+
+void GLStateCache::onVertexArrayDeleted(uint32_t vao) {
+  if (m_vao == vao) {
+    m_vao = 0;
+  }
+}
+
+void GLStateCache::onBufferDeleted(uint32_t buffer) {
+  if (m_arrayBuffer == buffer) {
+    m_arrayBuffer = 0;
+  }
+  if (m_uniformBuffer == buffer) {
+    m_uniformBuffer = 0;
+  }
+  for (uint32_t &bound : m_uniformBufferBases) {
+    if (bound == buffer) {
+      bound = 0;
+    }
+  }
+}
+
+void GLStateCache::onTextureDeleted(uint32_t texture) {
+  for (uint32_t &bound : m_textures) {
+    if (bound == texture) {
+      bound = 0;
+    }
+  }
+}
+
+void GLStateCache::onFramebufferDeleted(uint32_t framebuffer) {
+  if (m_framebuffer == framebuffer) {
+    m_framebuffer = 0;
+  }
+}
+
+void GLStateCache::invalidate() {
+  m_program = UNKNOWN;
+  m_vao = UNKNOWN;
+  m_arrayBuffer = UNKNOWN;
+  m_uniformBuffer = UNKNOWN;
+  for (uint32_t &bound : m_uniformBufferBases) {
+    bound = UNKNOWN;
+  }
+  m_framebuffer = UNKNOWN;
+  for (int &value : m_viewport) {
+    value = -1;
+  }
+  m_scissorEnabled = -1;
+  for (int &value : m_scissor) {
+    value = -1;
+  }
+  m_activeUnit = UNKNOWN;
+  for (uint32_t &bound : m_textures) {
+    bound = UNKNOWN;
+  }
+
+  m_blendEnabled = -1;
+  m_blendSrc = UNKNOWN;
+  m_blendDst = UNKNOWN;
+  m_blendSrcAlpha = UNKNOWN;
+  m_blendDstAlpha = UNKNOWN;
+  m_blendEquation = UNKNOWN;
+
+  m_depthTestEnabled = -1;
+  m_depthWriteEnabled = -1;
+  m_depthFunc = UNKNOWN;
+}
+
+} // namespace ste
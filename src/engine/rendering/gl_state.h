@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstdint>
+
+#include <glad/glad.h>
+
+#include "render_backend.h"
+
+namespace ste {
+
+// Shadow copy of the GL state the renderer touches most often. Redundant
+// binds and state changes are dropped before they reach the driver. All
+// engine code binding programs, VAOs, 2D textures or changing blend state
+// should go through here, otherwise call invalidate() afterwards.
+class GLStateCache {
+public:
+  static constexpr uint32_t MAX_TEXTURE_UNITS = 16;
+  static constexpr uint32_t MAX_UNIFORM_BUFFER_BINDINGS = 8;
+
+  struct Statistics {
+    uint32_t issuedCalls = 0;
+    uint32_t elidedCalls = 0;
+    uint32_t framebufferSwitches = 0;
+  };
+
+  static GLStateCache &get() {
+    static GLStateCache instance;
+    return instance;
+  }
+
+  GLStateCache(const GLStateCache &) = delete;
+  GLStateCache &operator=(const GLStateCache &) = delete;
+
+  void useProgram(uint32_t program);
+  void bindVertexArray(uint32_t vao);
+  void bindArrayBuffer(uint32_t buffer);
+  void bindUniformBuffer(uint32_t buffer);
+  // Attaches a UBO to an indexed binding point, also binding it to
+  // GL_UNIFORM_BUFFER as glBindBufferBase does
+  void bindUniformBufferBase(uint32_t index, uint32_t buffer);
+  void bindFramebuffer(uint32_t framebuffer);
+  // Framebuffer that stands in for 0, e.g. the offscreen target of a
+  // headless context
+  void setDefaultFramebuffer(uint32_t framebuffer) {
+    m_defaultFramebuffer = framebuffer;
+  }
+  uint32_t getDefaultFramebuffer() const { return m_defaultFramebuffer; }
+  void setViewport(int x, int y, int width, int height);
+  // Queries GL only while the viewport is unknown
+  void getViewport(int (&viewport)[4]);
+
+  void setScissorTestEnabled(bool enabled);
+  void setScissor(int x, int y, int width, int height);
+
+  // Binds a GL_TEXTURE_2D to the given unit, switching the active unit only
+  // when the binding actually changes
+  void bindTexture(uint32_t unit, uint32_t texture);
+  // Binds to whichever unit is currently active, for uploads
+  void bindTexture(uint32_t texture);
+  // Binds a GL_TEXTURE_BUFFER, tracked with the 2D bindings since texture
+  // names are unique across targets
+  void bindTextureBuffer(uint32_t unit, uint32_t texture);
+  // Same for a GL_TEXTURE_2D_ARRAY
+  void bindTextureArray(uint32_t unit, uint32_t texture);
+
+  void setBlendEnabled(bool enabled);
+  void setBlendFunc(GLenum src, GLenum dst);
+  void setBlendFuncSeparate(GLenum srcColor, GLenum dstColor, GLenum srcAlpha,
+                            GLenum dstAlpha);
+  void setBlendEquation(GLenum equation);
+  // Enable, function and equation for one of the engine blend modes
+  void setBlendMode(BlendMode mode);
+
+  void setDepthTestEnabled(bool enabled);
+  void setDepthWriteEnabled(bool enabled);
+  void setDepthFunc(GLenum func);
+  // Test, write and function for one of the engine depth modes
+  void setDepthMode(DepthMode mode);
+
+  // Deleted objects are unbound by GL, keep the shadow state in sync
+  void onProgramDeleted(uint32_t program);
+  void onVertexArrayDeleted(uint32_t vao);
+  void onBufferDeleted(uint32_t buffer);
+  void onTextureDeleted(uint32_t texture);
+  void onFramebufferDeleted(uint32_t framebuffer);
+
+  // Forget everything, the next call of each kind is always issued
+  void invalidate();
+
+  void resetStats() { m_stats = Statistics(); }
+  Statistics getStats() const { return m_stats; }
+
+private:
+  // Sentinel that never matches a real object name
+  static constexpr uint32_t UNKNOWN = 0xFFFFFFFF;
+
+  GLStateCache() { invalidate(); }
+
+  void setActiveUnit(uint32_t unit);
+
+  uint32_t m_program;
+  uint32_t m_vao;
+  uint32_t m_arrayBuffer;
+  uint32_t m_uniformBuffer;
+  uint32_t m_uniformBufferBases[MAX_UNIFORM_BUFFER_BINDINGS];
+  uint32_t m_framebuffer;
+  uint32_t m_defaultFramebuffer = 0;
+  int m_viewport[4];
+  int m_scissorEnabled; // -1 when unknown
+  int m_scissor[4];
+  uint32_t m_activeUnit;
+  uint32_t m_textures[MAX_TEXTURE_UNITS];
+
+  int m_blendEnabled; // -1 when unknown
+  GLenum m_blendSrc;
+  GLenum m_blendDst;
+  GLenum m_blendSrcAlpha;
+  GLenum m_blendDstAlpha;
+  GLenum m_blendEquation;
+
+  int m_depthTestEnabled; // -1 when unknown
+  int m_depthWriteEnabled;
+  GLenum m_depthFunc;
+
+  Statistics m_stats{};
+};
+
+} // namespace ste
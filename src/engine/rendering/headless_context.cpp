@@ -0,0 +1,287 @@
+#include "headless_context.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include <glad/glad.h>
+
+#ifdef STE_HAS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include "gl_state.h"
+
+namespace ste {
+
+bool Image::writePAM(const std::string &path) const {
+  std::ofstream file(path, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+
+  file << "P7\nWIDTH " << width << "\nHEIGHT " << height
+       << "\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n";
+  file.write(reinterpret_cast<const char *>(pixels.data()),
+             static_cast<std::streamsize>(pixels.size()));
+  return static_cast<bool>(file);
+}
+
+std::optional<Image> Image::readPAM(const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return std::nullopt;
+  }
+
+  std::string line;
+  std::getline(file, line);
+  if (line != "P7") {
+    return std::nullopt;
+  }
+
+  Image image;
+  int depth = 0;
+  while (std::getline(file, line) && line != "ENDHDR") {
+    std::istringstream header(line);
+    std::string key;
+    header >> key;
+    if (key == "WIDTH") {
+      header >> image.width;
+    } else if (key == "HEIGHT") {
+      header >> image.height;
+    } else if (key == "DEPTH") {
+      header >> depth;
+    }
+  }
+
+  if (depth != 4 || image.width <= 0 || image.height <= 0) {
+    return std::nullopt;
+  }
+
+  image.pixels.resize(static_cast<size_t>(image.width) * image.height * 4);
+  file.read(reinterpret_cast<char *>(image.pixels.data()),
+            static_cast<std::streamsize>(image.pixels.size()));
+  if (!file) {
+    return std::nullopt;
+  }
+  return image;
+}
+
+ImageDiff compareImages(const Image &a, const Image &b, uint8_t tolerance) {
+  ImageDiff diff;
+  if (a.width != b.width || a.height != b.height ||
+      a.pixels.size() != b.pixels.size()) {
+    diff.sizeMismatch = true;
+    return diff;
+  }
+
+  for (size_t i = 0; i < a.pixels.size(); i += 4) {
+    uint8_t pixelDelta = 0;
+    for (size_t c = 0; c < 4; c++) {
+      const int delta = std::abs(static_cast<int>(a.pixels[i + c]) -
+                                 static_cast<int>(b.pixels[i + c]));
+      pixelDelta = std::max(pixelDelta, static_cast<uint8_t>(delta));
+    }
+
+    diff.maxChannelDelta = std::max(diff.maxChannelDelta, pixelDelta);
+    if (pixelDelta > tolerance) {
+      diff.mismatchedPixels++;
+    }
+  }
+
+  return diff;
+}
+
+std::shared_ptr<HeadlessContext>
+HeadlessContext::create(CreateInfo &createInfo) {
+#ifdef STE_HAS_EGL
+  auto fail = [&](const std::string &message) {
+    createInfo.success = false;
+    createInfo.errorMsg = message;
+    return nullptr;
+  };
+
+  // Prefer the surfaceless platform, it needs neither a display server nor
+  // a GPU device
+  EGLDisplay display = EGL_NO_DISPLAY;
+  const char *clientExtensions =
+      eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+  if (clientExtensions &&
+      std::strstr(clientExtensions, "EGL_MESA_platform_surfaceless")) {
+    auto getPlatformDisplay =
+        reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+            eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (getPlatformDisplay) {
+      display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA,
+                                   EGL_DEFAULT_DISPLAY, nullptr);
+    }
+  }
+  if (display == EGL_NO_DISPLAY) {
+    display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  }
+  if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr)) {
+    return fail("Failed to initialize an EGL display");
+  }
+
+  if (!eglBindAPI(EGL_OPENGL_API)) {
+    eglTerminate(display);
+    return fail("EGL implementation does not support desktop OpenGL");
+  }
+
+  const EGLint configAttributes[] = {EGL_SURFACE_TYPE,
+                                     EGL_PBUFFER_BIT,
+                                     EGL_RENDERABLE_TYPE,
+                                     EGL_OPENGL_BIT,
+                                     EGL_RED_SIZE,
+                                     8,
+                                     EGL_GREEN_SIZE,
+                                     8,
+                                     EGL_BLUE_SIZE,
+                                     8,
+                                     EGL_ALPHA_SIZE,
+                                     8,
+                                     EGL_NONE};
+  EGLConfig config;
+  EGLint configCount = 0;
+  if (!eglChooseConfig(display, configAttributes, &config, 1, &configCount) ||
+      configCount == 0) {
+    eglTerminate(display);
+    return fail("No suitable EGL config found");
+  }
+
+  const EGLint contextAttributes[] = {EGL_CONTEXT_MAJOR_VERSION,
+                                      createInfo.glMajor,
+                                      EGL_CONTEXT_MINOR_VERSION,
+                                      createInfo.glMinor,
+                                      EGL_CONTEXT_OPENGL_PROFILE_MASK,
+                                      EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                                      EGL_NONE};
+  EGLContext context =
+      eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+  if (context == EGL_NO_CONTEXT) {
+    eglTerminate(display);
+    return fail("Failed to create an EGL OpenGL context");
+  }
+
+  // Surfaceless if possible, otherwise a pbuffer just to make it current
+  EGLSurface surface = EGL_NO_SURFACE;
+  const char *displayExtensions = eglQueryString(display, EGL_EXTENSIONS);
+  const bool surfaceless =
+      displayExtensions &&
+      std::strstr(displayExtensions, "EGL_KHR_surfaceless_context");
+  if (!surfaceless) {
+    const EGLint surfaceAttributes[] = {EGL_WIDTH, createInfo.width,
+                                        EGL_HEIGHT, createInfo.height,
+                                        EGL_NONE};
+    surface = eglCreatePbufferSurface(display, config, surfaceAttributes);
+    if (surface == EGL_NO_SURFACE) {
+      eglDestroyContext(display, context);
+      eglTerminate(display);
+      return fail("Failed to create an EGL pbuffer surface");
+    }
+  }
+
+  if (!eglMakeCurrent(display, surface, surface, context)) {
+    if (surface != EGL_NO_SURFACE) {
+      eglDestroySurface(display, surface);
+    }
+    eglDestroyContext(display, context);
+    eglTerminate(display);
+    return fail("Failed to make the EGL context current");
+  }
+
+  if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress)) {
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (surface != EGL_NO_SURFACE) {
+      eglDestroySurface(display, surface);
+    }
+    eglDestroyContext(display, context);
+    eglTerminate(display);
+    return fail("Failed to initialize GLAD");
+  }
+
+  auto headless = std::shared_ptr<HeadlessContext>(new HeadlessContext(
+      display, context, surface, createInfo.width, createInfo.height));
+
+  // The offscreen target acts as the default framebuffer from here on
+  RenderTarget::CreateInfo targetInfo;
+  targetInfo.width = createInfo.width;
+  targetInfo.height = createInfo.height;
+  targetInfo.filter = GL_NEAREST;
+  targetInfo.depth = true; // matches the window's 24 bit depth buffer
+  headless->m_target = RenderTarget::create(targetInfo);
+  if (!headless->m_target) {
+    return fail(targetInfo.errorMsg);
+  }
+
+  auto &state = GLStateCache::get();
+  state.invalidate();
+  state.setDefaultFramebuffer(headless->m_target->getFramebuffer());
+  RenderTarget::bindDefault(createInfo.width, createInfo.height);
+
+  return headless;
+#else
+  createInfo.success = false;
+  createInfo.errorMsg = "Headless rendering requires an engine built with EGL";
+  return nullptr;
+#endif
+}
+
+HeadlessContext::HeadlessContext(void *display, void *context, void *surface,
+                                 int width, int height)
+    : m_display(display), m_context(context), m_surface(surface),
+      m_width(width), m_height(height) {}
+
+HeadlessContext::~HeadlessContext() {
+  // GL objects have to go while the context is still current
+  m_target.reset();
+  GLStateCache::get().setDefaultFramebuffer(0);
+  GLStateCache::get().invalidate();
+
+#ifdef STE_HAS_EGL
+  EGLDisplay display = static_cast<EGLDisplay>(m_display);
+  eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  if (m_surface) {
+    eglDestroySurface(display, static_cast<EGLSurface>(m_surface));
+  }
+  eglDestroyContext(display, static_cast<EGLContext>(m_context));
+  eglTerminate(display);
+#endif
+}
+
+void HeadlessContext::clearColor(float r, float g, float b, float a) {
+  RenderTarget::bindDefault(m_width, m_height);
+  glClearColor(r, g, b, a);
+  glClear(GL_COLOR_BUFFER_BIT);
+}
+
+Image HeadlessContext::readPixels() const {
+  Image image;
+  image.width = m_width;
+  image.height = m_height;
+  image.pixels.resize(static_cast<size_t>(m_width) * m_height * 4);
+
+  GLStateCache::get().bindFramebuffer(m_target->getFramebuffer());
+  glFinish();
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, m_width, m_height, GL_RGBA, GL_UNSIGNED_BYTE,
+               image.pixels.data());
+
+  // GL rows start at the bottom
+  const size_t rowSize = static_cast<size_t>(m_width) * 4;
+  std::vector<uint8_t> row(rowSize);
+  for (int y = 0; y < m_height / 2; y++) {
+    uint8_t *top = image.pixels.data() + y * rowSize;
+    uint8_t *bottom = image.pixels.data() + (m_height - 1 - y) * rowSize;
+    std::memcpy(row.data(), top, rowSize);
+    std::memcpy(top, bottom, rowSize);
+    std::memcpy(bottom, row.data(), rowSize);
+  }
+
+  return image;
+}
+
+} // namespace ste
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "render_target.h"
+
+namespace ste {
+
+// RGBA8 image in top-down row order
+struct Image {
+  int width = 0;
+  int height = 0;
+  std::vector<uint8_t> pixels;
+
+  // Binary PAM (P7, RGB_ALPHA), a PPM variant that keeps the alpha channel
+  bool writePAM(const std::string &path) const;
+  static std::optional<Image> readPAM(const std::string &path);
+};
+
+struct ImageDiff {
+  uint32_t mismatchedPixels = 0;
+  uint8_t maxChannelDelta = 0;
+  bool sizeMismatch = false;
+};
+
+// Per channel comparison, pixels differing by more than `tolerance` in any
+// channel count as mismatched
+ImageDiff compareImages(const Image &a, const Image &b, uint8_t tolerance = 0);
+
+// OpenGL context without a window or display, for benchmarks and golden
+// image tests on machines without a GPU (Mesa llvmpipe works). Rendering
+// goes to an offscreen target that replaces the default framebuffer, so code
+// written against a Window renders unchanged.
+//
+// Uses EGL, surfaceless when EGL_MESA_platform_surfaceless and
+// EGL_KHR_surfaceless_context are available, a pbuffer otherwise. Only
+// available when the engine is built with STE_HAS_EGL.
+class HeadlessContext {
+public:
+  struct CreateInfo {
+    std::string errorMsg;
+    bool success = true;
+    int width = 1280;
+    int height = 720;
+    int glMajor = 4;
+    int glMinor = 1;
+  };
+
+  static std::shared_ptr<HeadlessContext> create(CreateInfo &createInfo);
+
+  ~HeadlessContext();
+  HeadlessContext(const HeadlessContext &) = delete;
+  HeadlessContext &operator=(const HeadlessContext &) = delete;
+
+  int getWidth() const { return m_width; }
+  int getHeight() const { return m_height; }
+
+  void clearColor(float r, float g, float b, float a);
+
+  // Waits for rendering to finish and reads the frame back
+  Image readPixels() const;
+
+private:
+  HeadlessContext(void *display, void *context, void *surface, int width,
+                  int height);
+
+  void *m_display{nullptr};
+  void *m_context{nullptr};
+  void *m_surface{nullptr};
+  int m_width{0};
+  int m_height{0};
+  std::optional<RenderTarget> m_target;
+};
+
+} // namespace ste
@@ -0,0 +1,82 @@
+#include "indirect_draw.h"
+
+#include <algorithm>
+
+#include "render_profiler.h"
+
+namespace ste {
+
+bool IndirectDrawBuffer::isSupported() {
+  const bool core43 =
+      GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 3);
+  // Without base instance every command would read the same per draw data
+  const bool baseInstance = GLAD_GL_ARB_base_instance || core43;
+  return (GLAD_GL_ARB_multi_draw_indirect || core43) && baseInstance;
+}
+
+IndirectDrawBuffer::~IndirectDrawBuffer() {
+  if (m_buffer != 0) {
+    glDeleteBuffers(1, &m_buffer);
+  }
+}
+
+void IndirectDrawBuffer::clear() {
+  m_commands.clear();
+  m_dirty = true;
+}
+
+void IndirectDrawBuffer::add(const Command &command) {
+  m_commands.push_back(command);
+  m_dirty = true;
+}
+
+void IndirectDrawBuffer::upload() {
+  if (m_buffer == 0) {
+    glGenBuffers(1, &m_buffer);
+  }
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_buffer);
+
+  RenderProfiler::CpuTimer timer(RenderProfiler::CpuCounter::Upload);
+  const size_t bytes = m_commands.size() * sizeof(Command);
+  // Orphan the buffer so the driver never waits on the previous frame
+  m_bufferSize = std::max(m_bufferSize, bytes);
+  glBufferData(GL_DRAW_INDIRECT_BUFFER, m_bufferSize, nullptr,
+               GL_STREAM_DRAW);
+  glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, bytes, m_commands.data());
+  m_dirty = false;
+}
+
+uint32_t IndirectDrawBuffer::submit(GLenum mode, size_t first, size_t count,
+                                    const FallbackCallback &fallback) {
+  first = std::min(first, m_commands.size());
+  count = std::min(count, m_commands.size() - first);
+  if (count == 0) {
+    return 0;
+  }
+
+  if (m_indirectEnabled) {
+    if (m_dirty) {
+      upload();
+    } else {
+      // Not tracked by the state cache, other code may have rebound it
+      glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_buffer);
+    }
+    glMultiDrawArraysIndirect(
+        mode, reinterpret_cast<const void *>(first * sizeof(Command)),
+        static_cast<GLsizei>(count), sizeof(Command));
+    return 1;
+  }
+
+  for (size_t i = first; i < first + count; i++) {
+    const Command &command = m_commands[i];
+    if (fallback) {
+      fallback(command);
+    }
+    glDrawArraysInstanced(mode, static_cast<GLint>(command.first),
+                          static_cast<GLsizei>(command.count),
+                          static_cast<GLsizei>(command.instanceCount));
+  }
+  return static_cast<uint32_t>(count);
+}
+
+} // namespace ste
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include <glad/glad.h>
+
+namespace ste {
+
+// Draw commands recorded on the CPU and submitted together. With
+// multi-draw indirect (GL 4.3 or ARB_multi_draw_indirect plus base
+// instance) a range of commands is a single glMultiDrawArraysIndirect no
+// matter how many it holds, otherwise every command is drawn in a loop.
+class IndirectDrawBuffer {
+public:
+  // Layout of GL's DrawArraysIndirectCommand
+  struct Command {
+    uint32_t count = 0;
+    uint32_t instanceCount = 1;
+    uint32_t first = 0;
+    // Offsets attributes with a divisor, the loop fallback ignores it
+    uint32_t baseInstance = 0;
+  };
+
+  // Called before each draw of the fallback loop so per draw data the
+  // indirect path reads through baseInstance can be set another way
+  using FallbackCallback = std::function<void(const Command &command)>;
+
+  static bool isSupported();
+
+  IndirectDrawBuffer() = default;
+  ~IndirectDrawBuffer();
+  IndirectDrawBuffer(const IndirectDrawBuffer &) = delete;
+  IndirectDrawBuffer &operator=(const IndirectDrawBuffer &) = delete;
+
+  // Commands without the indirect path are drawn in a loop, e.g. to
+  // compare both or work around a driver
+  void setIndirectEnabled(bool enabled) {
+    m_indirectEnabled = enabled && isSupported();
+  }
+  bool isIndirectEnabled() const { return m_indirectEnabled; }
+
+  void clear();
+  void add(const Command &command);
+  size_t size() const { return m_commands.size(); }
+  bool empty() const { return m_commands.empty(); }
+
+  // Draws `count` commands starting at `first` with the bound program and
+  // VAO. All commands are uploaded once on the first submit after a
+  // change. Returns the number of GL draw calls issued.
+  uint32_t submit(GLenum mode, size_t first, size_t count,
+                  const FallbackCallback &fallback = {});
+  uint32_t submit(GLenum mode, const FallbackCallback &fallback = {}) {
+    return submit(mode, 0, m_commands.size(), fallback);
+  }
+
+private:
+  void upload();
+
+  std::vector<Command> m_commands;
+  uint32_t m_buffer{0};
+  size_t m_bufferSize{0};
+  bool m_dirty{false};
+  bool m_indirectEnabled{isSupported()};
+};
+
+} // namespace ste
@@ -0,0 +1,447 @@
+#include "lighting.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+#include <glad/glad.h>
+
+#include "gl_state.h"
+#include "render_profiler.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)
+#define STE_LIGHTING_SSE2 1
+#include <immintrin.h>
+#endif
+
+namespace ste {
+
+namespace {
+constexpr uint32_t SIMD_WIDTH = 4;
+// Position of the padding lights, far enough to never reach a tile
+constexpr float FAR_AWAY = -1.0e18f;
+
+// Fullscreen triangle from gl_VertexID: (-1,-1), (3,-1), (-1,3)
+const char *lightVertexShaderSource = R"(
+        #version 330 core
+        uniform mat4 u_InverseViewProjection;
+
+        out vec2 v_World;
+
+        void main() {
+            vec2 ndc = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2) * 2.0 - 1.0;
+            vec4 world = u_InverseViewProjection * vec4(ndc, 0.0, 1.0);
+            v_World = world.xy / world.w;
+            gl_Position = vec4(ndc, 0.0, 1.0);
+        }
+    )";
+
+const char *lightFragmentShaderSource = R"(
+        #version 330 core
+        out vec4 FragColor;
+
+        in vec2 v_World;
+
+        // 3 texels per light:
+        //   position.xy, radius, intensity
+        //   color.rgb, cos(outer angle)
+        //   direction.xy, cos(inner angle), unused
+        uniform samplerBuffer u_Lights;
+        uniform usamplerBuffer u_TileHeaders; // offset, count
+        uniform usamplerBuffer u_LightIndices;
+        uniform int u_TilesX;
+        uniform int u_TileSize;
+        uniform vec3 u_Ambient;
+
+        void main() {
+            ivec2 tile = ivec2(gl_FragCoord.xy) / u_TileSize;
+            uvec2 header = texelFetch(u_TileHeaders,
+                                      tile.y * u_TilesX + tile.x).rg;
+
+            vec3 light = u_Ambient;
+            for (uint i = 0u; i < header.y; i++) {
+                int index = int(texelFetch(u_LightIndices,
+                                           int(header.x + i)).r) * 3;
+                vec4 shape = texelFetch(u_Lights, index);
+                vec4 color = texelFetch(u_Lights, index + 1);
+                vec4 cone = texelFetch(u_Lights, index + 2);
+
+                vec2 toFragment = v_World - shape.xy;
+                float distance = length(toFragment);
+                float falloff = clamp(1.0 - distance / shape.z, 0.0, 1.0);
+                float spot = smoothstep(color.w, cone.z,
+                                        dot(toFragment / max(distance, 1e-4),
+                                            cone.xy));
+                light += color.rgb * (shape.w * falloff * falloff * spot);
+            }
+            FragColor = vec4(light, 1.0);
+        }
+    )";
+
+const char *compositeVertexShaderSource = R"(
+        #version 330 core
+        out vec2 v_TexCoord;
+
+        void main() {
+            vec2 ndc = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2) * 2.0 - 1.0;
+            v_TexCoord = ndc * 0.5 + 0.5;
+            gl_Position = vec4(ndc, 0.0, 1.0);
+        }
+    )";
+
+const char *compositeFragmentShaderSource = R"(
+        #version 330 core
+        out vec4 FragColor;
+
+        in vec2 v_TexCoord;
+
+        uniform sampler2D u_LightBuffer;
+
+        void main() {
+            FragColor = vec4(texture(u_LightBuffer, v_TexCoord).rgb, 1.0);
+        }
+    )";
+
+// Bit i is set when light i of the group reaches the span [min, max] on one
+// axis, `gapSq` receives the squared distance to the span
+uint32_t spanMask(const float *center, const float *radiusSq, float min,
+                  float max, float *gapSq) {
+#if defined(STE_LIGHTING_SSE2)
+  const __m128 c = _mm_loadu_ps(center);
+  const __m128 gap = _mm_max_ps(
+      _mm_max_ps(_mm_sub_ps(_mm_set1_ps(min), c),
+                 _mm_sub_ps(c, _mm_set1_ps(max))),
+      _mm_setzero_ps());
+  const __m128 squared = _mm_mul_ps(gap, gap);
+  _mm_storeu_ps(gapSq, squared);
+  return static_cast<uint32_t>(
+      _mm_movemask_ps(_mm_cmple_ps(squared, _mm_loadu_ps(radiusSq))));
+#else
+  uint32_t mask = 0;
+  for (uint32_t i = 0; i < SIMD_WIDTH; i++) {
+    const float gap = std::max({min - center[i], center[i] - max, 0.0f});
+    gapSq[i] = gap * gap;
+    mask |= static_cast<uint32_t>(gapSq[i] <= radiusSq[i]) << i;
+  }
+  return mask;
+#endif
+}
+
+// Bit i is set when the circle of light i overlaps the tile spanning
+// [min, max] horizontally, the vertical gap comes from the row pass
+uint32_t tileMask(const float *x, const float *gapSqY, const float *radiusSq,
+                  float min, float max) {
+#if defined(STE_LIGHTING_SSE2)
+  const __m128 cx = _mm_loadu_ps(x);
+  const __m128 gap = _mm_max_ps(
+      _mm_max_ps(_mm_sub_ps(_mm_set1_ps(min), cx),
+                 _mm_sub_ps(cx, _mm_set1_ps(max))),
+      _mm_setzero_ps());
+  const __m128 distanceSq = _mm_add_ps(_mm_mul_ps(gap, gap),
+                                       _mm_loadu_ps(gapSqY));
+  return static_cast<uint32_t>(
+      _mm_movemask_ps(_mm_cmple_ps(distanceSq, _mm_loadu_ps(radiusSq))));
+#else
+  uint32_t mask = 0;
+  for (uint32_t i = 0; i < SIMD_WIDTH; i++) {
+    const float gap = std::max({min - x[i], x[i] - max, 0.0f});
+    mask |= static_cast<uint32_t>(gap * gap + gapSqY[i] <= radiusSq[i]) << i;
+  }
+  return mask;
+#endif
+}
+
+std::optional<Shader> compileShader(const char *vertexSource,
+                                    const char *fragmentSource,
+                                    LightRenderer::CreateInfo &createInfo) {
+  Shader::CreateInfo shaderInfo;
+  auto shader =
+      Shader::createFromMemory(vertexSource, fragmentSource, shaderInfo);
+  if (!shader) {
+    createInfo.success = false;
+    createInfo.errorMsg = std::move(shaderInfo.errorMsg);
+  }
+  return shader;
+}
+
+} // namespace
+
+std::shared_ptr<LightRenderer> LightRenderer::create(CreateInfo &createInfo) {
+  if (createInfo.resolutionScale <= 0.0f) {
+    createInfo.success = false;
+    createInfo.errorMsg = "Light buffer scale must be positive";
+    return nullptr;
+  }
+
+  auto lightShader = compileShader(lightVertexShaderSource,
+                                   lightFragmentShaderSource, createInfo);
+  if (!lightShader) {
+    return nullptr;
+  }
+  auto compositeShader = compileShader(
+      compositeVertexShaderSource, compositeFragmentShaderSource, createInfo);
+  if (!compositeShader) {
+    return nullptr;
+  }
+
+  lightShader->use();
+  lightShader->setUniform("u_Lights", static_cast<int>(LightData));
+  lightShader->setUniform("u_TileHeaders", static_cast<int>(TileHeaders));
+  lightShader->setUniform("u_LightIndices", static_cast<int>(LightIndices));
+  lightShader->setUniform("u_TileSize", TILE_SIZE);
+
+  compositeShader->use();
+  compositeShader->setUniform("u_LightBuffer", 0);
+
+  // Light data and tile lists live in buffer textures, GL 3.3 has no
+  // storage buffers
+  const GLenum formats[BufferCount] = {GL_RGBA32F, GL_RG32UI, GL_R16UI};
+  uint32_t buffers[BufferCount];
+  uint32_t textures[BufferCount];
+  glGenBuffers(BufferCount, buffers);
+  glGenTextures(BufferCount, textures);
+  auto &state = GLStateCache::get();
+  for (uint32_t i = 0; i < BufferCount; i++) {
+    glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+    glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+    state.bindTextureBuffer(i, textures[i]);
+    glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers[i]);
+  }
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+  // Corners come from gl_VertexID, the VAO has no attributes
+  uint32_t vao;
+  glGenVertexArrays(1, &vao);
+
+  return std::make_shared<LightRenderer>(
+      std::move(*lightShader), std::move(*compositeShader), vao, buffers,
+      textures, createInfo.resolutionScale);
+}
+
+LightRenderer::LightRenderer(Shader &&lightShader, Shader &&compositeShader,
+                             uint32_t vao, const uint32_t (&buffers)[3],
+                             const uint32_t (&textures)[3],
+                             float resolutionScale)
+    : m_lightShader(std::move(lightShader)),
+      m_compositeShader(std::move(compositeShader)), m_VAO(vao),
+      m_resolutionScale(resolutionScale) {
+  for (uint32_t i = 0; i < BufferCount; i++) {
+    m_buffers[i] = buffers[i];
+    m_textures[i] = textures[i];
+    m_bufferSizes[i] = 16;
+  }
+}
+
+LightRenderer::~LightRenderer() {
+  auto &state = GLStateCache::get();
+  for (uint32_t i = 0; i < BufferCount; i++) {
+    state.onTextureDeleted(m_textures[i]);
+  }
+  state.onVertexArrayDeleted(m_VAO);
+
+  glDeleteTextures(BufferCount, m_textures);
+  glDeleteBuffers(BufferCount, m_buffers);
+  glDeleteVertexArrays(1, &m_VAO);
+}
+
+void LightRenderer::addLight(const Light &light) {
+  if (m_lights.size() < MAX_LIGHTS) {
+    m_lights.push_back(light);
+  }
+}
+
+void LightRenderer::binLights(const glm::ivec2 &bufferSize) {
+  const float tileSize = static_cast<float>(TILE_SIZE);
+  m_tilesX = (bufferSize.x + TILE_SIZE - 1) / TILE_SIZE;
+  m_tilesY = (bufferSize.y + TILE_SIZE - 1) / TILE_SIZE;
+  m_tileHeaders.assign(static_cast<size_t>(m_tilesX) * m_tilesY,
+                       glm::uvec2(0));
+  m_lightIndices.clear();
+
+  const uint32_t lightCount = static_cast<uint32_t>(m_screenX.size());
+  float gapSq[SIMD_WIDTH];
+
+  for (int tileY = 0; tileY < m_tilesY; tileY++) {
+    // Narrow the lights down to the ones reaching this row first, the
+    // tiles of the row then only test those
+    const float minY = tileY * tileSize;
+    m_rowLights.clear();
+    m_rowX.clear();
+    m_rowGapSq.clear();
+    m_rowRadiusSq.clear();
+    for (uint32_t i = 0; i < lightCount; i += SIMD_WIDTH) {
+      uint32_t mask = spanMask(&m_screenY[i], &m_screenRadiusSq[i], minY,
+                               minY + tileSize, gapSq);
+      while (mask) {
+        const uint32_t lane = std::countr_zero(mask);
+        mask &= mask - 1;
+        m_rowLights.push_back(static_cast<uint16_t>(i + lane));
+        m_rowX.push_back(m_screenX[i + lane]);
+        m_rowGapSq.push_back(gapSq[lane]);
+        m_rowRadiusSq.push_back(m_screenRadiusSq[i + lane]);
+      }
+    }
+    if (m_rowLights.empty()) {
+      continue;
+    }
+
+    const size_t rowCount = m_rowLights.size();
+    const size_t paddedCount =
+        (rowCount + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+    m_rowX.resize(paddedCount, FAR_AWAY);
+    m_rowGapSq.resize(paddedCount, 0.0f);
+    m_rowRadiusSq.resize(paddedCount, 0.0f);
+
+    for (int tileX = 0; tileX < m_tilesX; tileX++) {
+      const float minX = tileX * tileSize;
+      const auto offset = static_cast<uint32_t>(m_lightIndices.size());
+      for (size_t i = 0; i < paddedCount; i += SIMD_WIDTH) {
+        uint32_t mask = tileMask(&m_rowX[i], &m_rowGapSq[i],
+                                 &m_rowRadiusSq[i], minX, minX + tileSize);
+        while (mask) {
+          const uint32_t lane = std::countr_zero(mask);
+          mask &= mask - 1;
+          m_lightIndices.push_back(m_rowLights[i + lane]);
+        }
+      }
+      m_tileHeaders[tileY * m_tilesX + tileX] = {
+          offset, static_cast<uint32_t>(m_lightIndices.size()) - offset};
+    }
+  }
+}
+
+void LightRenderer::upload(Buffer buffer, const void *data, size_t size) {
+  glBindBuffer(GL_TEXTURE_BUFFER, m_buffers[buffer]);
+  // Orphan the previous storage so the driver never waits on last frame
+  m_bufferSizes[buffer] = std::max(m_bufferSizes[buffer], size);
+  glBufferData(GL_TEXTURE_BUFFER, m_bufferSizes[buffer], nullptr,
+               GL_STREAM_DRAW);
+  if (size > 0) {
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+  }
+}
+
+void LightRenderer::addPasses(RenderGraph &graph, RenderGraph::Resource output,
+                              const glm::mat4 &viewProjection) {
+  RenderGraph::TargetDesc bufferDesc;
+  bufferDesc.scale = m_resolutionScale;
+  bufferDesc.filter = GL_LINEAR;
+  const auto lightBuffer = graph.createTarget("Light Buffer", bufferDesc);
+
+  RenderGraph::PassDesc lightsDesc;
+  lightsDesc.name = "Lights";
+  lightsDesc.write = lightBuffer;
+  graph.addPass(std::move(lightsDesc),
+                [this, viewProjection](const RenderGraph::PassContext &ctx) {
+                  render(viewProjection, ctx.getOutputSize());
+                });
+
+  RenderGraph::PassDesc compositeDesc;
+  compositeDesc.name = "Light Composite";
+  compositeDesc.reads = {lightBuffer};
+  compositeDesc.write = output;
+  graph.addPass(std::move(compositeDesc),
+                [this, lightBuffer](const RenderGraph::PassContext &ctx) {
+                  composite(ctx.getTexture(lightBuffer));
+                });
+}
+
+void LightRenderer::render(const glm::mat4 &viewProjection,
+                           const glm::ivec2 &bufferPixels) {
+  auto &state = GLStateCache::get();
+
+  const glm::vec2 bufferSize(bufferPixels.x, bufferPixels.y);
+  const glm::vec2 halfSize = bufferSize * 0.5f;
+  // Light buffer pixels per world unit, the larger axis keeps culling
+  // conservative under rotation
+  const float pixelsPerUnit = std::max(
+      glm::length(glm::vec2(viewProjection[0][0], viewProjection[0][1]) *
+                  halfSize),
+      glm::length(glm::vec2(viewProjection[1][0], viewProjection[1][1]) *
+                  halfSize));
+
+  // Transform the lights to light buffer pixels and drop the offscreen ones
+  m_screenX.clear();
+  m_screenY.clear();
+  m_screenRadiusSq.clear();
+  m_lightData.clear();
+  for (const auto &light : m_lights) {
+    const glm::vec4 clip = viewProjection * glm::vec4(light.position, 0.0f,
+                                                      1.0f);
+    const glm::vec2 screen =
+        (glm::vec2(clip.x, clip.y) / clip.w + 1.0f) * halfSize;
+    const float radius = light.radius * pixelsPerUnit;
+    if (light.radius <= 0.0f || screen.x + radius < 0.0f ||
+        screen.y + radius < 0.0f || screen.x - radius > bufferSize.x ||
+        screen.y - radius > bufferSize.y) {
+      continue;
+    }
+
+    m_screenX.push_back(screen.x);
+    m_screenY.push_back(screen.y);
+    m_screenRadiusSq.push_back(radius * radius);
+
+    // Full circles get cone bounds every direction passes
+    const bool isSpot = light.outerAngle < 3.14159f;
+    const float cosOuter = isSpot ? std::cos(light.outerAngle) : -2.0f;
+    const float cosInner = std::max(std::cos(light.innerAngle),
+                                    cosOuter + 1.0e-4f);
+    const float directionLength = glm::length(light.direction);
+    const glm::vec2 direction = directionLength > 0.0f
+                                    ? light.direction / directionLength
+                                    : glm::vec2(1.0f, 0.0f);
+    m_lightData.push_back({light.position, light.radius, light.intensity});
+    m_lightData.push_back({light.color, cosOuter});
+    m_lightData.push_back({direction, cosInner, 0.0f});
+  }
+
+  const auto visibleLights = static_cast<uint32_t>(m_screenX.size());
+  const size_t paddedCount =
+      (visibleLights + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+  m_screenX.resize(paddedCount, FAR_AWAY);
+  m_screenY.resize(paddedCount, FAR_AWAY);
+  m_screenRadiusSq.resize(paddedCount, 0.0f);
+
+  binLights(bufferPixels);
+
+  {
+    RenderProfiler::CpuTimer timer(RenderProfiler::CpuCounter::Upload);
+    upload(LightData, m_lightData.data(),
+           m_lightData.size() * sizeof(glm::vec4));
+    upload(TileHeaders, m_tileHeaders.data(),
+           m_tileHeaders.size() * sizeof(glm::uvec2));
+    upload(LightIndices, m_lightIndices.data(),
+           m_lightIndices.size() * sizeof(uint16_t));
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+  }
+
+  state.setBlendMode(BlendMode::None);
+
+  m_lightShader.use();
+  m_lightShader.setUniform("u_InverseViewProjection",
+                           glm::inverse(viewProjection));
+  m_lightShader.setUniform("u_TilesX", m_tilesX);
+  m_lightShader.setUniform("u_Ambient", m_ambient);
+  for (uint32_t i = 0; i < BufferCount; i++) {
+    state.bindTextureBuffer(i, m_textures[i]);
+  }
+  state.bindVertexArray(m_VAO);
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+
+  m_stats.lightCount += static_cast<uint32_t>(m_lights.size());
+  m_stats.visibleLights += visibleLights;
+  m_stats.tileCount += static_cast<uint32_t>(m_tileHeaders.size());
+  m_stats.lightTilePairs += static_cast<uint32_t>(m_lightIndices.size());
+}
+
+void LightRenderer::composite(uint32_t lightBuffer) {
+  auto &state = GLStateCache::get();
+
+  state.setBlendMode(BlendMode::Multiply);
+  m_compositeShader.use();
+  state.bindTexture(0, lightBuffer);
+  state.bindVertexArray(m_VAO);
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+} // namespace ste
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "render_graph.h"
+#include "shader.h"
+
+namespace ste {
+
+struct Light {
+  glm::vec2 position{0.0f};
+  float radius = 128.0f; // world units, the falloff reaches zero here
+  float intensity = 1.0f;
+  glm::vec3 color{1.0f};
+  // Spot lights point along `direction` with cone half angles in radians,
+  // the defaults light the full circle
+  glm::vec2 direction{1.0f, 0.0f};
+  float innerAngle = 3.14159265f;
+  float outerAngle = 3.14159265f;
+};
+
+// Accumulates many point and spot lights into a light buffer in a single
+// fullscreen pass. The buffer is split into TILE_SIZE tiles, the CPU bins
+// the lights into per-tile lists (4 lights at a time with SSE2) and each
+// fragment only evaluates the lights of its tile. The light buffer is a
+// transient RenderGraph target, a second pass multiplies it over the output,
+// e.g. the Renderer2D scene.
+class LightRenderer {
+public:
+  static constexpr int TILE_SIZE = 16; // light buffer pixels
+  static constexpr uint32_t MAX_LIGHTS = 4096;
+
+  struct CreateInfo {
+    std::string errorMsg;
+    bool success = true;
+    // Light buffer resolution relative to the backbuffer, lighting is low
+    // frequency so half resolution is rarely noticeable
+    float resolutionScale = 0.5f;
+  };
+
+  struct Statistics {
+    uint32_t lightCount = 0;
+    uint32_t visibleLights = 0;
+    uint32_t tileCount = 0;
+    uint32_t lightTilePairs = 0; // total length of the tile lists
+  };
+
+  static std::shared_ptr<LightRenderer> create(CreateInfo &createInfo);
+
+  LightRenderer(Shader &&lightShader, Shader &&compositeShader, uint32_t vao,
+                const uint32_t (&buffers)[3], const uint32_t (&textures)[3],
+                float resolutionScale);
+  ~LightRenderer();
+  LightRenderer(const LightRenderer &) = delete;
+  LightRenderer &operator=(const LightRenderer &) = delete;
+
+  void setAmbient(const glm::vec3 &ambient) { m_ambient = ambient; }
+  const glm::vec3 &getAmbient() const { return m_ambient; }
+
+  // Lights are collected per frame, clear() drops them after rendering
+  void addLight(const Light &light);
+  void clear() { m_lights.clear(); }
+  size_t getLightCount() const { return m_lights.size(); }
+
+  // Adds a pass rendering the lights into a new light buffer and a pass
+  // multiplying it over `output`. Lights added before the graph executes
+  // are drawn.
+  void addPasses(RenderGraph &graph, RenderGraph::Resource output,
+                 const glm::mat4 &viewProjection);
+
+  void resetStats() { m_stats = Statistics(); }
+  Statistics getStats() const { return m_stats; }
+
+private:
+  enum Buffer { LightData, TileHeaders, LightIndices, BufferCount };
+
+  // Bins the lights into tiles and renders them into the bound light buffer
+  void render(const glm::mat4 &viewProjection, const glm::ivec2 &bufferSize);
+  // Multiplies the light buffer over the bound framebuffer
+  void composite(uint32_t lightBuffer);
+  // Builds m_tileHeaders and m_lightIndices from the culled lights
+  void binLights(const glm::ivec2 &bufferSize);
+  void upload(Buffer buffer, const void *data, size_t size);
+
+  Shader m_lightShader;
+  Shader m_compositeShader;
+  uint32_t m_VAO{0};
+  uint32_t m_buffers[BufferCount]{};
+  uint32_t m_textures[BufferCount]{};
+  size_t m_bufferSizes[BufferCount]{};
+  float m_resolutionScale;
+  glm::vec3 m_ambient{0.1f};
+
+  std::vector<Light> m_lights;
+
+  // Visible lights in light buffer pixels, structure of arrays padded to
+  // the SIMD width
+  std::vector<float> m_screenX;
+  std::vector<float> m_screenY;
+  std::vector<float> m_screenRadiusSq;
+  std::vector<glm::vec4> m_lightData;
+
+  // Lights reaching the current tile row, with their squared vertical gap
+  std::vector<uint16_t> m_rowLights;
+  std::vector<float> m_rowX;
+  std::vector<float> m_rowGapSq;
+  std::vector<float> m_rowRadiusSq;
+
+  // Per tile offset and count into m_lightIndices
+  std::vector<glm::uvec2> m_tileHeaders;
+  std::vector<uint16_t> m_lightIndices;
+  int m_tilesX{0};
+  int m_tilesY{0};
+
+  Statistics m_stats{};
+};
+
+} // namespace ste
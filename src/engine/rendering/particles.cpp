@@ -0,0 +1,367 @@
+#include "particles.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <glad/glad.h>
+
+#include "gl_render_backend.h"
+#include "gl_state.h"
+#include "render_profiler.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)
+#define STE_PARTICLES_SSE2 1
+#include <immintrin.h>
+#endif
+
+namespace ste {
+
+namespace {
+constexpr uint32_t SIMD_WIDTH = 4;
+
+const char *particleVertexShaderSource = R"(
+        #version 330 core
+        layout (location = 0) in vec2 a_Position;
+        layout (location = 1) in float a_Size;
+        layout (location = 2) in float a_Rotation;
+        layout (location = 3) in vec4 a_Color;
+
+        layout (std140) uniform SceneData {
+            mat4 u_ViewProjection;
+        };
+
+        out vec4 v_Color;
+        out vec2 v_TexCoord;
+
+        const vec2 corners[4] = vec2[](vec2(-0.5, -0.5), vec2(0.5, -0.5),
+                                       vec2(-0.5, 0.5), vec2(0.5, 0.5));
+
+        void main() {
+            vec2 corner = corners[gl_VertexID];
+            float s = sin(a_Rotation);
+            float c = cos(a_Rotation);
+            vec2 rotated = vec2(corner.x * c - corner.y * s,
+                                corner.x * s + corner.y * c);
+
+            v_Color = a_Color;
+            v_TexCoord = corner + 0.5;
+            gl_Position = u_ViewProjection *
+                          vec4(a_Position + rotated * a_Size, 0.0, 1.0);
+        }
+    )";
+
+const char *particleFragmentShaderSource = R"(
+        #version 330 core
+        out vec4 FragColor;
+
+        in vec4 v_Color;
+        in vec2 v_TexCoord;
+
+        uniform sampler2D u_Texture;
+        uniform int u_Textured;
+
+        void main() {
+            FragColor = v_Color;
+            if (u_Textured != 0) {
+                FragColor *= texture(u_Texture, v_TexCoord);
+            }
+        }
+    )";
+
+uint32_t paddedCapacity(uint32_t capacity) {
+  return (capacity + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+}
+
+template <typename Key, typename Value>
+Value sampleCurve(const std::vector<Key> &keys, float time,
+                  Value Key::*value, Value fallback) {
+  if (keys.empty()) {
+    return fallback;
+  }
+  if (time <= keys.front().time) {
+    return keys.front().*value;
+  }
+
+  for (size_t i = 1; i < keys.size(); i++) {
+    if (time <= keys[i].time) {
+      const float span = keys[i].time - keys[i - 1].time;
+      const float t = span > 0.0f ? (time - keys[i - 1].time) / span : 1.0f;
+      return keys[i - 1].*value + (keys[i].*value - keys[i - 1].*value) * t;
+    }
+  }
+  return keys.back().*value;
+}
+} // namespace
+
+ParticleEmitter::ParticleEmitter(const EmitterDesc &desc) : m_desc(desc) {
+  const uint32_t capacity = paddedCapacity(m_desc.capacity);
+  for (auto *stream : {&m_positionX, &m_positionY, &m_velocityX, &m_velocityY,
+                       &m_rotation, &m_spin, &m_age, &m_inverseLifetime}) {
+    stream->assign(capacity, 0.0f);
+  }
+  m_instances.resize(m_desc.capacity);
+
+  bakeCurves();
+}
+
+void ParticleEmitter::bakeCurves() {
+  for (uint32_t i = 0; i < CURVE_RESOLUTION; i++) {
+    const float time = static_cast<float>(i) / (CURVE_RESOLUTION - 1);
+    m_colorTable[i] =
+        sampleCurve(m_desc.colorCurve, time, &ParticleColorKey::color,
+                    glm::vec4(1.0f));
+    m_sizeTable[i] =
+        sampleCurve(m_desc.sizeCurve, time, &ParticleSizeKey::size, 1.0f);
+  }
+}
+
+void ParticleEmitter::clear() {
+  m_count = 0;
+  m_pendingBurst = 0;
+  m_emissionAccumulator = 0.0f;
+}
+
+void ParticleEmitter::update(float deltaSeconds) {
+  integrate(deltaSeconds);
+  removeDead();
+
+  uint32_t spawnCount = m_pendingBurst;
+  m_pendingBurst = 0;
+  if (m_emitting && m_desc.emissionRate > 0.0f) {
+    m_emissionAccumulator += m_desc.emissionRate * deltaSeconds;
+    const auto emitted = static_cast<uint32_t>(m_emissionAccumulator);
+    m_emissionAccumulator -= static_cast<float>(emitted);
+    spawnCount += emitted;
+  }
+  spawn(spawnCount);
+
+  writeInstances();
+}
+
+void ParticleEmitter::integrate(float deltaSeconds) {
+  const float damping = std::max(0.0f, 1.0f - m_desc.drag * deltaSeconds);
+  const float gravityX = m_desc.gravity.x * deltaSeconds;
+  const float gravityY = m_desc.gravity.y * deltaSeconds;
+
+  // The streams are padded, so the last group can run past m_count
+  const uint32_t count = paddedCapacity(m_count);
+  float *positionX = m_positionX.data();
+  float *positionY = m_positionY.data();
+  float *velocityX = m_velocityX.data();
+  float *velocityY = m_velocityY.data();
+  float *rotation = m_rotation.data();
+  const float *spin = m_spin.data();
+  float *age = m_age.data();
+
+#if defined(STE_PARTICLES_SSE2)
+  const __m128 dt = _mm_set1_ps(deltaSeconds);
+  const __m128 damp = _mm_set1_ps(damping);
+  const __m128 gx = _mm_set1_ps(gravityX);
+  const __m128 gy = _mm_set1_ps(gravityY);
+
+  for (uint32_t i = 0; i < count; i += SIMD_WIDTH) {
+    __m128 vx = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(velocityX + i), gx), damp);
+    __m128 vy = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(velocityY + i), gy), damp);
+    _mm_storeu_ps(velocityX + i, vx);
+    _mm_storeu_ps(velocityY + i, vy);
+
+    _mm_storeu_ps(positionX + i,
+                  _mm_add_ps(_mm_loadu_ps(positionX + i), _mm_mul_ps(vx, dt)));
+    _mm_storeu_ps(positionY + i,
+                  _mm_add_ps(_mm_loadu_ps(positionY + i), _mm_mul_ps(vy, dt)));
+    _mm_storeu_ps(rotation + i,
+                  _mm_add_ps(_mm_loadu_ps(rotation + i),
+                             _mm_mul_ps(_mm_loadu_ps(spin + i), dt)));
+    _mm_storeu_ps(age + i, _mm_add_ps(_mm_loadu_ps(age + i), dt));
+  }
+#else
+  for (uint32_t i = 0; i < count; i++) {
+    velocityX[i] = (velocityX[i] + gravityX) * damping;
+    velocityY[i] = (velocityY[i] + gravityY) * damping;
+    positionX[i] += velocityX[i] * deltaSeconds;
+    positionY[i] += velocityY[i] * deltaSeconds;
+    rotation[i] += spin[i] * deltaSeconds;
+    age[i] += deltaSeconds;
+  }
+#endif
+}
+
+void ParticleEmitter::removeDead() {
+  // Swap the last live particle into every dead slot, order doesn't matter
+  uint32_t i = 0;
+  while (i < m_count) {
+    if (m_age[i] * m_inverseLifetime[i] < 1.0f) {
+      i++;
+      continue;
+    }
+
+    const uint32_t last = --m_count;
+    for (auto *stream :
+         {&m_positionX, &m_positionY, &m_velocityX, &m_velocityY, &m_rotation,
+          &m_spin, &m_age, &m_inverseLifetime}) {
+      (*stream)[i] = (*stream)[last];
+    }
+  }
+}
+
+void ParticleEmitter::spawn(uint32_t count) {
+  count = std::min(count, m_desc.capacity - m_count);
+  for (uint32_t n = 0; n < count; n++) {
+    const uint32_t i = m_count++;
+    m_positionX[i] =
+        m_position.x + random(-m_desc.spawnExtents.x, m_desc.spawnExtents.x);
+    m_positionY[i] =
+        m_position.y + random(-m_desc.spawnExtents.y, m_desc.spawnExtents.y);
+    m_velocityX[i] = random(m_desc.velocityMin.x, m_desc.velocityMax.x);
+    m_velocityY[i] = random(m_desc.velocityMin.y, m_desc.velocityMax.y);
+    m_rotation[i] = 0.0f;
+    m_spin[i] = random(m_desc.spinMin, m_desc.spinMax);
+    m_age[i] = 0.0f;
+    m_inverseLifetime[i] =
+        1.0f / std::max(random(m_desc.lifetimeMin, m_desc.lifetimeMax), 1e-4f);
+  }
+}
+
+void ParticleEmitter::writeInstances() {
+  const float *age = m_age.data();
+  const float *inverseLifetime = m_inverseLifetime.data();
+  alignas(16) int32_t curveIndex[SIMD_WIDTH];
+
+  for (uint32_t i = 0; i < m_count; i += SIMD_WIDTH) {
+    // Curve table index from the normalized age
+#if defined(STE_PARTICLES_SSE2)
+    __m128 t = _mm_mul_ps(_mm_loadu_ps(age + i),
+                          _mm_loadu_ps(inverseLifetime + i));
+    t = _mm_min_ps(_mm_max_ps(t, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+    _mm_store_si128(
+        reinterpret_cast<__m128i *>(curveIndex),
+        _mm_cvttps_epi32(_mm_mul_ps(
+            t, _mm_set1_ps(static_cast<float>(CURVE_RESOLUTION - 1)))));
+#else
+    for (uint32_t lane = 0; lane < SIMD_WIDTH; lane++) {
+      const float t =
+          std::clamp(age[i + lane] * inverseLifetime[i + lane], 0.0f, 1.0f);
+      curveIndex[lane] = static_cast<int32_t>(t * (CURVE_RESOLUTION - 1));
+    }
+#endif
+
+    const uint32_t lanes = std::min(SIMD_WIDTH, m_count - i);
+    for (uint32_t lane = 0; lane < lanes; lane++) {
+      Instance &instance = m_instances[i + lane];
+      instance.position = {m_positionX[i + lane], m_positionY[i + lane]};
+      instance.size = m_sizeTable[curveIndex[lane]];
+      instance.rotation = m_rotation[i + lane];
+      instance.color = m_colorTable[curveIndex[lane]];
+    }
+  }
+}
+
+float ParticleEmitter::random(float min, float max) {
+  // xorshift32, plenty for visual noise and much cheaper than <random>
+  m_randomState ^= m_randomState << 13;
+  m_randomState ^= m_randomState >> 17;
+  m_randomState ^= m_randomState << 5;
+  const float unit =
+      static_cast<float>(m_randomState >> 8) * (1.0f / 16777216.0f);
+  return min + (max - min) * unit;
+}
+
+std::shared_ptr<ParticleRenderer>
+ParticleRenderer::create(CreateInfo &createInfo) {
+  Shader::CreateInfo shaderInfo;
+  auto shader = Shader::createFromMemory(particleVertexShaderSource,
+                                         particleFragmentShaderSource,
+                                         shaderInfo);
+  if (!shader) {
+    createInfo.success = false;
+    createInfo.errorMsg = std::move(shaderInfo.errorMsg);
+    return nullptr;
+  }
+
+  shader->bindUniformBlock("SceneData", GLRenderBackend::SCENE_DATA_BINDING);
+  shader->use();
+  shader->setUniform("u_Texture", 0);
+
+  auto &state = GLStateCache::get();
+
+  uint32_t vao;
+  glGenVertexArrays(1, &vao);
+  state.bindVertexArray(vao);
+
+  uint32_t vbo;
+  glGenBuffers(1, &vbo);
+  state.bindArrayBuffer(vbo);
+
+  // Every attribute advances once per particle
+  using Instance = ParticleEmitter::Instance;
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Instance),
+                        (const void *)offsetof(Instance, position));
+  glVertexAttribDivisor(0, 1);
+
+  glEnableVertexAttribArray(1);
+  glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, sizeof(Instance),
+                        (const void *)offsetof(Instance, size));
+  glVertexAttribDivisor(1, 1);
+
+  glEnableVertexAttribArray(2);
+  glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(Instance),
+                        (const void *)offsetof(Instance, rotation));
+  glVertexAttribDivisor(2, 1);
+
+  glEnableVertexAttribArray(3);
+  glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(Instance),
+                        (const void *)offsetof(Instance, color));
+  glVertexAttribDivisor(3, 1);
+
+  return std::make_shared<ParticleRenderer>(std::move(*shader), vao, vbo);
+}
+
+ParticleRenderer::ParticleRenderer(Shader &&shader, uint32_t vao, uint32_t vbo)
+    : m_shader(std::move(shader)), m_VAO(vao), m_VBO(vbo) {}
+
+ParticleRenderer::~ParticleRenderer() {
+  auto &state = GLStateCache::get();
+  state.onVertexArrayDeleted(m_VAO);
+  state.onBufferDeleted(m_VBO);
+
+  glDeleteVertexArrays(1, &m_VAO);
+  glDeleteBuffers(1, &m_VBO);
+}
+
+void ParticleRenderer::draw(const ParticleEmitter &emitter) {
+  const auto instances = emitter.getInstances();
+  if (instances.empty()) {
+    return;
+  }
+
+  RenderProfiler::Scope scope("Particles");
+  auto &state = GLStateCache::get();
+
+  // Orphan the buffer so the driver never waits on the previous draw
+  state.bindArrayBuffer(m_VBO);
+  m_bufferSize = std::max(m_bufferSize, instances.size_bytes());
+  {
+    RenderProfiler::CpuTimer timer(RenderProfiler::CpuCounter::Upload);
+    glBufferData(GL_ARRAY_BUFFER, m_bufferSize, nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size_bytes(),
+                    instances.data());
+  }
+
+  const uint32_t textureId = emitter.getDesc().textureId;
+  if (textureId != 0) {
+    state.bindTexture(0, textureId);
+  }
+  state.setBlendMode(emitter.getDesc().blendMode);
+
+  m_shader.use();
+  m_shader.setUniform("u_Textured", textureId != 0 ? 1 : 0);
+  state.bindVertexArray(m_VAO);
+  glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4,
+                        static_cast<GLsizei>(instances.size()));
+
+  m_stats.drawCalls++;
+  m_stats.particleCount += static_cast<uint32_t>(instances.size());
+}
+
+} // namespace ste
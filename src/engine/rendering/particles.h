@@ -0,0 +1,155 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "render_backend.h"
+#include "shader.h"
+
+namespace ste {
+
+struct ParticleColorKey {
+  float time; // normalized particle age, 0 to 1
+  glm::vec4 color;
+};
+
+struct ParticleSizeKey {
+  float time; // normalized particle age, 0 to 1
+  float size;
+};
+
+struct EmitterDesc {
+  uint32_t capacity = 1024;
+  float emissionRate = 100.0f;     // particles per second, 0 for bursts only
+  glm::vec2 spawnExtents{0.0f};    // half size of the spawn box
+  float lifetimeMin = 1.0f;        // seconds
+  float lifetimeMax = 1.0f;
+  glm::vec2 velocityMin{-50.0f};   // units per second
+  glm::vec2 velocityMax{50.0f};
+  glm::vec2 gravity{0.0f};
+  float drag = 0.0f;               // fraction of velocity lost per second
+  float spinMin = 0.0f;            // radians per second
+  float spinMax = 0.0f;
+  // Piecewise linear over the particle lifetime, keys sorted by time
+  std::vector<ParticleColorKey> colorCurve{{0.0f, {1.0f, 1.0f, 1.0f, 1.0f}},
+                                           {1.0f, {1.0f, 1.0f, 1.0f, 0.0f}}};
+  std::vector<ParticleSizeKey> sizeCurve{{0.0f, 8.0f}, {1.0f, 8.0f}};
+  uint32_t textureId = 0; // 0 draws untextured squares
+  BlendMode blendMode = BlendMode::Additive;
+};
+
+// Fixed capacity particle pool in structure of arrays layout. Integration
+// runs 4 particles at a time with SSE2, dead particles are swap-removed so
+// the live ones stay packed at the front. Simulation needs no GL context.
+class ParticleEmitter {
+public:
+  // Per-instance data uploaded for the instanced draw
+  struct Instance {
+    glm::vec2 position;
+    float size;
+    float rotation;
+    glm::vec4 color;
+  };
+
+  explicit ParticleEmitter(const EmitterDesc &desc);
+
+  void setPosition(const glm::vec2 &position) { m_position = position; }
+  const glm::vec2 &getPosition() const { return m_position; }
+
+  // Continuous emission at the desc's rate
+  void setEmitting(bool emitting) { m_emitting = emitting; }
+  bool isEmitting() const { return m_emitting; }
+
+  // Spawns up to `count` particles with the next update
+  void burst(uint32_t count) { m_pendingBurst += count; }
+  void clear();
+
+  // Integrates, removes dead particles, spawns new ones and refreshes the
+  // instance data
+  void update(float deltaSeconds);
+
+  uint32_t getCount() const { return m_count; }
+  uint32_t getCapacity() const { return m_desc.capacity; }
+  const EmitterDesc &getDesc() const { return m_desc; }
+  std::span<const Instance> getInstances() const {
+    return {m_instances.data(), m_count};
+  }
+
+private:
+  // Curves are baked into lookup tables indexed by normalized age
+  static constexpr uint32_t CURVE_RESOLUTION = 64;
+
+  void bakeCurves();
+  void integrate(float deltaSeconds);
+  void removeDead();
+  void spawn(uint32_t count);
+  void writeInstances();
+  float random(float min, float max);
+
+  EmitterDesc m_desc;
+  std::array<glm::vec4, CURVE_RESOLUTION> m_colorTable;
+  std::array<float, CURVE_RESOLUTION> m_sizeTable;
+
+  // One array per attribute, padded to a multiple of the SIMD width
+  std::vector<float> m_positionX;
+  std::vector<float> m_positionY;
+  std::vector<float> m_velocityX;
+  std::vector<float> m_velocityY;
+  std::vector<float> m_rotation;
+  std::vector<float> m_spin;
+  std::vector<float> m_age;
+  std::vector<float> m_inverseLifetime;
+  uint32_t m_count = 0;
+
+  std::vector<Instance> m_instances;
+
+  glm::vec2 m_position{0.0f};
+  bool m_emitting = true;
+  float m_emissionAccumulator = 0.0f;
+  uint32_t m_pendingBurst = 0;
+  uint32_t m_randomState = 0x9E3779B9;
+};
+
+// Draws emitters with one instanced draw each, the quad corners come from
+// gl_VertexID so only the instance data is uploaded.
+class ParticleRenderer {
+public:
+  struct CreateInfo {
+    std::string errorMsg;
+    bool success = true;
+  };
+
+  struct Statistics {
+    uint32_t drawCalls = 0;
+    uint32_t particleCount = 0;
+  };
+
+  static std::shared_ptr<ParticleRenderer> create(CreateInfo &createInfo);
+
+  ParticleRenderer(Shader &&shader, uint32_t vao, uint32_t vbo);
+  ~ParticleRenderer();
+  ParticleRenderer(const ParticleRenderer &) = delete;
+  ParticleRenderer &operator=(const ParticleRenderer &) = delete;
+
+  // Uses the camera of the current Renderer2D scene (the shared SceneData
+  // block). Call after Renderer2D::endScene so batched quads land first.
+  void draw(const ParticleEmitter &emitter);
+
+  void resetStats() { m_stats = Statistics(); }
+  Statistics getStats() const { return m_stats; }
+
+private:
+  Shader m_shader;
+  uint32_t m_VAO{0};
+  uint32_t m_VBO{0};
+  size_t m_bufferSize{0};
+  Statistics m_stats{};
+};
+
+} // namespace ste
@@ -0,0 +1,161 @@
+#include "program_cache.h"
+
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+namespace ste {
+
+namespace {
+// Entry header, followed by `length` bytes of binary
+struct EntryHeader {
+  uint32_t magic;
+  uint32_t format;
+  uint32_t length;
+};
+constexpr uint32_t ENTRY_MAGIC = 0x31425053; // "SPB1"
+
+constexpr uint64_t FNV_OFFSET = 0xcbf29ce484222325ull;
+constexpr uint64_t FNV_PRIME = 0x100000001b3ull;
+
+uint64_t fnv1a(std::string_view data, uint64_t hash = FNV_OFFSET) {
+  for (unsigned char c : data) {
+    hash = (hash ^ c) * FNV_PRIME;
+  }
+  // Terminate so "ab" + "c" and "a" + "bc" hash differently
+  return (hash ^ 0xff) * FNV_PRIME;
+}
+
+std::string_view glString(GLenum name) {
+  const auto *value = reinterpret_cast<const char *>(glGetString(name));
+  return value ? value : "";
+}
+} // namespace
+
+bool ProgramCache::setDirectory(const std::filesystem::path &directory) {
+  m_directory = directory;
+  m_enabled = false;
+  if (directory.empty()) {
+    return true;
+  }
+
+  // Core since 4.1, a driver without any binary format can't cache either
+  GLint formatCount = 0;
+  if (GLAD_GL_ARB_get_program_binary ||
+      GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 1)) {
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+  }
+  if (formatCount <= 0) {
+    return false;
+  }
+
+  std::error_code error;
+  std::filesystem::create_directories(directory, error);
+  if (error) {
+    return false;
+  }
+
+  m_driverHash = fnv1a(glString(GL_VERSION),
+                       fnv1a(glString(GL_RENDERER), fnv1a(glString(GL_VENDOR))));
+  m_enabled = true;
+  return true;
+}
+
+uint64_t ProgramCache::makeKey(std::string_view vertexSource,
+                               std::string_view fragmentSource) const {
+  if (!m_enabled) {
+    return 0;
+  }
+  return fnv1a(fragmentSource, fnv1a(vertexSource, m_driverHash));
+}
+
+std::filesystem::path ProgramCache::getEntryPath(uint64_t key) const {
+  char name[32];
+  std::snprintf(name, sizeof(name), "%016llx.bin",
+                static_cast<unsigned long long>(key));
+  return m_directory / name;
+}
+
+GLuint ProgramCache::load(uint64_t key) {
+  if (!m_enabled || key == 0) {
+    return 0;
+  }
+
+  const auto path = getEntryPath(key);
+  std::ifstream file(path, std::ios::binary);
+  EntryHeader header{};
+  if (!file || !file.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+      header.magic != ENTRY_MAGIC) {
+    m_stats.misses++;
+    return 0;
+  }
+
+  std::vector<char> binary(header.length);
+  if (!file.read(binary.data(), binary.size())) {
+    m_stats.misses++;
+    return 0;
+  }
+
+  GLuint program = glCreateProgram();
+  glProgramBinary(program, header.format, binary.data(),
+                  static_cast<GLsizei>(binary.size()));
+
+  // Drivers may refuse binaries of another build, recompile and replace it
+  GLint linked = GL_FALSE;
+  glGetProgramiv(program, GL_LINK_STATUS, &linked);
+  if (!linked) {
+    glDeleteProgram(program);
+    std::error_code error;
+    std::filesystem::remove(path, error);
+    m_stats.rejected++;
+    m_stats.misses++;
+    return 0;
+  }
+
+  m_stats.hits++;
+  return program;
+}
+
+void ProgramCache::store(uint64_t key, GLuint program) {
+  if (!m_enabled || key == 0) {
+    return;
+  }
+
+  GLint length = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0) {
+    return;
+  }
+
+  std::vector<char> binary(length);
+  GLsizei written = 0;
+  GLenum format = 0;
+  glGetProgramBinary(program, length, &written, &format, binary.data());
+  if (written <= 0) {
+    return;
+  }
+  const EntryHeader header{ENTRY_MAGIC, format,
+                           static_cast<uint32_t>(written)};
+
+  // Write aside and rename, a crash never leaves a truncated entry behind
+  const auto path = getEntryPath(key);
+  auto temporaryPath = path;
+  temporaryPath += ".tmp";
+  std::error_code error;
+  {
+    std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+    if (!file.write(reinterpret_cast<const char *>(&header), sizeof(header)) ||
+        !file.write(binary.data(), written)) {
+      file.close();
+      std::filesystem::remove(temporaryPath, error);
+      return;
+    }
+  }
+
+  std::filesystem::rename(temporaryPath, path, error);
+  if (!error) {
+    m_stats.stores++;
+  }
+}
+
+} // namespace ste
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string_view>
+
+#include <glad/glad.h>
+
+namespace ste {
+
+// On-disk cache of linked programs (glGetProgramBinary). Entries are keyed
+// by a hash of the shader sources and the GL vendor, renderer and version
+// strings, so a driver update just misses and recompiles. Disabled until a
+// directory is set, Shader consults it for every program it links.
+class ProgramCache {
+public:
+  struct Statistics {
+    uint32_t hits = 0;
+    uint32_t misses = 0;
+    uint32_t stores = 0;
+    uint32_t rejected = 0; // binaries the driver refused to load
+  };
+
+  static ProgramCache &get() {
+    static ProgramCache instance;
+    return instance;
+  }
+
+  ProgramCache(const ProgramCache &) = delete;
+  ProgramCache &operator=(const ProgramCache &) = delete;
+
+  // An empty path disables the cache. Needs a current GL context.
+  bool setDirectory(const std::filesystem::path &directory);
+  const std::filesystem::path &getDirectory() const { return m_directory; }
+  bool isEnabled() const { return m_enabled; }
+
+  // 0 when the cache is disabled
+  uint64_t makeKey(std::string_view vertexSource,
+                   std::string_view fragmentSource) const;
+
+  // A linked program from the cached binary, 0 on a miss
+  GLuint load(uint64_t key);
+  // Programs need GL_PROGRAM_BINARY_RETRIEVABLE_HINT set before linking
+  void store(uint64_t key, GLuint program);
+
+  void resetStats() { m_stats = Statistics(); }
+  Statistics getStats() const { return m_stats; }
+
+private:
+  ProgramCache() = default;
+
+  std::filesystem::path getEntryPath(uint64_t key) const;
+
+  std::filesystem::path m_directory;
+  bool m_enabled = false;
+  // Hash of the driver strings, folded into every key
+  uint64_t m_driverHash = 0;
+  Statistics m_stats{};
+};
+
+} // namespace ste
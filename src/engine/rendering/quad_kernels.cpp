@@ -0,0 +1,503 @@
+#include "quad_kernels.h"
+
+#include <bit>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)
+#define STE_QUAD_KERNELS_SSE2 1
+#include <immintrin.h>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define STE_QUAD_KERNELS_AVX2 1
+#define STE_TARGET_AVX2 __attribute__((target("avx2")))
+#elif defined(__AVX2__)
+#define STE_QUAD_KERNELS_AVX2 1
+#define STE_TARGET_AVX2
+#endif
+#endif
+
+namespace ste::quad_kernels {
+
+namespace {
+
+using QuadDesc = Renderer2D::QuadDesc;
+using Vertex = Renderer2D::Vertex;
+
+enum class Kernel { Scalar, SSE2, AVX2 };
+
+// Cody-Waite split of pi/2 and the cephes sinf/cosf minimax coefficients
+constexpr float TWO_OVER_PI = 0.636619772367581343f;
+constexpr float PIO2_1 = 1.5703125f;
+constexpr float PIO2_2 = 4.837512969970703125e-4f;
+constexpr float PIO2_3 = 7.54978995489188216e-8f;
+constexpr float SIN_C1 = -1.6666654611e-1f;
+constexpr float SIN_C2 = 8.3321608736e-3f;
+constexpr float SIN_C3 = -1.9515295891e-4f;
+constexpr float COS_C1 = 4.166664568298827e-2f;
+constexpr float COS_C2 = -1.388731625493765e-3f;
+constexpr float COS_C3 = 2.443315711809948e-5f;
+
+Kernel selectKernel() {
+#if defined(STE_QUAD_KERNELS_AVX2)
+#if defined(__GNUC__) || defined(__clang__)
+  if (__builtin_cpu_supports("avx2")) {
+    return Kernel::AVX2;
+  }
+#else
+  return Kernel::AVX2;
+#endif
+#endif
+#if defined(STE_QUAD_KERNELS_SSE2)
+  return Kernel::SSE2;
+#else
+  return Kernel::Scalar;
+#endif
+}
+
+Kernel activeKernel() {
+  static const Kernel kernel = selectKernel();
+  return kernel;
+}
+
+#if defined(STE_QUAD_KERNELS_SSE2)
+
+// Fast sincos for 4 lanes, exact at zero so unrotated quads match the
+// scalar path bit for bit
+inline void sincos4(__m128 x, __m128 &sinOut, __m128 &cosOut) {
+  const __m128i quadrant =
+      _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(TWO_OVER_PI)));
+  const __m128 j = _mm_cvtepi32_ps(quadrant);
+
+  __m128 r = _mm_sub_ps(x, _mm_mul_ps(j, _mm_set1_ps(PIO2_1)));
+  r = _mm_sub_ps(r, _mm_mul_ps(j, _mm_set1_ps(PIO2_2)));
+  r = _mm_sub_ps(r, _mm_mul_ps(j, _mm_set1_ps(PIO2_3)));
+  const __m128 r2 = _mm_mul_ps(r, r);
+
+  __m128 sinPoly = _mm_add_ps(
+      _mm_set1_ps(SIN_C2), _mm_mul_ps(r2, _mm_set1_ps(SIN_C3)));
+  sinPoly = _mm_add_ps(_mm_set1_ps(SIN_C1), _mm_mul_ps(r2, sinPoly));
+  sinPoly = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(r, r2), sinPoly));
+
+  __m128 cosPoly = _mm_add_ps(
+      _mm_set1_ps(COS_C2), _mm_mul_ps(r2, _mm_set1_ps(COS_C3)));
+  cosPoly = _mm_add_ps(_mm_set1_ps(COS_C1), _mm_mul_ps(r2, cosPoly));
+  cosPoly = _mm_add_ps(
+      _mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(_mm_set1_ps(0.5f), r2)),
+      _mm_mul_ps(_mm_mul_ps(r2, r2), cosPoly));
+
+  // Odd quadrants swap sin and cos, the sign follows the quadrant
+  const __m128i one = _mm_set1_epi32(1);
+  const __m128i two = _mm_set1_epi32(2);
+  const __m128 swap = _mm_castsi128_ps(
+      _mm_cmpeq_epi32(_mm_and_si128(quadrant, one), one));
+  const __m128 sinSign =
+      _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(quadrant, two), 30));
+  const __m128 cosSign = _mm_castsi128_ps(_mm_slli_epi32(
+      _mm_and_si128(_mm_add_epi32(quadrant, one), two), 30));
+
+  const __m128 s = _mm_or_ps(_mm_and_ps(swap, cosPoly),
+                             _mm_andnot_ps(swap, sinPoly));
+  const __m128 c = _mm_or_ps(_mm_and_ps(swap, sinPoly),
+                             _mm_andnot_ps(swap, cosPoly));
+  sinOut = _mm_xor_ps(s, sinSign);
+  cosOut = _mm_xor_ps(c, cosSign);
+}
+
+void generateSSE2(const QuadDesc *quads, const float *texIndices,
+                  Vertex *out) {
+  const QuadDesc &q0 = quads[0];
+  const QuadDesc &q1 = quads[1];
+  const QuadDesc &q2 = quads[2];
+  const QuadDesc &q3 = quads[3];
+
+  // One quad per lane
+#define STE_LANES(field) _mm_setr_ps(q0.field, q1.field, q2.field, q3.field)
+
+  const __m128 px = STE_LANES(position.x);
+  const __m128 py = STE_LANES(position.y);
+  const __m128 sx = STE_LANES(size.x);
+  const __m128 sy = STE_LANES(size.y);
+
+  __m128 s, c;
+  sincos4(STE_LANES(rotation), s, c);
+
+  // Corner extents relative to the origin point
+  const __m128 negZero = _mm_set1_ps(-0.0f);
+  const __m128 x0 =
+      _mm_xor_ps(_mm_mul_ps(STE_LANES(origin.x), sx), negZero);
+  const __m128 y0 =
+      _mm_xor_ps(_mm_mul_ps(STE_LANES(origin.y), sy), negZero);
+  const __m128 x1 = _mm_add_ps(x0, sx);
+  const __m128 y1 = _mm_add_ps(y0, sy);
+
+  const __m128 x0c = _mm_mul_ps(x0, c), x0s = _mm_mul_ps(x0, s);
+  const __m128 x1c = _mm_mul_ps(x1, c), x1s = _mm_mul_ps(x1, s);
+  const __m128 y0c = _mm_mul_ps(y0, c), y0s = _mm_mul_ps(y0, s);
+  const __m128 y1c = _mm_mul_ps(y1, c), y1s = _mm_mul_ps(y1, s);
+
+  const __m128 cornerX[4] = {_mm_add_ps(px, _mm_sub_ps(x0c, y0s)),
+                             _mm_add_ps(px, _mm_sub_ps(x1c, y0s)),
+                             _mm_add_ps(px, _mm_sub_ps(x1c, y1s)),
+                             _mm_add_ps(px, _mm_sub_ps(x0c, y1s))};
+  const __m128 cornerY[4] = {_mm_add_ps(py, _mm_add_ps(x0s, y0c)),
+                             _mm_add_ps(py, _mm_add_ps(x1s, y0c)),
+                             _mm_add_ps(py, _mm_add_ps(x1s, y1c)),
+                             _mm_add_ps(py, _mm_add_ps(x0s, y1c))};
+
+  const __m128 pz = STE_LANES(position.z);
+  const __m128 red = STE_LANES(color.x);
+  const __m128 green = STE_LANES(color.y);
+  const __m128 blue = STE_LANES(color.z);
+  const __m128 alpha = STE_LANES(color.w);
+  const __m128 u[4] = {STE_LANES(texCoords.x), STE_LANES(texCoords.z),
+                       STE_LANES(texCoords.z), STE_LANES(texCoords.x)};
+  const __m128 v[4] = {STE_LANES(texCoords.y), STE_LANES(texCoords.y),
+                       STE_LANES(texCoords.w), STE_LANES(texCoords.w)};
+  const __m128 tex = _mm_loadu_ps(texIndices);
+  const __m128 tiling = _mm_set1_ps(1.0f);
+  const __m128 zero = _mm_setzero_ps();
+#undef STE_LANES
+
+  // Transposing the lanes yields whole 16 byte vertex chunks per quad
+  for (int corner = 0; corner < 4; corner++) {
+    __m128 a0 = cornerX[corner], a1 = cornerY[corner], a2 = pz, a3 = red;
+    __m128 b0 = green, b1 = blue, b2 = alpha, b3 = u[corner];
+    __m128 c0 = v[corner], c1 = tex, c2 = tiling, c3 = zero;
+    _MM_TRANSPOSE4_PS(a0, a1, a2, a3);
+    _MM_TRANSPOSE4_PS(b0, b1, b2, b3);
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+
+    const __m128 rowsA[4] = {a0, a1, a2, a3};
+    const __m128 rowsB[4] = {b0, b1, b2, b3};
+    const __m128 rowsC[4] = {c0, c1, c2, c3};
+    for (int lane = 0; lane < 4; lane++) {
+      auto *dst = reinterpret_cast<float *>(out + lane * 4 + corner);
+      _mm_store_ps(dst, rowsA[lane]);
+      _mm_store_ps(dst + 4, rowsB[lane]);
+      _mm_store_ps(dst + 8, rowsC[lane]);
+      _mm_store_ps(dst + 12, zero);
+    }
+  }
+}
+
+// Bit i of the result is set when quad i intersects the view
+int cullSSE2(const QuadDesc *quads, const AABB &view) {
+  const QuadDesc &q0 = quads[0];
+  const QuadDesc &q1 = quads[1];
+  const QuadDesc &q2 = quads[2];
+  const QuadDesc &q3 = quads[3];
+
+#define STE_LANES(field) _mm_setr_ps(q0.field, q1.field, q2.field, q3.field)
+
+  const __m128 sx = STE_LANES(size.x);
+  const __m128 sy = STE_LANES(size.y);
+
+  __m128 s, c;
+  sincos4(STE_LANES(rotation), s, c);
+
+  // Center and half extents of the quad relative to its origin point
+  const __m128 half = _mm_set1_ps(0.5f);
+  const __m128 hx = _mm_mul_ps(sx, half);
+  const __m128 hy = _mm_mul_ps(sy, half);
+  const __m128 cx = _mm_sub_ps(hx, _mm_mul_ps(STE_LANES(origin.x), sx));
+  const __m128 cy = _mm_sub_ps(hy, _mm_mul_ps(STE_LANES(origin.y), sy));
+
+  const __m128 centerX = _mm_add_ps(
+      STE_LANES(position.x), _mm_sub_ps(_mm_mul_ps(cx, c), _mm_mul_ps(cy, s)));
+  const __m128 centerY = _mm_add_ps(
+      STE_LANES(position.y), _mm_add_ps(_mm_mul_ps(cx, s), _mm_mul_ps(cy, c)));
+#undef STE_LANES
+
+  // Bounds of the rotated quad
+  const __m128 negZero = _mm_set1_ps(-0.0f);
+  const __m128 absS = _mm_andnot_ps(negZero, s);
+  const __m128 absC = _mm_andnot_ps(negZero, c);
+  const __m128 absHx = _mm_andnot_ps(negZero, hx);
+  const __m128 absHy = _mm_andnot_ps(negZero, hy);
+  const __m128 extentX =
+      _mm_add_ps(_mm_mul_ps(absC, absHx), _mm_mul_ps(absS, absHy));
+  const __m128 extentY =
+      _mm_add_ps(_mm_mul_ps(absS, absHx), _mm_mul_ps(absC, absHy));
+
+  const __m128 hitX = _mm_and_ps(
+      _mm_cmple_ps(_mm_sub_ps(centerX, extentX), _mm_set1_ps(view.max.x)),
+      _mm_cmpge_ps(_mm_add_ps(centerX, extentX), _mm_set1_ps(view.min.x)));
+  const __m128 hitY = _mm_and_ps(
+      _mm_cmple_ps(_mm_sub_ps(centerY, extentY), _mm_set1_ps(view.max.y)),
+      _mm_cmpge_ps(_mm_add_ps(centerY, extentY), _mm_set1_ps(view.min.y)));
+  return _mm_movemask_ps(_mm_and_ps(hitX, hitY));
+}
+
+#endif
+
+#if defined(STE_QUAD_KERNELS_AVX2)
+
+STE_TARGET_AVX2 inline void sincos8(__m256 x, __m256 &sinOut,
+                                    __m256 &cosOut) {
+  const __m256i quadrant =
+      _mm256_cvtps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(TWO_OVER_PI)));
+  const __m256 j = _mm256_cvtepi32_ps(quadrant);
+
+  __m256 r = _mm256_sub_ps(x, _mm256_mul_ps(j, _mm256_set1_ps(PIO2_1)));
+  r = _mm256_sub_ps(r, _mm256_mul_ps(j, _mm256_set1_ps(PIO2_2)));
+  r = _mm256_sub_ps(r, _mm256_mul_ps(j, _mm256_set1_ps(PIO2_3)));
+  const __m256 r2 = _mm256_mul_ps(r, r);
+
+  __m256 sinPoly = _mm256_add_ps(
+      _mm256_set1_ps(SIN_C2), _mm256_mul_ps(r2, _mm256_set1_ps(SIN_C3)));
+  sinPoly = _mm256_add_ps(_mm256_set1_ps(SIN_C1), _mm256_mul_ps(r2, sinPoly));
+  sinPoly = _mm256_add_ps(r, _mm256_mul_ps(_mm256_mul_ps(r, r2), sinPoly));
+
+  __m256 cosPoly = _mm256_add_ps(
+      _mm256_set1_ps(COS_C2), _mm256_mul_ps(r2, _mm256_set1_ps(COS_C3)));
+  cosPoly = _mm256_add_ps(_mm256_set1_ps(COS_C1), _mm256_mul_ps(r2, cosPoly));
+  cosPoly = _mm256_add_ps(
+      _mm256_sub_ps(_mm256_set1_ps(1.0f),
+                    _mm256_mul_ps(_mm256_set1_ps(0.5f), r2)),
+      _mm256_mul_ps(_mm256_mul_ps(r2, r2), cosPoly));
+
+  const __m256i one = _mm256_set1_epi32(1);
+  const __m256i two = _mm256_set1_epi32(2);
+  const __m256 swap = _mm256_castsi256_ps(
+      _mm256_cmpeq_epi32(_mm256_and_si256(quadrant, one), one));
+  const __m256 sinSign = _mm256_castsi256_ps(
+      _mm256_slli_epi32(_mm256_and_si256(quadrant, two), 30));
+  const __m256 cosSign = _mm256_castsi256_ps(_mm256_slli_epi32(
+      _mm256_and_si256(_mm256_add_epi32(quadrant, one), two), 30));
+
+  sinOut = _mm256_xor_ps(_mm256_blendv_ps(sinPoly, cosPoly, swap), sinSign);
+  cosOut = _mm256_xor_ps(_mm256_blendv_ps(cosPoly, sinPoly, swap), cosSign);
+}
+
+// In-lane 4x4 transpose, each 128-bit half is transposed independently
+STE_TARGET_AVX2 inline void transpose4x2(__m256 &r0, __m256 &r1, __m256 &r2,
+                                         __m256 &r3) {
+  const __m256 t0 = _mm256_unpacklo_ps(r0, r1);
+  const __m256 t1 = _mm256_unpacklo_ps(r2, r3);
+  const __m256 t2 = _mm256_unpackhi_ps(r0, r1);
+  const __m256 t3 = _mm256_unpackhi_ps(r2, r3);
+  r0 = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0));
+  r1 = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2));
+  r2 = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0));
+  r3 = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(3, 2, 3, 2));
+}
+
+// Loads one float field of 8 consecutive quads
+STE_TARGET_AVX2 inline __m256 gatherField(const QuadDesc *quads,
+                                          __m256i stride, size_t offset) {
+  const auto *base = reinterpret_cast<const float *>(
+      reinterpret_cast<const uint8_t *>(quads) + offset);
+  return _mm256_i32gather_ps(base, stride, sizeof(float));
+}
+
+STE_TARGET_AVX2 void generateAVX2(const QuadDesc *quads,
+                                  const float *texIndices, Vertex *out) {
+  const __m256i stride =
+      _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                         _mm256_set1_epi32(sizeof(QuadDesc) / sizeof(float)));
+
+  // One quad per lane, `word` selects the component of a vector field
+#define STE_GATHER(field, word)                                                \
+  gatherField(quads, stride, offsetof(QuadDesc, field) + (word) * sizeof(float))
+
+  const __m256 px = STE_GATHER(position, 0);
+  const __m256 py = STE_GATHER(position, 1);
+  const __m256 sx = STE_GATHER(size, 0);
+  const __m256 sy = STE_GATHER(size, 1);
+
+  __m256 s, c;
+  sincos8(STE_GATHER(rotation, 0), s, c);
+
+  // Corner extents relative to the origin point
+  const __m256 negZero = _mm256_set1_ps(-0.0f);
+  const __m256 x0 =
+      _mm256_xor_ps(_mm256_mul_ps(STE_GATHER(origin, 0), sx), negZero);
+  const __m256 y0 =
+      _mm256_xor_ps(_mm256_mul_ps(STE_GATHER(origin, 1), sy), negZero);
+  const __m256 x1 = _mm256_add_ps(x0, sx);
+  const __m256 y1 = _mm256_add_ps(y0, sy);
+
+  const __m256 x0c = _mm256_mul_ps(x0, c), x0s = _mm256_mul_ps(x0, s);
+  const __m256 x1c = _mm256_mul_ps(x1, c), x1s = _mm256_mul_ps(x1, s);
+  const __m256 y0c = _mm256_mul_ps(y0, c), y0s = _mm256_mul_ps(y0, s);
+  const __m256 y1c = _mm256_mul_ps(y1, c), y1s = _mm256_mul_ps(y1, s);
+
+  const __m256 cornerX[4] = {_mm256_add_ps(px, _mm256_sub_ps(x0c, y0s)),
+                             _mm256_add_ps(px, _mm256_sub_ps(x1c, y0s)),
+                             _mm256_add_ps(px, _mm256_sub_ps(x1c, y1s)),
+                             _mm256_add_ps(px, _mm256_sub_ps(x0c, y1s))};
+  const __m256 cornerY[4] = {_mm256_add_ps(py, _mm256_add_ps(x0s, y0c)),
+                             _mm256_add_ps(py, _mm256_add_ps(x1s, y0c)),
+                             _mm256_add_ps(py, _mm256_add_ps(x1s, y1c)),
+                             _mm256_add_ps(py, _mm256_add_ps(x0s, y1c))};
+
+  const __m256 pz = STE_GATHER(position, 2);
+  const __m256 red = STE_GATHER(color, 0);
+  const __m256 green = STE_GATHER(color, 1);
+  const __m256 blue = STE_GATHER(color, 2);
+  const __m256 alpha = STE_GATHER(color, 3);
+  // Each texture coordinate is gathered once and shared by two corners
+  const __m256 u0 = STE_GATHER(texCoords, 0);
+  const __m256 v0 = STE_GATHER(texCoords, 1);
+  const __m256 u1 = STE_GATHER(texCoords, 2);
+  const __m256 v1 = STE_GATHER(texCoords, 3);
+#undef STE_GATHER
+  const __m256 u[4] = {u0, u1, u1, u0};
+  const __m256 v[4] = {v0, v0, v1, v1};
+  const __m256 tex = _mm256_loadu_ps(texIndices);
+  const __m256 tiling = _mm256_set1_ps(1.0f);
+  const __m256 zero = _mm256_setzero_ps();
+
+  // Row i of a transpose holds quad i in its low half and quad i + 4 in its
+  // high half
+  __m256 rows[8][4][2];
+  for (int corner = 0; corner < 4; corner++) {
+    __m256 a0 = cornerX[corner], a1 = cornerY[corner], a2 = pz, a3 = red;
+    __m256 b0 = green, b1 = blue, b2 = alpha, b3 = u[corner];
+    __m256 c0 = v[corner], c1 = tex, c2 = tiling, c3 = zero;
+    transpose4x2(a0, a1, a2, a3);
+    transpose4x2(b0, b1, b2, b3);
+    transpose4x2(c0, c1, c2, c3);
+
+    const __m256 rowsA[4] = {a0, a1, a2, a3};
+    const __m256 rowsB[4] = {b0, b1, b2, b3};
+    const __m256 rowsC[4] = {c0, c1, c2, c3};
+    for (int row = 0; row < 4; row++) {
+      rows[row][corner][0] =
+          _mm256_permute2f128_ps(rowsA[row], rowsB[row], 0x20);
+      rows[row][corner][1] = _mm256_permute2f128_ps(rowsC[row], zero, 0x20);
+      rows[row + 4][corner][0] =
+          _mm256_permute2f128_ps(rowsA[row], rowsB[row], 0x31);
+      rows[row + 4][corner][1] =
+          _mm256_permute2f128_ps(rowsC[row], zero, 0x31);
+    }
+  }
+
+  // Write the vertices out in memory order
+  auto *dst = reinterpret_cast<float *>(out);
+  for (int lane = 0; lane < 8; lane++) {
+    for (int corner = 0; corner < 4; corner++, dst += 16) {
+      _mm256_store_ps(dst, rows[lane][corner][0]);
+      _mm256_store_ps(dst + 8, rows[lane][corner][1]);
+    }
+  }
+}
+
+#endif
+
+} // namespace
+
+const char *getActiveKernelName() {
+  switch (activeKernel()) {
+  case Kernel::AVX2:
+    return "avx2";
+  case Kernel::SSE2:
+    return "sse2";
+  default:
+    return "scalar";
+  }
+}
+
+void generate(std::span<const QuadDesc> quads, const float *texIndices,
+              Vertex *out) {
+  size_t i = 0;
+  const Kernel kernel = activeKernel();
+
+#if defined(STE_QUAD_KERNELS_AVX2)
+  if (kernel == Kernel::AVX2) {
+    for (; i + 8 <= quads.size(); i += 8) {
+      generateAVX2(quads.data() + i, texIndices + i, out + i * 4);
+    }
+  }
+#endif
+
+#if defined(STE_QUAD_KERNELS_SSE2)
+  if (kernel != Kernel::Scalar) {
+    for (; i + 4 <= quads.size(); i += 4) {
+      generateSSE2(quads.data() + i, texIndices + i, out + i * 4);
+    }
+  }
+#endif
+
+  const glm::vec4 noOutline{0.0f, 0.0f, 0.0f, 0.0f};
+  for (; i < quads.size(); i++) {
+    generateScalar(quads[i], texIndices[i], 0.0f, noOutline, out + i * 4);
+  }
+}
+
+void generateScalar(const QuadDesc &quad, float texIndex,
+                    float outlineThickness, const glm::vec4 &outlineColor,
+                    Vertex *out) {
+  const float s = quad.rotation != 0.0f ? std::sin(quad.rotation) : 0.0f;
+  const float c = quad.rotation != 0.0f ? std::cos(quad.rotation) : 1.0f;
+
+  // Corner extents relative to the origin point
+  const float x0 = -quad.origin.x * quad.size.x;
+  const float y0 = -quad.origin.y * quad.size.y;
+  const float x1 = x0 + quad.size.x;
+  const float y1 = y0 + quad.size.y;
+
+  const float xs[4] = {x0, x1, x1, x0};
+  const float ys[4] = {y0, y0, y1, y1};
+  const float us[4] = {quad.texCoords.x, quad.texCoords.z, quad.texCoords.z,
+                       quad.texCoords.x};
+  const float vs[4] = {quad.texCoords.y, quad.texCoords.y, quad.texCoords.w,
+                       quad.texCoords.w};
+
+  for (int i = 0; i < 4; i++) {
+    out[i].position = {quad.position.x + (xs[i] * c - ys[i] * s),
+                       quad.position.y + (xs[i] * s + ys[i] * c),
+                       quad.position.z};
+    out[i].color = quad.color;
+    out[i].texCoords = {us[i], vs[i]};
+    out[i].texIndex = texIndex;
+    out[i].tilingFactor = 1.0f;
+    out[i].outlineThickness = outlineThickness;
+    out[i].outlineColor = outlineColor;
+  }
+}
+
+uint32_t cull(std::span<const QuadDesc> quads, const AABB &view,
+              uint8_t *visible) {
+  size_t i = 0;
+  uint32_t visibleCount = 0;
+
+#if defined(STE_QUAD_KERNELS_SSE2)
+  if (activeKernel() != Kernel::Scalar) {
+    for (; i + 4 <= quads.size(); i += 4) {
+      const int mask = cullSSE2(quads.data() + i, view);
+      for (int lane = 0; lane < 4; lane++) {
+        visible[i + lane] = (mask >> lane) & 1;
+      }
+      visibleCount += std::popcount(static_cast<uint32_t>(mask));
+    }
+  }
+#endif
+
+  for (; i < quads.size(); i++) {
+    visible[i] = isVisibleScalar(quads[i], view);
+    visibleCount += visible[i];
+  }
+  return visibleCount;
+}
+
+bool isVisibleScalar(const QuadDesc &quad, const AABB &view) {
+  const float s = quad.rotation != 0.0f ? std::sin(quad.rotation) : 0.0f;
+  const float c = quad.rotation != 0.0f ? std::cos(quad.rotation) : 1.0f;
+
+  // Center and half extents of the quad relative to its origin point
+  const glm::vec2 halfSize = quad.size * 0.5f;
+  const glm::vec2 center = halfSize - quad.origin * quad.size;
+
+  // Bounds of the rotated quad
+  const glm::vec2 worldCenter = {
+      quad.position.x + (center.x * c - center.y * s),
+      quad.position.y + (center.x * s + center.y * c)};
+  const glm::vec2 extents = {
+      std::abs(c) * std::abs(halfSize.x) + std::abs(s) * std::abs(halfSize.y),
+      std::abs(s) * std::abs(halfSize.x) + std::abs(c) * std::abs(halfSize.y)};
+
+  return view.intersects(AABB(worldCenter - extents, worldCenter + extents));
+}
+
+} // namespace ste::quad_kernels
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <span>
+
+#include "renderer_2d.h"
+
+namespace ste {
+
+// Vertex generation kernels used by Renderer2D. The SIMD paths transform
+// several quads at once (4 with SSE2, 8 with AVX2) and write whole vertices
+// with aligned stores, the scalar path handles the remainder and platforms
+// without SSE2. Regular stores are used on purpose: the batch is read back by
+// glBufferSubData right after, so keeping it in cache beats streaming it out.
+namespace quad_kernels {
+
+// Name of the kernel selected for this CPU ("avx2", "sse2" or "scalar")
+const char *getActiveKernelName();
+
+// Writes 4 vertices per quad to `out`, which must be 64-byte aligned.
+// `texIndices` holds the resolved texture slot of each quad.
+void generate(std::span<const Renderer2D::QuadDesc> quads,
+              const float *texIndices, Renderer2D::Vertex *out);
+
+// Reference implementation, also used for single quads
+void generateScalar(const Renderer2D::QuadDesc &quad, float texIndex,
+                    float outlineThickness, const glm::vec4 &outlineColor,
+                    Renderer2D::Vertex *out);
+
+// Tests the bounds of the rotated quads against `view` several at a time,
+// writes 1 to `visible` for the quads intersecting it and 0 for the others.
+// Returns the number of visible quads.
+uint32_t cull(std::span<const Renderer2D::QuadDesc> quads, const AABB &view,
+              uint8_t *visible);
+
+// Reference implementation, also used for single quads
+bool isVisibleScalar(const Renderer2D::QuadDesc &quad, const AABB &view);
+
+} // namespace quad_kernels
+
+} // namespace ste
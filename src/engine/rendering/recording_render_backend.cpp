@@ -0,0 +1,52 @@
+#include "recording_render_backend.h"
+
+namespace ste {
+
+void RecordingRenderBackend::beginScene(const glm::mat4 &viewProjection) {
+  m_viewProjection = viewProjection;
+  m_batches.clear();
+}
+
+void RecordingRenderBackend::endScene() { m_stats.scenes++; }
+
+void RecordingRenderBackend::submit(const RenderBatch &batch) {
+  Batch &recorded = m_batches.emplace_back();
+  recorded.vertexCount = static_cast<uint32_t>(batch.vertices.size());
+  recorded.indexCount = batch.indexCount;
+  recorded.textureCount = static_cast<uint32_t>(batch.textures.size());
+  recorded.blendMode = batch.blendMode;
+  recorded.reason = batch.reason;
+  recorded.shaderFeatures = batch.shaderFeatures;
+  recorded.depthMode = batch.depthMode;
+  recorded.clipRect = batch.clipRect;
+  if (m_recordVertices) {
+    recorded.vertices.assign(batch.vertices.begin(), batch.vertices.end());
+  }
+
+  // Count state changes the way a GL backend behind GLStateCache would
+  // issue them
+  for (uint32_t i = 0; i < recorded.textureCount; i++) {
+    recorded.textures[i] = batch.textures[i];
+    if (i > 0 && m_boundTextures[i] != batch.textures[i]) {
+      m_boundTextures[i] = batch.textures[i];
+      m_stats.textureBinds++;
+    }
+  }
+  if (batch.blendMode != m_blendMode) {
+    m_blendMode = batch.blendMode;
+    m_stats.blendChanges++;
+  }
+  if (batch.shaderFeatures != m_shaderFeatures) {
+    m_shaderFeatures = batch.shaderFeatures;
+    m_stats.shaderChanges++;
+  }
+
+  m_stats.drawCalls++;
+  m_stats.vertexCount += batch.vertices.size();
+  m_stats.indexCount += batch.indexCount;
+  m_stats.vertexBytes += batch.vertices.size_bytes();
+  m_stats.indexBytes += batch.indexCount * sizeof(uint32_t);
+  m_stats.flushReasons[static_cast<size_t>(batch.reason)]++;
+}
+
+} // namespace ste
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <array>
+#include <optional>
+#include <vector>
+
+#include "render_backend.h"
+
+namespace ste {
+
+// Backend without any GPU work, it only records what would have been drawn.
+// Lets batching, culling and layout be profiled or checked without a GL
+// context, e.g. Renderer2D renderer(std::make_shared<RecordingRenderBackend>())
+class RecordingRenderBackend : public RenderBackend {
+public:
+  struct Batch {
+    uint32_t vertexCount = 0;
+    uint32_t indexCount = 0;
+    std::array<uint32_t, MAX_TEXTURE_SLOTS> textures{};
+    uint32_t textureCount = 0;
+    BlendMode blendMode = BlendMode::Alpha;
+    FlushReason reason = FlushReason::EndScene;
+    uint32_t shaderFeatures = shader_features::All;
+    DepthMode depthMode = DepthMode::None;
+    std::optional<glm::vec4> clipRect;
+    // Only filled when vertex recording is enabled
+    std::vector<QuadVertex> vertices;
+  };
+
+  // Totals since the last resetStats, byte counts are what a GPU backend
+  // would have uploaded
+  struct Statistics {
+    uint32_t scenes = 0;
+    uint32_t drawCalls = 0;
+    uint64_t vertexCount = 0;
+    uint64_t indexCount = 0;
+    uint64_t vertexBytes = 0;
+    uint64_t indexBytes = 0;
+    // Texture slots whose id differs from the previous batch
+    uint32_t textureBinds = 0;
+    uint32_t blendChanges = 0;
+    // Batches whose shader permutation differs from the previous one
+    uint32_t shaderChanges = 0;
+    std::array<uint32_t, static_cast<size_t>(FlushReason::Count)>
+        flushReasons{};
+  };
+
+  explicit RecordingRenderBackend(bool recordVertices = false)
+      : m_recordVertices(recordVertices) {}
+
+  const char *getName() const override { return "recording"; }
+
+  void beginScene(const glm::mat4 &viewProjection) override;
+  void endScene() override;
+  void submit(const RenderBatch &batch) override;
+
+  // Batches of the current (or last finished) scene
+  const std::vector<Batch> &getBatches() const { return m_batches; }
+  const glm::mat4 &getViewProjection() const { return m_viewProjection; }
+
+  const Statistics &getStats() const { return m_stats; }
+  void resetStats() { m_stats = Statistics(); }
+
+private:
+  bool m_recordVertices;
+  std::vector<Batch> m_batches;
+  glm::mat4 m_viewProjection{1.0f};
+  Statistics m_stats{};
+
+  std::array<uint32_t, MAX_TEXTURE_SLOTS> m_boundTextures{};
+  BlendMode m_blendMode = BlendMode::Alpha;
+  uint32_t m_shaderFeatures = shader_features::All;
+};
+
+} // namespace ste
@@ -0,0 +1,22 @@
+#include "render_backend.h"
+
+namespace ste {
+
+const char *getFlushReasonName(FlushReason reason) {
+  switch (reason) {
+  case FlushReason::EndScene:
+    return "end scene";
+  case FlushReason::BufferFull:
+    return "buffer full";
+  case FlushReason::TextureSlotsFull:
+    return "texture slots full";
+  case FlushReason::BlendChange:
+    return "blend change";
+  case FlushReason::ClipChange:
+    return "clip change";
+  default:
+    return "unknown";
+  }
+}
+
+} // namespace ste
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <span>
+
+#include <glm/glm.hpp>
+
+namespace ste {
+
+enum class BlendMode {
+  None,
+  Alpha,
+  Additive,
+  Multiply,
+  Screen,
+  Subtract,
+  Premultiplied // colors already multiplied by alpha, e.g. render targets
+};
+
+// Depth state of a batch. Opaque batches test and write depth, transparent
+// ones only test against them so opaque quads in front hide them.
+enum class DepthMode { None, Opaque, Transparent };
+
+// Why a batch was submitted to the backend
+enum class FlushReason {
+  EndScene,
+  BufferFull,
+  TextureSlotsFull,
+  BlendChange,
+  ClipChange,
+  Count
+};
+
+const char *getFlushReasonName(FlushReason reason);
+
+// Fragment shader features used by the quads of a batch. A backend can pick
+// a specialized shader per batch, plain sprites then skip the outline and
+// SDF math and untextured batches never touch the samplers.
+namespace shader_features {
+constexpr uint32_t Textured = 1 << 0; // a quad samples a texture slot > 0
+constexpr uint32_t Outlined = 1 << 1; // a quad has an outline
+constexpr uint32_t Shapes = 1 << 2;   // SDF circles, rings or arcs
+constexpr uint32_t SdfText = 1 << 3;  // glyphs from a distance field atlas
+constexpr uint32_t All = Textured | Outlined | Shapes | SdfText;
+constexpr uint32_t PermutationCount = All + 1;
+} // namespace shader_features
+
+// Kept at 64 bytes and cache-line aligned so the SIMD kernels can write
+// whole vertices with aligned stores
+struct alignas(64) QuadVertex {
+  glm::vec3 position;
+  glm::vec4 color;
+  glm::vec2 texCoords;
+  float texIndex;
+  float tilingFactor;
+  float outlineThickness;
+  glm::vec4 outlineColor;
+};
+
+// A batch of quads as built by Renderer2D. Indices are implicit, every 4
+// vertices form a quad drawn as two triangles (0 1 2, 2 3 0).
+struct RenderBatch {
+  std::span<const QuadVertex> vertices;
+  uint32_t indexCount = 0;
+  // Texture id per slot, vertices reference slots through texIndex. Slot 0
+  // is always 0 and stands for the backend's white texture.
+  std::span<const uint32_t> textures;
+  BlendMode blendMode = BlendMode::Alpha;
+  FlushReason reason = FlushReason::EndScene;
+  // shader_features bits, a backend ignoring them must support all features
+  uint32_t shaderFeatures = shader_features::All;
+  DepthMode depthMode = DepthMode::None;
+  // Scissor rectangle in normalized device coordinates (min x, min y,
+  // max x, max y), pixels outside are discarded
+  std::optional<glm::vec4> clipRect;
+};
+
+// Consumes the batches built by Renderer2D. The front-end does culling,
+// batching and vertex generation, a backend only has to get the batches on
+// screen (or record them).
+class RenderBackend {
+public:
+  static constexpr uint32_t MAX_QUADS = 10000;
+  static constexpr uint32_t MAX_VERTICES = MAX_QUADS * 4;
+  static constexpr uint32_t MAX_INDICES = MAX_QUADS * 6;
+  static constexpr uint32_t MAX_TEXTURE_SLOTS = 16;
+
+  virtual ~RenderBackend() = default;
+
+  virtual const char *getName() const = 0;
+
+  // Scenes with depth tested batches start with a cleared depth buffer
+  virtual void beginScene(const glm::mat4 &viewProjection) = 0;
+  virtual void endScene() {}
+
+  // Called once per batch, the batch data is only valid during the call
+  virtual void submit(const RenderBatch &batch) = 0;
+};
+
+} // namespace ste
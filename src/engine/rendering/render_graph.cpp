@@ -0,0 +1,318 @@
+#include "render_graph.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "gl_state.h"
+#include "render_profiler.h"
+
+namespace ste {
+
+uint32_t RenderGraph::PassContext::getTexture(Resource resource) const {
+  const auto *physical = m_graph.m_targets[resource].physical;
+  return physical ? physical->getColorTexture() : 0;
+}
+
+uint32_t RenderGraph::PassContext::getFramebuffer(Resource resource) const {
+  if (resource == BACKBUFFER) {
+    return GLStateCache::get().getDefaultFramebuffer();
+  }
+  const auto *physical = m_graph.m_targets[resource].physical;
+  return physical ? physical->getFramebuffer() : 0;
+}
+
+glm::ivec2 RenderGraph::PassContext::getSize(Resource resource) const {
+  if (resource == BACKBUFFER) {
+    return {m_graph.m_backbufferWidth, m_graph.m_backbufferHeight};
+  }
+  const auto &target = m_graph.m_targets[resource];
+  return {target.width, target.height};
+}
+
+RenderGraph::RenderGraph() {
+  // Slot 0 stands in for the default framebuffer
+  Target backbuffer;
+  backbuffer.name = "backbuffer";
+  m_targets.push_back(std::move(backbuffer));
+}
+
+RenderGraph::Resource RenderGraph::createTarget(std::string name,
+                                                const TargetDesc &desc) {
+  Target target;
+  target.name = std::move(name);
+  target.desc = desc;
+  m_targets.push_back(std::move(target));
+  return static_cast<Resource>(m_targets.size() - 1);
+}
+
+RenderGraph::Resource RenderGraph::importTarget(std::string name,
+                                                const RenderTarget &physical) {
+  Target target;
+  target.name = std::move(name);
+  target.desc.width = physical.getWidth();
+  target.desc.height = physical.getHeight();
+  target.desc.internalFormat = physical.getInternalFormat();
+  target.desc.filter = physical.getFilter();
+  target.desc.depth = physical.hasDepth();
+  target.width = physical.getWidth();
+  target.height = physical.getHeight();
+  target.imported = true;
+  target.physical = &physical;
+  m_targets.push_back(std::move(target));
+  return static_cast<Resource>(m_targets.size() - 1);
+}
+
+void RenderGraph::addPass(PassDesc desc, ExecuteFn execute) {
+  Pass pass;
+  pass.desc = std::move(desc);
+  pass.execute = std::move(execute);
+  m_passes.push_back(std::move(pass));
+}
+
+void RenderGraph::cullPasses() {
+  // Walk backwards from the backbuffer, a pass survives if anything alive
+  // after it consumes its output
+  std::vector<bool> needed(m_targets.size(), false);
+  needed[BACKBUFFER] = true;
+
+  for (auto it = m_passes.rbegin(); it != m_passes.rend(); ++it) {
+    it->alive = it->desc.sideEffect || needed[it->desc.write];
+    if (!it->alive) {
+      m_stats.culledPasses++;
+      continue;
+    }
+
+    for (Resource read : it->desc.reads) {
+      needed[read] = true;
+    }
+  }
+}
+
+std::vector<uint32_t> RenderGraph::schedulePasses() const {
+  std::vector<uint32_t> alive;
+  for (uint32_t i = 0; i < m_passes.size(); i++) {
+    if (m_passes[i].alive) {
+      alive.push_back(i);
+    }
+  }
+
+  // Declaration order is a valid order, only hazards on the same target
+  // (read after write, write after write, write after read) constrain it
+  auto dependsOn = [&](const PassDesc &later, const PassDesc &earlier) {
+    const auto &laterReads = later.reads;
+    const auto &earlierReads = earlier.reads;
+    return later.write == earlier.write ||
+           std::find(laterReads.begin(), laterReads.end(), earlier.write) !=
+               laterReads.end() ||
+           std::find(earlierReads.begin(), earlierReads.end(), later.write) !=
+               earlierReads.end();
+  };
+
+  std::vector<uint32_t> pendingDeps(alive.size(), 0);
+  std::vector<std::vector<uint32_t>> dependents(alive.size());
+  for (uint32_t j = 0; j < alive.size(); j++) {
+    for (uint32_t i = 0; i < j; i++) {
+      if (dependsOn(m_passes[alive[j]].desc, m_passes[alive[i]].desc)) {
+        dependents[i].push_back(j);
+        pendingDeps[j]++;
+      }
+    }
+  }
+
+  // Topological sort that keeps drawing into the current framebuffer while
+  // any ready pass writes to it, otherwise falls back to declaration order
+  std::vector<uint32_t> order;
+  std::vector<bool> scheduled(alive.size(), false);
+  std::optional<Resource> currentWrite;
+  while (order.size() < alive.size()) {
+    int next = -1;
+    for (uint32_t i = 0; i < alive.size(); i++) {
+      if (scheduled[i] || pendingDeps[i] != 0)
+        continue;
+      if (next == -1) {
+        next = static_cast<int>(i);
+      }
+      if (currentWrite && m_passes[alive[i]].desc.write == *currentWrite) {
+        next = static_cast<int>(i);
+        break;
+      }
+    }
+
+    scheduled[next] = true;
+    order.push_back(alive[next]);
+    currentWrite = m_passes[alive[next]].desc.write;
+    for (uint32_t dependent : dependents[next]) {
+      pendingDeps[dependent]--;
+    }
+  }
+
+  return order;
+}
+
+bool RenderGraph::allocateTargets(const std::vector<uint32_t> &order) {
+  // Lifetimes in scheduled order
+  for (int position = 0; position < static_cast<int>(order.size());
+       position++) {
+    const auto &desc = m_passes[order[position]].desc;
+    auto touch = [&](Resource resource) {
+      if (resource == BACKBUFFER)
+        return;
+      auto &target = m_targets[resource];
+      if (target.firstUse == -1) {
+        target.firstUse = position;
+      }
+      target.lastUse = position;
+    };
+
+    for (Resource read : desc.reads) {
+      touch(read);
+    }
+    touch(desc.write);
+  }
+
+  // Targets are acquired at their first use and returned to the pool after
+  // their last, so later targets can alias the same framebuffer
+  for (int position = 0; position < static_cast<int>(order.size());
+       position++) {
+    for (uint32_t i = 1; i < m_targets.size(); i++) {
+      auto &target = m_targets[i];
+      if (target.imported || target.firstUse != position)
+        continue;
+
+      target.width = target.desc.width > 0
+                         ? target.desc.width
+                         : std::max(1, static_cast<int>(m_backbufferWidth *
+                                                        target.desc.scale));
+      target.height = target.desc.height > 0
+                          ? target.desc.height
+                          : std::max(1, static_cast<int>(m_backbufferHeight *
+                                                         target.desc.scale));
+      target.physical = acquireTarget(target.width, target.height, target.desc);
+      if (!target.physical) {
+        std::cerr << "Failed to allocate render target: " << target.name
+                  << std::endl;
+        return false;
+      }
+      m_stats.transientTargets++;
+    }
+
+    for (uint32_t i = 1; i < m_targets.size(); i++) {
+      if (!m_targets[i].imported && m_targets[i].lastUse == position) {
+        releaseTarget(m_targets[i].physical);
+      }
+    }
+  }
+
+  return true;
+}
+
+RenderTarget *RenderGraph::acquireTarget(int width, int height,
+                                         const TargetDesc &desc) {
+  for (auto &pooled : m_pool) {
+    const auto &target = *pooled.target;
+    if (!pooled.inUse && target.getWidth() == width &&
+        target.getHeight() == height &&
+        target.getInternalFormat() == desc.internalFormat &&
+        target.getFilter() == desc.filter &&
+        target.hasDepth() == desc.depth) {
+      pooled.inUse = true;
+      pooled.usedThisFrame = true;
+      return pooled.target.get();
+    }
+  }
+
+  RenderTarget::CreateInfo createInfo;
+  createInfo.width = width;
+  createInfo.height = height;
+  createInfo.internalFormat = desc.internalFormat;
+  createInfo.filter = desc.filter;
+  createInfo.depth = desc.depth;
+  auto target = RenderTarget::create(createInfo);
+  if (!target) {
+    std::cerr << createInfo.errorMsg << std::endl;
+    return nullptr;
+  }
+
+  PooledTarget pooled;
+  pooled.target = std::make_unique<RenderTarget>(std::move(*target));
+  pooled.inUse = true;
+  pooled.usedThisFrame = true;
+  m_pool.push_back(std::move(pooled));
+  return m_pool.back().target.get();
+}
+
+void RenderGraph::releaseTarget(const RenderTarget *target) {
+  for (auto &pooled : m_pool) {
+    if (pooled.target.get() == target) {
+      pooled.inUse = false;
+      return;
+    }
+  }
+}
+
+void RenderGraph::execute(int backbufferWidth, int backbufferHeight) {
+  m_backbufferWidth = backbufferWidth;
+  m_backbufferHeight = backbufferHeight;
+  m_stats = Statistics();
+  m_stats.passCount = static_cast<uint32_t>(m_passes.size());
+
+  cullPasses();
+  const std::vector<uint32_t> order = schedulePasses();
+
+  auto &state = GLStateCache::get();
+  if (allocateTargets(order)) {
+    const uint32_t switchesBefore = state.getStats().framebufferSwitches;
+
+    for (uint32_t index : order) {
+      const auto &pass = m_passes[index];
+      const auto &output = m_targets[pass.desc.write];
+      if (pass.desc.write == BACKBUFFER) {
+        RenderTarget::bindDefault(m_backbufferWidth, m_backbufferHeight);
+      } else {
+        output.physical->bind();
+      }
+
+      if (pass.desc.clearColor) {
+        // A scissor rect left by an earlier pass would clip the clear
+        state.setScissorTestEnabled(false);
+        const glm::vec4 &color = *pass.desc.clearColor;
+        glClearColor(color.x, color.y, color.z, color.w);
+        GLbitfield mask = GL_COLOR_BUFFER_BIT;
+        if (output.physical && output.physical->hasDepth()) {
+          state.setDepthWriteEnabled(true);
+          mask |= GL_DEPTH_BUFFER_BIT;
+        }
+        glClear(mask);
+      }
+
+      if (pass.desc.viewport) {
+        state.setViewport(0, 0, pass.desc.viewport->x, pass.desc.viewport->y);
+      }
+
+      RenderProfiler::Scope scope(pass.desc.name);
+      pass.execute(PassContext(*this, pass.desc.write));
+    }
+
+    m_stats.framebufferSwitches =
+        state.getStats().framebufferSwitches - switchesBefore;
+  }
+
+  // Age the pool, framebuffers nobody asked for in a while are destroyed
+  for (auto &pooled : m_pool) {
+    pooled.idleFrames = pooled.usedThisFrame ? 0 : pooled.idleFrames + 1;
+    pooled.usedThisFrame = false;
+    pooled.inUse = false;
+  }
+  std::erase_if(m_pool, [](const PooledTarget &pooled) {
+    return pooled.idleFrames > MAX_IDLE_FRAMES;
+  });
+  m_stats.pooledTargets = static_cast<uint32_t>(m_pool.size());
+
+  // Leave the default framebuffer bound for presenting
+  RenderTarget::bindDefault(m_backbufferWidth, m_backbufferHeight);
+
+  m_passes.clear();
+  m_targets.resize(1);
+}
+
+} // namespace ste
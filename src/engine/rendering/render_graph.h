@@ -0,0 +1,145 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "render_target.h"
+
+namespace ste {
+
+// Per-frame graph of render passes. Passes declare the targets they read and
+// the target they write, the graph then:
+//  - culls passes whose output is never consumed,
+//  - orders the remaining passes so consecutive passes share a framebuffer
+//    when the dependencies allow it,
+//  - backs transient targets with pooled framebuffers, aliasing targets whose
+//    lifetimes do not overlap onto the same framebuffer.
+// Targets that must outlive the frame (e.g. cached UI panels) are owned by
+// their subsystem and imported, the graph binds them but never pools them.
+// Passes are rebuilt every frame, the pool persists between frames.
+class RenderGraph {
+public:
+  using Resource = uint32_t;
+
+  // Handle of the default framebuffer, always consumed
+  static constexpr Resource BACKBUFFER = 0;
+
+  struct TargetDesc {
+    // A zero size follows the backbuffer size multiplied by scale
+    int width = 0;
+    int height = 0;
+    float scale = 1.0f;
+    GLenum internalFormat = GL_RGBA8;
+    GLenum filter = GL_LINEAR;
+    // Depth attachment, cleared along with the color
+    bool depth = false;
+  };
+
+  class PassContext {
+  public:
+    // Color texture of a target the pass declared as read
+    uint32_t getTexture(Resource resource) const;
+    // Framebuffer of a target, e.g. as the source of a blit
+    uint32_t getFramebuffer(Resource resource) const;
+    glm::ivec2 getSize(Resource resource) const;
+    glm::ivec2 getOutputSize() const { return getSize(m_output); }
+
+  private:
+    friend class RenderGraph;
+    PassContext(const RenderGraph &graph, Resource output)
+        : m_graph(graph), m_output(output) {}
+
+    const RenderGraph &m_graph;
+    Resource m_output;
+  };
+
+  struct PassDesc {
+    std::string name;
+    std::vector<Resource> reads;
+    Resource write = BACKBUFFER;
+    std::optional<glm::vec4> clearColor;
+    // Draws into the lower left corner of the output instead of all of it,
+    // e.g. for dynamic resolution
+    std::optional<glm::ivec2> viewport;
+    // Keep the pass even if nothing reads its output
+    bool sideEffect = false;
+  };
+
+  using ExecuteFn = std::function<void(const PassContext &)>;
+
+  struct Statistics {
+    uint32_t passCount = 0;
+    uint32_t culledPasses = 0;
+    uint32_t framebufferSwitches = 0;
+    uint32_t transientTargets = 0;
+    uint32_t pooledTargets = 0;
+  };
+
+  RenderGraph();
+  RenderGraph(const RenderGraph &) = delete;
+  RenderGraph &operator=(const RenderGraph &) = delete;
+
+  // Declares a transient target that only lives for this frame
+  Resource createTarget(std::string name, const TargetDesc &desc);
+  // Declares a target owned elsewhere, it must stay alive until execute()
+  Resource importTarget(std::string name, const RenderTarget &target);
+
+  void addPass(PassDesc desc, ExecuteFn execute);
+
+  // Compiles and runs the frame, then clears the passes and targets
+  void execute(int backbufferWidth, int backbufferHeight);
+
+  Statistics getStats() const { return m_stats; }
+
+  // Drops pooled framebuffers, e.g. after a resize
+  void clearPool() { m_pool.clear(); }
+
+private:
+  // Pooled framebuffers unused for this many frames are destroyed
+  static constexpr uint32_t MAX_IDLE_FRAMES = 3;
+
+  struct Target {
+    std::string name;
+    TargetDesc desc;
+    int width = 0;
+    int height = 0;
+    int firstUse = -1;
+    int lastUse = -1;
+    bool imported = false;
+    const RenderTarget *physical = nullptr;
+  };
+
+  struct Pass {
+    PassDesc desc;
+    ExecuteFn execute;
+    bool alive = false;
+  };
+
+  struct PooledTarget {
+    std::unique_ptr<RenderTarget> target;
+    uint32_t idleFrames = 0;
+    bool inUse = false;
+    bool usedThisFrame = false;
+  };
+
+  void cullPasses();
+  std::vector<uint32_t> schedulePasses() const;
+  bool allocateTargets(const std::vector<uint32_t> &order);
+  RenderTarget *acquireTarget(int width, int height, const TargetDesc &desc);
+  void releaseTarget(const RenderTarget *target);
+
+  std::vector<Target> m_targets;
+  std::vector<Pass> m_passes;
+  std::vector<PooledTarget> m_pool;
+  int m_backbufferWidth = 0;
+  int m_backbufferHeight = 0;
+  Statistics m_stats{};
+};
+
+} // namespace ste
@@ -0,0 +1,299 @@
+#include "render_profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "fonts.h"
+#include "renderer_2d.h"
+
+namespace ste {
+
+namespace {
+constexpr uint32_t QUERIES_PER_FRAME =
+    RenderProfiler::MAX_SCOPES_PER_FRAME * 2 + 2;
+
+double toMilliseconds(std::chrono::steady_clock::duration duration) {
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+} // namespace
+
+RenderProfiler::Scope::Scope(std::string_view name) {
+  auto &profiler = RenderProfiler::get();
+  m_active = profiler.m_enabled && profiler.m_inFrame;
+  if (m_active) {
+    profiler.beginScope(name);
+  }
+}
+
+RenderProfiler::Scope::~Scope() {
+  if (m_active) {
+    RenderProfiler::get().endScope();
+  }
+}
+
+RenderProfiler::CpuTimer::CpuTimer(CpuCounter counter) : m_counter(counter) {
+  const auto &profiler = RenderProfiler::get();
+  m_active = profiler.m_enabled && profiler.m_inFrame;
+  if (m_active) {
+    m_start = Clock::now();
+  }
+}
+
+RenderProfiler::CpuTimer::~CpuTimer() {
+  if (m_active) {
+    RenderProfiler::get().addCpuTime(m_counter, Clock::now() - m_start);
+  }
+}
+
+bool RenderProfiler::allocateQuery(FrameData &frame, uint32_t &query) {
+  if (frame.queryCount >= frame.queries.size()) {
+    return false;
+  }
+  query = frame.queries[frame.queryCount++];
+  return true;
+}
+
+void RenderProfiler::beginFrame() {
+  if (!m_enabled || m_inFrame)
+    return;
+
+  m_frameIndex = static_cast<uint32_t>(m_frameNumber % FRAME_LATENCY);
+  FrameData &frame = m_frames[m_frameIndex];
+
+  // This slot still holds the frame from FRAME_LATENCY frames ago
+  if (frame.pending) {
+    resolveFrame(frame);
+  }
+
+  if (frame.queries.empty()) {
+    frame.queries.resize(QUERIES_PER_FRAME);
+    glGenQueries(QUERIES_PER_FRAME, frame.queries.data());
+  }
+
+  frame.queryCount = 0;
+  frame.scopes.clear();
+  frame.openScopes.clear();
+  frame.counters = {};
+  frame.stallCount = 0;
+  frame.droppedScopes = 0;
+  frame.frame = m_frameNumber;
+
+  allocateQuery(frame, frame.frameBeginQuery);
+  glQueryCounter(frame.frameBeginQuery, GL_TIMESTAMP);
+  frame.cpuStart = Clock::now();
+  m_inFrame = true;
+}
+
+void RenderProfiler::endFrame() {
+  if (!m_inFrame)
+    return;
+
+  FrameData &frame = m_frames[m_frameIndex];
+  frame.cpuElapsed = Clock::now() - frame.cpuStart;
+
+  // Scopes left open have no end timestamp, drop their GPU part
+  for (uint32_t index : frame.openScopes) {
+    frame.scopes[index].beginQuery = 0;
+    frame.scopes[index].endQuery = 0;
+  }
+  frame.openScopes.clear();
+
+  allocateQuery(frame, frame.frameEndQuery);
+  glQueryCounter(frame.frameEndQuery, GL_TIMESTAMP);
+  frame.pending = true;
+
+  m_inFrame = false;
+  m_frameNumber++;
+}
+
+void RenderProfiler::beginScope(std::string_view name) {
+  FrameData &frame = m_frames[m_frameIndex];
+
+  ScopeRecord record;
+  record.name = name;
+
+  // Out of queries, keep the CPU timing and report the drop
+  if (frame.scopes.size() >= MAX_SCOPES_PER_FRAME ||
+      !allocateQuery(frame, record.beginQuery) ||
+      !allocateQuery(frame, record.endQuery)) {
+    record.beginQuery = 0;
+    record.endQuery = 0;
+    frame.droppedScopes++;
+  } else {
+    glQueryCounter(record.beginQuery, GL_TIMESTAMP);
+  }
+
+  record.cpuStart = Clock::now();
+  frame.openScopes.push_back(static_cast<uint32_t>(frame.scopes.size()));
+  frame.scopes.push_back(std::move(record));
+}
+
+void RenderProfiler::endScope() {
+  FrameData &frame = m_frames[m_frameIndex];
+  if (frame.openScopes.empty())
+    return;
+
+  ScopeRecord &record = frame.scopes[frame.openScopes.back()];
+  frame.openScopes.pop_back();
+
+  record.cpuElapsed = Clock::now() - record.cpuStart;
+  if (record.endQuery != 0) {
+    glQueryCounter(record.endQuery, GL_TIMESTAMP);
+  }
+}
+
+void RenderProfiler::addCpuTime(CpuCounter counter,
+                                std::chrono::nanoseconds elapsed) {
+  if (!m_inFrame)
+    return;
+  m_frames[m_frameIndex].counters[static_cast<size_t>(counter)] += elapsed;
+}
+
+void RenderProfiler::addStall() {
+  if (!m_inFrame)
+    return;
+  m_frames[m_frameIndex].stallCount++;
+}
+
+void RenderProfiler::resolveFrame(FrameData &frame) {
+  frame.pending = false;
+
+  // Never block on the GPU, a frame that is not done yet is skipped
+  GLint available = 0;
+  glGetQueryObjectiv(frame.frameEndQuery, GL_QUERY_RESULT_AVAILABLE,
+                     &available);
+  if (!available)
+    return;
+
+  auto readTimestamp = [](uint32_t query) {
+    GLuint64 timestamp = 0;
+    glGetQueryObjectui64v(query, GL_QUERY_RESULT, &timestamp);
+    return timestamp;
+  };
+
+  FrameReport report;
+  report.frame = frame.frame;
+  report.cpuFrameMs = toMilliseconds(frame.cpuElapsed);
+  report.gpuFrameMs = (readTimestamp(frame.frameEndQuery) -
+                       readTimestamp(frame.frameBeginQuery)) /
+                      1.0e6;
+  for (size_t i = 0; i < frame.counters.size(); i++) {
+    report.cpuCounterMs[i] = toMilliseconds(frame.counters[i]);
+  }
+  report.stallCount = frame.stallCount;
+  report.droppedScopes = frame.droppedScopes;
+
+  // Scopes sharing a name are summed, in order of first appearance
+  for (const auto &record : frame.scopes) {
+    ScopeTiming *timing = nullptr;
+    for (auto &existing : report.scopes) {
+      if (existing.name == record.name) {
+        timing = &existing;
+        break;
+      }
+    }
+    if (!timing) {
+      timing = &report.scopes.emplace_back();
+      timing->name = record.name;
+    }
+
+    if (record.endQuery != 0) {
+      timing->gpuMs += (readTimestamp(record.endQuery) -
+                        readTimestamp(record.beginQuery)) /
+                       1.0e6;
+    }
+    timing->cpuMs += toMilliseconds(record.cpuElapsed);
+    timing->count++;
+  }
+
+  m_lastReport = std::move(report);
+}
+
+void RenderProfiler::drawOverlay(Renderer2D &renderer,
+                                 TextRenderer &textRenderer, Font &font,
+                                 const glm::vec2 &position) {
+  const FrameReport &report = m_lastReport;
+  const Renderer2D::Statistics stats = renderer.getStats();
+
+  std::vector<std::string> lines;
+  char buffer[160];
+
+  std::snprintf(buffer, sizeof(buffer), "CPU %.2f ms  GPU %.2f ms (%s bound)",
+                report.cpuFrameMs, report.gpuFrameMs,
+                report.gpuFrameMs > report.cpuFrameMs ? "GPU" : "CPU");
+  lines.emplace_back(buffer);
+
+  std::snprintf(
+      buffer, sizeof(buffer), "Vertices %.2f ms  Upload %.2f ms",
+      report.cpuCounterMs[static_cast<size_t>(CpuCounter::VertexGeneration)],
+      report.cpuCounterMs[static_cast<size_t>(CpuCounter::Upload)]);
+  lines.emplace_back(buffer);
+
+  std::snprintf(buffer, sizeof(buffer), "Stalls %u (%.2f ms)",
+                report.stallCount,
+                report.cpuCounterMs[static_cast<size_t>(CpuCounter::Stall)]);
+  lines.emplace_back(buffer);
+
+  std::snprintf(buffer, sizeof(buffer), "Draws %u  Quads %u  Culled %u",
+                stats.drawCalls, stats.quadCount, stats.culledQuads);
+  lines.emplace_back(buffer);
+
+  for (size_t i = 0; i < stats.flushReasons.size(); i++) {
+    if (stats.flushReasons[i] == 0)
+      continue;
+    std::snprintf(buffer, sizeof(buffer), "  flush %s: %u",
+                  getFlushReasonName(static_cast<FlushReason>(i)),
+                  stats.flushReasons[i]);
+    lines.emplace_back(buffer);
+  }
+
+  for (const auto &scope : report.scopes) {
+    std::snprintf(buffer, sizeof(buffer), "%s x%u  GPU %.3f  CPU %.3f",
+                  scope.name.c_str(), scope.count, scope.gpuMs, scope.cpuMs);
+    lines.emplace_back(buffer);
+  }
+
+  if (report.droppedScopes > 0) {
+    std::snprintf(buffer, sizeof(buffer), "Dropped scopes %u",
+                  report.droppedScopes);
+    lines.emplace_back(buffer);
+  }
+
+  // Background sized to the widest line
+  const float lineHeight = font.getLineHeight();
+  float width = 0.0f;
+  for (const auto &line : lines) {
+    width =
+        std::max(width, textRenderer.calculateMetrics(font, line).width);
+  }
+
+  // CPU and GPU frame time bars, full width is one 60 Hz frame
+  constexpr float FRAME_BUDGET_MS = 1000.0f / 60.0f;
+  constexpr float BAR_HEIGHT = 4.0f;
+  const float barWidth = std::max(width, 160.0f);
+  const float height = lineHeight * lines.size() + (BAR_HEIGHT + 2.0f) * 2.0f;
+
+  renderer.drawQuad({position.x - 8.0f, position.y - 8.0f, 0.0f},
+                    {barWidth + 16.0f, height + 16.0f},
+                    {0.0f, 0.0f, 0.0f, 0.6f});
+
+  glm::vec2 pen = position;
+  for (const auto &line : lines) {
+    textRenderer.renderText(font, line, pen);
+    pen.y += lineHeight;
+  }
+
+  auto drawBar = [&](double ms, const glm::vec4 &color) {
+    const float fraction =
+        std::min(1.0f, static_cast<float>(ms) / FRAME_BUDGET_MS);
+    renderer.drawQuad({pen.x, pen.y + 2.0f, 0.0f}, {barWidth, BAR_HEIGHT},
+                      {1.0f, 1.0f, 1.0f, 0.15f});
+    renderer.drawQuad({pen.x, pen.y + 2.0f, 0.0f},
+                      {barWidth * fraction, BAR_HEIGHT}, color);
+    pen.y += BAR_HEIGHT + 2.0f;
+  };
+  drawBar(report.cpuFrameMs, {0.3f, 0.8f, 0.3f, 1.0f});
+  drawBar(report.gpuFrameMs, {0.9f, 0.5f, 0.2f, 1.0f});
+}
+
+} // namespace ste
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+namespace ste {
+
+class Font;
+class Renderer2D;
+class TextRenderer;
+
+// Frame profiler for the rendering code. GPU time is measured with timestamp
+// queries around named scopes (render graph passes, renderer flushes), CPU
+// time with a steady clock. Queries are double buffered: the results of a
+// frame are read back two frames later, and skipped instead of waited on if
+// the GPU is still behind, so profiling never stalls the pipeline.
+class RenderProfiler {
+public:
+  static constexpr uint32_t FRAME_LATENCY = 2;
+  static constexpr uint32_t MAX_SCOPES_PER_FRAME = 128;
+
+  enum class CpuCounter { VertexGeneration, Upload, Stall, Count };
+
+  struct ScopeTiming {
+    std::string name;
+    double gpuMs = 0.0;
+    double cpuMs = 0.0;
+    uint32_t count = 0;
+  };
+
+  struct FrameReport {
+    uint64_t frame = 0;
+    double cpuFrameMs = 0.0;
+    double gpuFrameMs = 0.0;
+    std::array<double, static_cast<size_t>(CpuCounter::Count)> cpuCounterMs{};
+    uint32_t stallCount = 0;
+    uint32_t droppedScopes = 0;
+    std::vector<ScopeTiming> scopes;
+  };
+
+  // Times a named scope on both the CPU and the GPU
+  class Scope {
+  public:
+    explicit Scope(std::string_view name);
+    ~Scope();
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+  private:
+    bool m_active;
+  };
+
+  // Adds the elapsed CPU time to a counter when profiling is enabled
+  class CpuTimer {
+  public:
+    explicit CpuTimer(CpuCounter counter);
+    ~CpuTimer();
+    CpuTimer(const CpuTimer &) = delete;
+    CpuTimer &operator=(const CpuTimer &) = delete;
+
+  private:
+    CpuCounter m_counter;
+    bool m_active;
+    std::chrono::steady_clock::time_point m_start;
+  };
+
+  static RenderProfiler &get() {
+    static RenderProfiler instance;
+    return instance;
+  }
+
+  RenderProfiler(const RenderProfiler &) = delete;
+  RenderProfiler &operator=(const RenderProfiler &) = delete;
+
+  void setEnabled(bool enabled) { m_enabled = enabled; }
+  bool isEnabled() const { return m_enabled; }
+
+  // Bracket every frame, the report of an older frame is resolved here
+  void beginFrame();
+  void endFrame();
+
+  void beginScope(std::string_view name);
+  void endScope();
+
+  void addCpuTime(CpuCounter counter, std::chrono::nanoseconds elapsed);
+  void addStall();
+
+  // Latest frame with complete GPU results
+  const FrameReport &getLastReport() const { return m_lastReport; }
+
+  // Draws the last report into the current scene, which should use a
+  // screen space projection
+  void drawOverlay(Renderer2D &renderer, TextRenderer &textRenderer,
+                   Font &font, const glm::vec2 &position);
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  struct ScopeRecord {
+    std::string name;
+    uint32_t beginQuery = 0;
+    uint32_t endQuery = 0;
+    Clock::time_point cpuStart;
+    Clock::duration cpuElapsed{};
+  };
+
+  struct FrameData {
+    std::vector<uint32_t> queries;
+    uint32_t queryCount = 0;
+    std::vector<ScopeRecord> scopes;
+    std::vector<uint32_t> openScopes;
+    uint32_t frameBeginQuery = 0;
+    uint32_t frameEndQuery = 0;
+    Clock::time_point cpuStart;
+    Clock::duration cpuElapsed{};
+    std::array<Clock::duration, static_cast<size_t>(CpuCounter::Count)>
+        counters{};
+    uint32_t stallCount = 0;
+    uint32_t droppedScopes = 0;
+    uint64_t frame = 0;
+    bool pending = false;
+  };
+
+  RenderProfiler() = default;
+
+  bool allocateQuery(FrameData &frame, uint32_t &query);
+  void resolveFrame(FrameData &frame);
+
+  bool m_enabled = false;
+  bool m_inFrame = false;
+  uint64_t m_frameNumber = 0;
+  uint32_t m_frameIndex = 0;
+  FrameData m_frames[FRAME_LATENCY];
+  FrameReport m_lastReport;
+};
+
+} // namespace ste
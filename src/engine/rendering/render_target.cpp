@@ -0,0 +1,129 @@
+#include "render_target.h"
+
+#include "gl_state.h"
+
+namespace ste {
+
+std::optional<RenderTarget> RenderTarget::create(CreateInfo &createInfo) {
+  if (createInfo.width <= 0 || createInfo.height <= 0) {
+    createInfo.success = false;
+    createInfo.errorMsg = "Render target size must be positive";
+    return std::nullopt;
+  }
+
+  auto &state = GLStateCache::get();
+
+  // Color attachment
+  GLuint colorTexture;
+  glGenTextures(1, &colorTexture);
+  state.bindTexture(colorTexture);
+  glTexImage2D(GL_TEXTURE_2D, 0, createInfo.internalFormat, createInfo.width,
+               createInfo.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, createInfo.filter);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, createInfo.filter);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+  GLuint framebuffer;
+  glGenFramebuffers(1, &framebuffer);
+  state.bindFramebuffer(framebuffer);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                         colorTexture, 0);
+
+  // Depth is never sampled, a renderbuffer is enough
+  GLuint depthBuffer = 0;
+  if (createInfo.depth) {
+    glGenRenderbuffers(1, &depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24,
+                          createInfo.width, createInfo.height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                              GL_RENDERBUFFER, depthBuffer);
+  }
+
+  GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  if (status != GL_FRAMEBUFFER_COMPLETE) {
+    state.onFramebufferDeleted(framebuffer);
+    state.onTextureDeleted(colorTexture);
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteTextures(1, &colorTexture);
+    glDeleteRenderbuffers(1, &depthBuffer);
+    createInfo.success = false;
+    createInfo.errorMsg =
+        "Framebuffer incomplete, status: " + std::to_string(status);
+    return std::nullopt;
+  }
+
+  return RenderTarget(framebuffer, colorTexture, depthBuffer, createInfo.width,
+                      createInfo.height, createInfo.internalFormat,
+                      createInfo.filter);
+}
+
+RenderTarget::RenderTarget(uint32_t framebuffer, uint32_t colorTexture,
+                           uint32_t depthBuffer, int width, int height,
+                           GLenum internalFormat, GLenum filter)
+    : m_framebuffer(framebuffer), m_colorTexture(colorTexture),
+      m_depthBuffer(depthBuffer), m_width(width), m_height(height),
+      m_internalFormat(internalFormat), m_filter(filter) {}
+
+RenderTarget::~RenderTarget() { release(); }
+
+RenderTarget::RenderTarget(RenderTarget &&other) noexcept
+    : m_framebuffer(other.m_framebuffer),
+      m_colorTexture(other.m_colorTexture),
+      m_depthBuffer(other.m_depthBuffer), m_width(other.m_width),
+      m_height(other.m_height), m_internalFormat(other.m_internalFormat),
+      m_filter(other.m_filter) {
+  other.m_framebuffer = 0;
+  other.m_colorTexture = 0;
+  other.m_depthBuffer = 0;
+}
+
+RenderTarget &RenderTarget::operator=(RenderTarget &&other) noexcept {
+  if (this != &other) {
+    release();
+    m_framebuffer = other.m_framebuffer;
+    m_colorTexture = other.m_colorTexture;
+    m_depthBuffer = other.m_depthBuffer;
+    m_width = other.m_width;
+    m_height = other.m_height;
+    m_internalFormat = other.m_internalFormat;
+    m_filter = other.m_filter;
+    other.m_framebuffer = 0;
+    other.m_colorTexture = 0;
+    other.m_depthBuffer = 0;
+  }
+  return *this;
+}
+
+void RenderTarget::release() {
+  auto &state = GLStateCache::get();
+  if (m_framebuffer != 0) {
+    state.onFramebufferDeleted(m_framebuffer);
+    glDeleteFramebuffers(1, &m_framebuffer);
+    m_framebuffer = 0;
+  }
+  if (m_colorTexture != 0) {
+    state.onTextureDeleted(m_colorTexture);
+    glDeleteTextures(1, &m_colorTexture);
+    m_colorTexture = 0;
+  }
+  if (m_depthBuffer != 0) {
+    glDeleteRenderbuffers(1, &m_depthBuffer);
+    m_depthBuffer = 0;
+  }
+}
+
+void RenderTarget::bind() const {
+  auto &state = GLStateCache::get();
+  state.bindFramebuffer(m_framebuffer);
+  state.setViewport(0, 0, m_width, m_height);
+}
+
+void RenderTarget::bindDefault(int width, int height) {
+  auto &state = GLStateCache::get();
+  state.bindFramebuffer(state.getDefaultFramebuffer());
+  state.setViewport(0, 0, width, height);
+}
+
+} // namespace ste
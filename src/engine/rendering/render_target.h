@@ -0,0 +1,62 @@
+#pragma once
+
+#include <optional>
+#include <string>
+
+#include <glad/glad.h>
+
+namespace ste {
+
+// Offscreen framebuffer with a single color texture and an optional depth
+// renderbuffer
+class RenderTarget {
+public:
+  struct CreateInfo {
+    std::string errorMsg;
+    bool success = true;
+    int width = 0;
+    int height = 0;
+    GLenum internalFormat = GL_RGBA8;
+    GLenum filter = GL_LINEAR;
+    // 24 bit depth attachment, needed for Renderer2D's depth sorted passes
+    bool depth = false;
+  };
+
+  static std::optional<RenderTarget> create(CreateInfo &createInfo);
+
+  ~RenderTarget();
+  RenderTarget(const RenderTarget &) = delete;
+  RenderTarget &operator=(const RenderTarget &) = delete;
+  RenderTarget(RenderTarget &&other) noexcept;
+  RenderTarget &operator=(RenderTarget &&other) noexcept;
+
+  // Binds the framebuffer and sets the viewport to cover it
+  void bind() const;
+  // Binds the default framebuffer (or its headless stand-in) with the given
+  // viewport
+  static void bindDefault(int width, int height);
+
+  uint32_t getFramebuffer() const { return m_framebuffer; }
+  uint32_t getColorTexture() const { return m_colorTexture; }
+  bool hasDepth() const { return m_depthBuffer != 0; }
+  int getWidth() const { return m_width; }
+  int getHeight() const { return m_height; }
+  GLenum getInternalFormat() const { return m_internalFormat; }
+  GLenum getFilter() const { return m_filter; }
+
+private:
+  RenderTarget(uint32_t framebuffer, uint32_t colorTexture,
+               uint32_t depthBuffer, int width, int height,
+               GLenum internalFormat, GLenum filter);
+  void release();
+
+  uint32_t m_framebuffer{0};
+  uint32_t m_colorTexture{0};
+  uint32_t m_depthBuffer{0};
+  int m_width{0};
+  int m_height{0};
+  GLenum m_internalFormat{GL_RGBA8};
+  GLenum m_filter{GL_LINEAR};
+};
+
+} // namespace ste
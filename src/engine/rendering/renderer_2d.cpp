@@ -1,385 +1,287 @@
 #include "renderer_2d.h"
 
+#include <algorithm>
 #include <array>
+#include <cmath>
 #include <iostream>
+#include <limits>
 #include <vector>
 
-#include <glad/glad.h>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "gl_render_backend.h"
+#include "quad_kernels.h"
+#include "render_profiler.h"
+
 namespace ste {
 
+static_assert(sizeof(Renderer2D::Vertex) == 16 * sizeof(float),
+              "Vertex layout must match the quad kernels");
+
 namespace {
-const char *vertexShaderSource = R"(
-        #version 330 core
-        layout (location = 0) in vec3 a_Position;
-        layout (location = 1) in vec4 a_Color;
-        layout (location = 2) in vec2 a_TexCoord;
-        layout (location = 3) in float a_TexIndex;
-        layout (location = 4) in float a_TilingFactor;
-        layout (location = 5) in float a_OutlineThickness;
-        layout (location = 6) in vec4 a_OutlineColor;
-
-        uniform mat4 u_ViewProjection;
-
-        out vec4 v_Color;
-        out vec2 v_TexCoord;
-        out float v_TexIndex;
-        out float v_TilingFactor;
-        out float v_OutlineThickness;
-        out vec4 v_OutlineColor;
-
-        void main() {
-            v_Color = a_Color;
-            v_TexCoord = a_TexCoord;
-            v_TexIndex = a_TexIndex;
-            v_TilingFactor = a_TilingFactor;
-            v_OutlineThickness = a_OutlineThickness;
-            v_OutlineColor = a_OutlineColor;
-            gl_Position = u_ViewProjection * vec4(a_Position, 1.0);
-        }
-    )";
-
-const char *fragmentShaderSource = R"(
-        #version 330 core
-        out vec4 FragColor;
-
-        in vec4 v_Color;
-        in vec2 v_TexCoord;
-        in float v_TexIndex;
-        in float v_TilingFactor;
-        in float v_OutlineThickness;
-        in vec4 v_OutlineColor;
-        
-        uniform sampler2D u_Textures[16];
-
-        void main() {
-            vec4 texColor = v_Color;
-
-            // Sample texture if we have a valid texture index
-            int texIndex = int(v_TexIndex);
-            if (texIndex > 0) {
-                texColor *= texture(u_Textures[texIndex], v_TexCoord * v_TilingFactor);
-            }
-            
-            // Calculate pixel scale for each axis
-            vec2 dx = dFdx(v_TexCoord);
-            vec2 dy = dFdy(v_TexCoord);
-            vec2 texSize = vec2(length(vec2(dx.x, dy.x)), length(vec2(dx.y, dy.y))) * 2.0;
-            
-            // Calculate distance from edge in normalized UV space
-            vec2 uvDist = abs(v_TexCoord - 0.5) * 2.0;
-            
-            // Convert outline thickness to UV space separately for each axis
-            vec2 thickness = vec2(v_OutlineThickness) * texSize;
-            
-            // Check if we're in the outline region on either axis
-            vec2 inner = vec2(1.0) - thickness;
-            bool inOutline = uvDist.x > inner.x || uvDist.y > inner.y;
-            
-            FragColor = inOutline && v_OutlineThickness > 0.0 ? v_OutlineColor : texColor;
-        }
-    )";
+// Profiler scope per flush reason, so GPU time is split by cause
+const char *getFlushScopeName(FlushReason reason) {
+  switch (reason) {
+  case FlushReason::EndScene:
+    return "Flush (end scene)";
+  case FlushReason::BufferFull:
+    return "Flush (buffer full)";
+  case FlushReason::TextureSlotsFull:
+    return "Flush (texture slots full)";
+  case FlushReason::BlendChange:
+    return "Flush (blend change)";
+  case FlushReason::ClipChange:
+    return "Flush (clip change)";
+  default:
+    return "Flush";
+  }
+}
 } // namespace
 
 std::shared_ptr<Renderer2D> Renderer2D::create(CreateInfo &createInfo) {
-  // Create shader
-  Shader::CreateInfo shaderInfo;
-  auto shader = Shader::createFromMemory(vertexShaderSource,
-                                         fragmentShaderSource, shaderInfo);
-  if (!shader) {
-    createInfo.success = false;
-    createInfo.errorMsg = std::move(shaderInfo.errorMsg);
-    return nullptr;
-  }
-
-  // Enable alpha blending
-  glEnable(GL_BLEND);
-  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-  glDisable(GL_DEPTH_TEST);
-
-  // Create vertex array
-  uint32_t vao;
-  glGenVertexArrays(1, &vao);
-  glBindVertexArray(vao);
-
-  // Create vertex buffer
-  uint32_t vbo;
-  glGenBuffers(1, &vbo);
-  glBindBuffer(GL_ARRAY_BUFFER, vbo);
-  glBufferData(GL_ARRAY_BUFFER, MAX_VERTICES * sizeof(Vertex) * BUFFER_COUNT,
-               nullptr, GL_DYNAMIC_DRAW);
-
-  // Vertex attributes
-  glEnableVertexAttribArray(0);
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                        (const void *)offsetof(Vertex, position));
-
-  glEnableVertexAttribArray(1);
-  glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                        (const void *)offsetof(Vertex, color));
-
-  glEnableVertexAttribArray(2);
-  glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                        (const void *)offsetof(Vertex, texCoords));
-
-  glEnableVertexAttribArray(3);
-  glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                        (const void *)offsetof(Vertex, texIndex));
-
-  glEnableVertexAttribArray(4);
-  glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                        (const void *)offsetof(Vertex, tilingFactor));
-
-  glEnableVertexAttribArray(5);
-  glVertexAttribPointer(5, 1, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                        (const void *)offsetof(Vertex, outlineThickness));
-
-  glEnableVertexAttribArray(6);
-  glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                        (const void *)offsetof(Vertex, outlineColor));
-
-  // Create and set up index buffer
-  uint32_t ibo;
-  glGenBuffers(1, &ibo);
-
-  std::vector<uint32_t> indices(MAX_INDICES);
-  uint32_t offset = 0;
-  for (uint32_t i = 0; i < MAX_INDICES; i += 6) {
-    indices[i + 0] = offset + 0;
-    indices[i + 1] = offset + 1;
-    indices[i + 2] = offset + 2;
-    indices[i + 3] = offset + 2;
-    indices[i + 4] = offset + 3;
-    indices[i + 5] = offset + 0;
-    offset += 4;
-  }
-
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t),
-               indices.data(), GL_STATIC_DRAW);
-
-  // Allocate vertex buffer memory
-  auto *vertices = new Vertex[MAX_VERTICES];
-
-  return std::make_shared<Renderer2D>(std::move(*shader), vao, vbo, ibo,
-                                      vertices);
-}
-
-Renderer2D::Renderer2D(Shader &&shader, uint32_t vao, uint32_t vbo,
-                       uint32_t ibo, Vertex *vertices)
-    : m_shader(std::move(shader)), m_VAO(vao), m_VBO(vbo), m_IBO(ibo),
-      m_vertexBufferBase(vertices) {
-  m_vertexBufferPtr = m_vertexBufferBase;
-
-  uint8_t whitePixel[4] = {255, 255, 255, 255};
-  glGenTextures(1, &m_whiteTexture);
-  glBindTexture(GL_TEXTURE_2D, m_whiteTexture);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE,
-               whitePixel);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-}
-
-Renderer2D::~Renderer2D() {
-  // Clean up sync objects
-  for (uint32_t i = 0; i < BUFFER_COUNT; ++i) {
-    if (m_fences[i]) {
-      glDeleteSync(m_fences[i]);
+  auto backend = createInfo.backend;
+  if (!backend) {
+    GLRenderBackend::CreateInfo backendInfo;
+    backend = GLRenderBackend::create(backendInfo);
+    if (!backend) {
+      createInfo.success = false;
+      createInfo.errorMsg = std::move(backendInfo.errorMsg);
+      return nullptr;
     }
   }
 
-  glDeleteVertexArrays(1, &m_VAO);
-  glDeleteBuffers(1, &m_VBO);
-  glDeleteBuffers(1, &m_IBO);
-  delete[] m_vertexBufferBase;
+  return std::make_shared<Renderer2D>(std::move(backend));
 }
 
-Renderer2D::Renderer2D(Renderer2D &&other) noexcept
-    : m_shader(std::move(other.m_shader)), m_VAO(other.m_VAO),
-      m_VBO(other.m_VBO), m_IBO(other.m_IBO), m_indexCount(other.m_indexCount),
-      m_vertexBufferBase(other.m_vertexBufferBase),
-      m_vertexBufferPtr(other.m_vertexBufferPtr),
-      m_viewProjection(other.m_viewProjection), m_stats(other.m_stats) {
-  other.m_VAO = 0;
-  other.m_VBO = 0;
-  other.m_IBO = 0;
-  other.m_vertexBufferBase = nullptr;
-  other.m_vertexBufferPtr = nullptr;
+Renderer2D::Renderer2D(std::shared_ptr<RenderBackend> backend)
+    : m_backend(std::move(backend)),
+      m_vertexBufferBase(std::make_unique<Vertex[]>(MAX_VERTICES)) {
+  m_vertexBufferPtr = m_vertexBufferBase.get();
 }
 
-Renderer2D &Renderer2D::operator=(Renderer2D &&other) noexcept {
-  if (this != &other) {
-    glDeleteVertexArrays(1, &m_VAO);
-    glDeleteBuffers(1, &m_VBO);
-    glDeleteBuffers(1, &m_IBO);
-    delete[] m_vertexBufferBase;
+void Renderer2D::beginScene(const glm::mat4 &viewProjection) {
+  m_sceneCount++;
+
+  // Unproject the clip space corners to get the visible world rectangle
+  const glm::mat4 inverseViewProjection = glm::inverse(viewProjection);
+  glm::vec2 viewMin{std::numeric_limits<float>::max()};
+  glm::vec2 viewMax{std::numeric_limits<float>::lowest()};
+  for (float x : {-1.0f, 1.0f}) {
+    for (float y : {-1.0f, 1.0f}) {
+      for (float z : {-1.0f, 1.0f}) {
+        glm::vec4 corner = inverseViewProjection * glm::vec4(x, y, z, 1.0f);
+        glm::vec2 world = glm::vec2(corner.x, corner.y) / corner.w;
+        viewMin = glm::min(viewMin, world);
+        viewMax = glm::max(viewMax, world);
+      }
+    }
+  }
+  m_viewBounds = AABB(viewMin, viewMax);
+  m_sceneViewBounds = m_viewBounds;
+  m_viewProjection = viewProjection;
+  m_clipStack.clear();
+  m_clipRect.reset();
 
-    m_shader = std::move(other.m_shader);
-    m_VAO = other.m_VAO;
-    m_VBO = other.m_VBO;
-    m_IBO = other.m_IBO;
-    m_indexCount = other.m_indexCount;
-    m_vertexBufferBase = other.m_vertexBufferBase;
-    m_vertexBufferPtr = other.m_vertexBufferPtr;
-    m_viewProjection = other.m_viewProjection;
-    m_stats = other.m_stats;
+  m_backend->beginScene(viewProjection);
 
-    other.m_VAO = 0;
-    other.m_VBO = 0;
-    other.m_IBO = 0;
-    other.m_vertexBufferBase = nullptr;
-    other.m_vertexBufferPtr = nullptr;
-  }
-  return *this;
-}
+  m_depthMode =
+      m_depthSortingEnabled ? DepthMode::Transparent : DepthMode::None;
+  m_opaqueQuads.clear();
+  m_transparentVertices.clear();
+  m_transparentBatches.clear();
 
-void Renderer2D::beginScene(const glm::mat4 &viewProjection) {
-  m_viewProjection = viewProjection;
   startBatch();
   setBlendMode(BlendMode::Alpha);
 }
 
-void Renderer2D::endScene() { flush(); }
-
-void Renderer2D::waitForBuffer(uint32_t bufferIndex) {
-  if (m_fences[bufferIndex]) {
-    // Wait for the fence with a timeout
-    GLenum result;
-    do {
-      result =
-          glClientWaitSync(m_fences[bufferIndex], GL_SYNC_FLUSH_COMMANDS_BIT,
-                           MAX_SYNC_WAIT_NANOS);
-    } while (result == GL_TIMEOUT_EXPIRED);
-
-    glDeleteSync(m_fences[bufferIndex]);
-    m_fences[bufferIndex] = nullptr;
+void Renderer2D::endScene() {
+  flush(FlushReason::EndScene);
+  if (m_depthMode != DepthMode::None) {
+    drawOpaquePass();
+    submitTransparentPass();
   }
+  m_backend->endScene();
 }
 
 void Renderer2D::startBatch() {
   m_indexCount = 0;
-  m_vertexBufferPtr = m_vertexBufferBase;
+  m_vertexBufferPtr = m_vertexBufferBase.get();
   m_textureSlotIndex = 1; // Reset to 1 since 0 is reserved for white texture
+  m_batchFeatures = 0;
 
   // Reset texture slots
-  m_textureSlots[0] = m_whiteTexture; // Slot 0 is always the white texture
   for (uint32_t i = 1; i < MAX_TEXTURE_SLOTS; i++) {
     m_textureSlots[i] = 0;
   }
 }
 
-void Renderer2D::flush() {
+void Renderer2D::flush(FlushReason reason) {
   if (m_indexCount == 0)
     return;
 
-  // Wait for the current buffer to be available
-  waitForBuffer(m_currentBuffer);
-
-  uint32_t dataSize =
-      static_cast<uint32_t>(reinterpret_cast<uint8_t *>(m_vertexBufferPtr) -
-                            reinterpret_cast<uint8_t *>(m_vertexBufferBase));
-  uint32_t bufferOffset = m_currentBuffer * MAX_VERTICES * sizeof(Vertex);
-
-  // Update buffer data
-  glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
-  glBufferSubData(GL_ARRAY_BUFFER, bufferOffset, dataSize, m_vertexBufferBase);
-
-  // Update attribute pointers for current buffer
-  glVertexAttribPointer(
-      0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-      (const void *)(bufferOffset + offsetof(Vertex, position)));
-  glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                        (const void *)(bufferOffset + offsetof(Vertex, color)));
-  glVertexAttribPointer(
-      2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-      (const void *)(bufferOffset + offsetof(Vertex, texCoords)));
-  glVertexAttribPointer(
-      3, 1, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-      (const void *)(bufferOffset + offsetof(Vertex, texIndex)));
-  glVertexAttribPointer(
-      4, 1, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-      (const void *)(bufferOffset + offsetof(Vertex, tilingFactor)));
-  glVertexAttribPointer(
-      5, 1, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-      (const void *)(bufferOffset + offsetof(Vertex, outlineThickness)));
-  glVertexAttribPointer(
-      6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-      (const void *)(bufferOffset + offsetof(Vertex, outlineColor)));
-
-  // Always bind white texture to slot 0
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, m_whiteTexture);
-
-  // Bind additional textures
-  for (uint32_t i = 1; i < m_textureSlotIndex; i++) {
-    glActiveTexture(GL_TEXTURE0 + i);
-    glBindTexture(GL_TEXTURE_2D, m_textureSlots[i]);
+  m_stats.flushReasons[static_cast<size_t>(reason)]++;
+  m_stats.drawCalls++;
+
+  const auto vertexCount = static_cast<size_t>(
+      m_vertexBufferPtr - m_vertexBufferBase.get());
+  const RenderBatch batch{.vertices = {m_vertexBufferBase.get(), vertexCount},
+                          .indexCount = m_indexCount,
+                          .textures = {m_textureSlots, m_textureSlotIndex},
+                          .blendMode = m_currentBlendMode,
+                          .reason = reason,
+                          .shaderFeatures = m_batchFeatures,
+                          .depthMode = m_depthMode,
+                          .clipRect = m_clipRect};
+
+  // Transparent batches of a depth sorted scene wait for the opaque pass
+  if (m_depthMode == DepthMode::Transparent) {
+    deferBatch(batch);
+    return;
   }
 
-  // Draw
-  m_shader.use();
-  m_shader.setUniform("u_ViewProjection", m_viewProjection);
+  RenderProfiler::Scope scope(getFlushScopeName(reason));
+  m_backend->submit(batch);
+}
+
+void Renderer2D::deferBatch(const RenderBatch &batch) {
+  DeferredBatch &deferred = m_transparentBatches.emplace_back();
+  deferred.batch = batch;
+  deferred.firstVertex = m_transparentVertices.size();
+  std::ranges::copy(batch.textures, deferred.textures.begin());
+  m_transparentVertices.insert(m_transparentVertices.end(),
+                               batch.vertices.begin(), batch.vertices.end());
+}
 
-  int samplers[MAX_TEXTURE_SLOTS];
-  for (int i = 0; i < MAX_TEXTURE_SLOTS; i++) {
-    samplers[i] = i;
+void Renderer2D::drawOpaquePass() {
+  if (m_opaqueQuads.empty()) {
+    return;
   }
-  m_shader.setUniformArray("u_Textures", samplers);
 
-  glBindVertexArray(m_VAO);
-  glDrawElements(GL_TRIANGLES, m_indexCount, GL_UNSIGNED_INT, nullptr);
+  RenderProfiler::Scope scope("Opaque pass");
 
-  // Place fence for this buffer
-  m_fences[m_currentBuffer] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  // Front to back so hidden pixels fail the depth test. The first quad
+  // drawn wins at equal depth, reversing before the stable sort keeps the
+  // painter's order there.
+  std::ranges::reverse(m_opaqueQuads);
+  std::ranges::stable_sort(m_opaqueQuads, std::greater{},
+                           [](const QuadDesc &quad) { return quad.position.z; });
 
-  // Move to next buffer
-  m_currentBuffer = (m_currentBuffer + 1) % BUFFER_COUNT;
+  // Culled on submission already, blending is pointless for opaque quads
+  const BlendMode blendMode = m_currentBlendMode;
+  const bool cullingEnabled = m_cullingEnabled;
+  startBatch();
+  m_depthMode = DepthMode::Opaque;
+  m_currentBlendMode = BlendMode::None;
+  m_cullingEnabled = false;
 
-  m_stats.drawCalls++;
+  drawQuads(m_opaqueQuads);
+  flush(FlushReason::EndScene);
+
+  m_depthMode = DepthMode::Transparent;
+  m_currentBlendMode = blendMode;
+  m_cullingEnabled = cullingEnabled;
+  m_opaqueQuads.clear();
+  startBatch();
 }
 
-void Renderer2D::drawQuad(const glm::vec3 &position, const glm::vec2 &size,
-                          const glm::vec4 &color, float rotation,
-                          const glm::vec2 &origin, float outlineThickness,
-                          const glm::vec4 &outlineColor) {
-  if (m_indexCount >= MAX_INDICES) {
-    flush();
-    startBatch();
+void Renderer2D::submitTransparentPass() {
+  if (m_transparentBatches.empty()) {
+    return;
   }
 
-  const float s = rotation != 0.0f ? std::sin(rotation) : 0.0f;
-  const float c = rotation != 0.0f ? std::cos(rotation) : 1.0f;
-
-  // Calculate the offset based on origin
-  glm::vec2 offset = -origin * size;
+  RenderProfiler::Scope scope("Transparent pass");
+  for (DeferredBatch &deferred : m_transparentBatches) {
+    RenderBatch &batch = deferred.batch;
+    batch.vertices = {m_transparentVertices.data() + deferred.firstVertex,
+                      batch.vertices.size()};
+    batch.textures = {deferred.textures.data(), batch.textures.size()};
+    m_backend->submit(batch);
+  }
 
-  for (int i = 0; i < 4; i++) {
-    // Calculate vertex positions relative to origin point
-    float x = (i == 1 || i == 2) ? size.x : 0.0f;
-    float y = (i == 2 || i == 3) ? size.y : 0.0f;
+  m_transparentVertices.clear();
+  m_transparentBatches.clear();
+}
 
-    // Adjust by offset to account for origin
-    x += offset.x;
-    y += offset.y;
+bool Renderer2D::findTextureSlot(uint32_t textureId, float &textureIndex) {
+  textureIndex = 0.0f;
+  if (textureId == 0) {
+    return true;
+  }
 
-    // Apply rotation
-    if (rotation != 0.0f) {
-      float origX = x;
-      float origY = y;
-      x = origX * c - origY * s;
-      y = origX * s + origY * c;
+  for (uint32_t i = 1; i < m_textureSlotIndex; i++) {
+    if (m_textureSlots[i] == textureId) {
+      textureIndex = static_cast<float>(i);
+      m_batchFeatures |= shader_features::Textured;
+      return true;
     }
+  }
+
+  // No free slot left, the caller has to flush first
+  if (m_textureSlotIndex >= MAX_TEXTURE_SLOTS) {
+    return false;
+  }
+
+  textureIndex = static_cast<float>(m_textureSlotIndex);
+  m_textureSlots[m_textureSlotIndex] = textureId;
+  m_textureSlotIndex++;
+  m_batchFeatures |= shader_features::Textured;
+  return true;
+}
+
+bool Renderer2D::isOpaque(const QuadDesc &quad) const {
+  // The opaque pass isn't clipped
+  return m_clipStack.empty() && quad.color.w >= 1.0f &&
+         (m_currentBlendMode == BlendMode::Alpha ||
+          m_currentBlendMode == BlendMode::None) &&
+         (quad.textureId == 0 || m_opaqueTextures.contains(quad.textureId));
+}
+
+void Renderer2D::setTextureOpaque(uint32_t textureId, bool opaque) {
+  if (opaque) {
+    m_opaqueTextures.insert(textureId);
+  } else {
+    m_opaqueTextures.erase(textureId);
+  }
+}
+
+void Renderer2D::submitQuad(const QuadDesc &quad, float outlineThickness,
+                            const glm::vec4 &outlineColor) {
+  if (m_cullingEnabled &&
+      !quad_kernels::isVisibleScalar(quad, m_viewBounds)) {
+    m_stats.culledQuads++;
+    return;
+  }
+
+  // Outlines are left to the transparent pass, the opaque pass goes
+  // through the SIMD kernels which don't write them
+  if (m_depthMode == DepthMode::Transparent && outlineThickness <= 0.0f &&
+      isOpaque(quad)) {
+    m_opaqueQuads.push_back(quad);
+    m_stats.opaqueQuads++;
+    return;
+  }
+
+  if (m_indexCount >= MAX_INDICES) {
+    flush(FlushReason::BufferFull);
+    startBatch();
+  }
+
+  float textureIndex;
+  if (!findTextureSlot(quad.textureId, textureIndex)) {
+    flush(FlushReason::TextureSlotsFull);
+    startBatch();
+    findTextureSlot(quad.textureId, textureIndex);
+  }
 
-    m_vertexBufferPtr->position = {position.x + x, position.y + y, position.z};
-    m_vertexBufferPtr->color = color;
-    m_vertexBufferPtr->texCoords = {(i == 1 || i == 2) ? 1.0f : 0.0f,
-                                    (i == 2 || i == 3) ? 1.0f : 0.0f};
-    m_vertexBufferPtr->texIndex = 0.0f;
-    m_vertexBufferPtr->tilingFactor = 1.0f;
-    m_vertexBufferPtr->outlineThickness = outlineThickness;
-    m_vertexBufferPtr->outlineColor = outlineColor;
-    m_vertexBufferPtr++;
+  {
+    RenderProfiler::CpuTimer timer(
+        RenderProfiler::CpuCounter::VertexGeneration);
+    quad_kernels::generateScalar(quad, textureIndex, outlineThickness,
+                                 outlineColor, m_vertexBufferPtr);
+  }
+  m_vertexBufferPtr += 4;
+  if (outlineThickness > 0.0f) {
+    m_batchFeatures |= shader_features::Outlined;
   }
 
   m_indexCount += 6;
@@ -388,70 +290,395 @@ void Renderer2D::drawQuad(const glm::vec3 &position, const glm::vec2 &size,
   m_stats.indexCount += 6;
 }
 
+void Renderer2D::drawQuad(const glm::vec3 &position, const glm::vec2 &size,
+                          const glm::vec4 &color, float rotation,
+                          const glm::vec2 &origin, float outlineThickness,
+                          const glm::vec4 &outlineColor) {
+  submitQuad({.position = position,
+              .size = size,
+              .color = color,
+              .origin = origin,
+              .rotation = rotation},
+             outlineThickness, outlineColor);
+}
+
 void Renderer2D::drawTexturedQuad(const glm::vec3 &position,
                                   const TextureInfo &texture,
                                   const glm::vec2 &size, const glm::vec4 &tint,
                                   float rotation, const glm::vec2 &origin,
                                   const glm::vec4 &texCoords) {
-  if (m_indexCount >= MAX_INDICES || m_textureSlotIndex >= MAX_TEXTURE_SLOTS) {
-    flush();
-    startBatch();
+  submitQuad({.position = position,
+              .size = size,
+              .color = tint,
+              .origin = origin,
+              .texCoords = texCoords,
+              .rotation = rotation,
+              .textureId = texture.id},
+             0.0f, {0.0f, 0.0f, 0.0f, 0.0f});
+}
+
+void Renderer2D::drawQuads(std::span<const QuadDesc> quads,
+                           const std::optional<AABB> &bounds) {
+  // Only batches crossing the edge of the view are culled quad by quad
+  bool cullQuads = m_cullingEnabled;
+  if (cullQuads && bounds) {
+    if (!m_viewBounds.intersects(*bounds)) {
+      m_stats.culledQuads += static_cast<uint32_t>(quads.size());
+      return;
+    }
+    cullQuads = !(m_viewBounds.contains(bounds->min) &&
+                  m_viewBounds.contains(bounds->max));
   }
 
-  // Find or assign texture slot
-  float textureIndex = 0.0f;
-  for (uint32_t i = 1; i < m_textureSlotIndex; i++) {
-    if (m_textureSlots[i] == texture.id) {
-      textureIndex = static_cast<float>(i);
-      break;
+  std::array<uint8_t, QUAD_RUN_SIZE> visible;
+  for (size_t first = 0; first < quads.size(); first += QUAD_RUN_SIZE) {
+    const size_t count = std::min<size_t>(QUAD_RUN_SIZE, quads.size() - first);
+    std::span<const QuadDesc> chunk = quads.subspan(first, count);
+    if (cullQuads) {
+      const uint32_t visibleCount =
+          quad_kernels::cull(chunk, m_viewBounds, visible.data());
+      m_stats.culledQuads += static_cast<uint32_t>(chunk.size()) -
+                             visibleCount;
+      if (visibleCount == 0) {
+        continue;
+      }
+
+      // The kernels need contiguous input, the visible quads are packed
+      if (visibleCount < chunk.size()) {
+        uint32_t packed = 0;
+        for (size_t i = 0; i < chunk.size(); i++) {
+          if (visible[i]) {
+            m_visibleQuads[packed++] = chunk[i];
+          }
+        }
+        chunk = std::span<const QuadDesc>(m_visibleQuads.data(), packed);
+      }
     }
+
+    submitQuads(chunk);
   }
+}
 
-  if (textureIndex == 0.0f && texture.id != m_whiteTexture) {
-    textureIndex = static_cast<float>(m_textureSlotIndex);
-    m_textureSlots[m_textureSlotIndex] = texture.id;
-    m_textureSlotIndex++;
+void Renderer2D::submitQuads(std::span<const QuadDesc> quads) {
+  std::array<float, QUAD_RUN_SIZE> texIndices;
+  size_t runStart = 0;
+  uint32_t runCount = 0;
+
+  // Hands the pending run of quads to the SIMD kernels
+  auto emitRun = [&]() {
+    if (runCount == 0)
+      return;
+
+    {
+      RenderProfiler::CpuTimer timer(
+          RenderProfiler::CpuCounter::VertexGeneration);
+      quad_kernels::generate(quads.subspan(runStart, runCount),
+                             texIndices.data(), m_vertexBufferPtr);
+    }
+    m_vertexBufferPtr += runCount * 4;
+
+    m_indexCount += runCount * 6;
+    m_stats.quadCount += runCount;
+    m_stats.vertexCount += runCount * 4;
+    m_stats.indexCount += runCount * 6;
+
+    runStart += runCount;
+    runCount = 0;
+  };
+
+  for (size_t i = 0; i < quads.size(); i++) {
+    // Opaque quads of a depth sorted scene are drawn later, front to back
+    if (m_depthMode == DepthMode::Transparent && isOpaque(quads[i])) {
+      emitRun();
+      runStart = i + 1;
+      m_opaqueQuads.push_back(quads[i]);
+      m_stats.opaqueQuads++;
+      continue;
+    }
+
+    // Texture slots are resolved per quad, a full batch or slot table splits
+    // the run and flushes before continuing
+    float textureIndex;
+    const bool hasRoom = m_indexCount + runCount * 6 < MAX_INDICES;
+    if (!hasRoom || !findTextureSlot(quads[i].textureId, textureIndex)) {
+      emitRun();
+      flush(hasRoom ? FlushReason::TextureSlotsFull : FlushReason::BufferFull);
+      startBatch();
+      findTextureSlot(quads[i].textureId, textureIndex);
+    }
+
+    texIndices[runCount++] = textureIndex;
+    if (runCount == QUAD_RUN_SIZE) {
+      emitRun();
+    }
   }
 
-  const float s = rotation != 0.0f ? std::sin(rotation) : 0.0f;
-  const float c = rotation != 0.0f ? std::cos(rotation) : 1.0f;
+  emitRun();
+}
 
-  // Calculate the offset based on origin
-  glm::vec2 offset = -origin * size;
+void Renderer2D::drawQuadRun(std::span<const Vertex> vertices,
+                             std::span<const uint32_t> textures,
+                             const AABB &bounds, const glm::vec2 &offset,
+                             const glm::vec4 &color) {
+  const size_t quadCount = vertices.size() / 4;
+  if (quadCount == 0) {
+    return;
+  }
 
-  for (int i = 0; i < 4; i++) {
-    // Calculate vertex positions relative to origin point
-    float x = (i == 1 || i == 2) ? size.x : 0.0f;
-    float y = (i == 2 || i == 3) ? size.y : 0.0f;
+  const AABB runBounds(bounds.min + offset, bounds.max + offset);
+  if (m_cullingEnabled && !m_viewBounds.intersects(runBounds)) {
+    m_stats.culledQuads += static_cast<uint32_t>(quadCount);
+    return;
+  }
+  // Only runs crossing the edge of the view are culled quad by quad
+  const bool cullQuads = m_cullingEnabled &&
+                         !(m_viewBounds.contains(runBounds.min) &&
+                           m_viewBounds.contains(runBounds.max));
+
+  size_t quad = 0;
+  while (quad < quadCount) {
+    if (m_indexCount >= MAX_INDICES) {
+      flush(FlushReason::BufferFull);
+      startBatch();
+    }
 
-    // Adjust by offset to account for origin
-    x += offset.x;
-    y += offset.y;
+    // As much of the run as the batch still holds, the slot is resolved
+    // again whenever the texture changes
+    const size_t end = quad + std::min<size_t>(quadCount - quad,
+                                               (MAX_INDICES - m_indexCount) / 6);
+    uint32_t written = 0;
+    bool slotsFull = false;
+    {
+      RenderProfiler::CpuTimer timer(
+          RenderProfiler::CpuCounter::VertexGeneration);
+      uint32_t slotTexture = 0;
+      float textureIndex = 0.0f;
+      bool resolved = false;
+      for (; quad < end; quad++) {
+        const Vertex *source = &vertices[quad * 4];
+        if (cullQuads) {
+          glm::vec2 min = {source[0].position.x, source[0].position.y};
+          glm::vec2 max = min;
+          for (int i = 1; i < 4; i++) {
+            const glm::vec2 corner = {source[i].position.x,
+                                      source[i].position.y};
+            min = glm::min(min, corner);
+            max = glm::max(max, corner);
+          }
+          if (!m_viewBounds.intersects(AABB(min + offset, max + offset))) {
+            m_stats.culledQuads++;
+            continue;
+          }
+        }
+
+        const uint32_t texture =
+            textures[static_cast<size_t>(source[0].texIndex)];
+        if (!resolved || texture != slotTexture) {
+          if (!findTextureSlot(texture, textureIndex)) {
+            slotsFull = true;
+            break;
+          }
+          slotTexture = texture;
+          resolved = true;
+        }
+        if (source[0].outlineThickness < 0.0f) {
+          m_batchFeatures |= shader_features::SdfText;
+        }
+
+        for (int i = 0; i < 4; i++) {
+          Vertex &vertex = m_vertexBufferPtr[i];
+          vertex = source[i];
+          vertex.position.x += offset.x;
+          vertex.position.y += offset.y;
+          vertex.color = color;
+          vertex.texIndex = textureIndex;
+        }
+        m_vertexBufferPtr += 4;
+        written++;
+      }
+    }
+
+    m_indexCount += written * 6;
+    m_stats.quadCount += written;
+    m_stats.vertexCount += written * 4;
+    m_stats.indexCount += written * 6;
 
-    // Apply rotation
-    if (rotation != 0.0f) {
-      float origX = x;
-      float origY = y;
-      x = origX * c - origY * s;
-      y = origX * s + origY * c;
+    if (slotsFull) {
+      flush(FlushReason::TextureSlotsFull);
+      startBatch();
     }
+  }
+}
 
-    m_vertexBufferPtr->position = {position.x + x, position.y + y, position.z};
-    m_vertexBufferPtr->color = tint;
-    m_vertexBufferPtr->texCoords = {
-        (i == 1 || i == 2) ? texCoords.z : texCoords.x,
-        (i == 2 || i == 3) ? texCoords.w : texCoords.y};
-    m_vertexBufferPtr->texIndex = textureIndex;
-    m_vertexBufferPtr->tilingFactor = 1.0f;
-    m_vertexBufferPtr->outlineThickness = 0.0f;
-    m_vertexBufferPtr->outlineColor = {0.0f, 0.0f, 0.0f, 0.0f};
-    m_vertexBufferPtr++;
+Renderer2D::Vertex *Renderer2D::reserveQuad() {
+  if (m_indexCount >= MAX_INDICES) {
+    flush(FlushReason::BufferFull);
+    startBatch();
   }
 
+  Vertex *vertices = m_vertexBufferPtr;
+  m_vertexBufferPtr += 4;
+
   m_indexCount += 6;
   m_stats.quadCount++;
   m_stats.vertexCount += 4;
   m_stats.indexCount += 6;
+  return vertices;
+}
+
+Renderer2D::Vertex *Renderer2D::reserveShape(const glm::vec2 &min,
+                                             const glm::vec2 &max) {
+  if (m_cullingEnabled && !m_viewBounds.intersects(AABB(min, max))) {
+    m_stats.culledQuads++;
+    return nullptr;
+  }
+  return reserveQuad();
+}
+
+namespace {
+// Untextured shape vertex, texture slot 0 is the white texture
+void setShapeVertex(Renderer2D::Vertex &vertex, const glm::vec2 &position,
+                    const glm::vec4 &color,
+                    const glm::vec2 &texCoords = {0.0f, 0.0f},
+                    float shape = 1.0f, float innerRadius = 0.0f,
+                    const glm::vec4 &arc = {0.0f, 0.0f, 0.0f, 0.0f}) {
+  vertex.position = {position.x, position.y, 0.0f};
+  vertex.color = color;
+  vertex.texCoords = texCoords;
+  vertex.texIndex = 0.0f;
+  vertex.tilingFactor = shape;
+  vertex.outlineThickness = innerRadius;
+  vertex.outlineColor = arc;
+}
+
+constexpr float TWO_PI = 6.28318530718f;
+// Sweep used for full circles, anything above 2 pi skips the angle test
+constexpr float FULL_SWEEP = 8.0f;
+constexpr float CIRCLE_SHAPE = -1.0f;
+} // namespace
+
+void Renderer2D::drawLine(const glm::vec2 &from, const glm::vec2 &to,
+                          const glm::vec4 &color, float thickness) {
+  const glm::vec2 direction = to - from;
+  const float length = glm::length(direction);
+  if (length <= 0.0f || thickness <= 0.0f) {
+    return;
+  }
+
+  // Offset to either side of the center line, no trig involved
+  const glm::vec2 normal =
+      glm::vec2(-direction.y, direction.x) * (thickness * 0.5f / length);
+  const glm::vec2 halfExtent = glm::abs(normal);
+  Vertex *vertices = reserveShape(glm::min(from, to) - halfExtent,
+                                  glm::max(from, to) + halfExtent);
+  if (!vertices) {
+    return;
+  }
+
+  setShapeVertex(vertices[0], from - normal, color);
+  setShapeVertex(vertices[1], to - normal, color);
+  setShapeVertex(vertices[2], to + normal, color);
+  setShapeVertex(vertices[3], from + normal, color);
+}
+
+void Renderer2D::drawRect(const glm::vec2 &position, const glm::vec2 &size,
+                          const glm::vec4 &color, float thickness) {
+  thickness = std::min({thickness, size.x * 0.5f, size.y * 0.5f});
+  if (thickness <= 0.0f) {
+    return;
+  }
+
+  // Four non-overlapping bars so translucent borders blend evenly
+  const glm::vec2 max = position + size;
+  const float innerTop = position.y + thickness;
+  const float innerBottom = max.y - thickness;
+  const QuadDesc bars[4] = {
+      {.position = {position.x, position.y, 0.0f},
+       .size = {size.x, thickness},
+       .color = color},
+      {.position = {position.x, innerBottom, 0.0f},
+       .size = {size.x, thickness},
+       .color = color},
+      {.position = {position.x, innerTop, 0.0f},
+       .size = {thickness, innerBottom - innerTop},
+       .color = color},
+      {.position = {max.x - thickness, innerTop, 0.0f},
+       .size = {thickness, innerBottom - innerTop},
+       .color = color}};
+  for (const auto &bar : bars) {
+    submitQuad(bar, 0.0f, {0.0f, 0.0f, 0.0f, 0.0f});
+  }
+}
+
+void Renderer2D::drawCircle(const glm::vec2 &center, float radius,
+                            const glm::vec4 &color, float thickness) {
+  drawArc(center, radius, 0.0f, FULL_SWEEP, color, thickness);
+}
+
+void Renderer2D::drawArc(const glm::vec2 &center, float radius,
+                         float startAngle, float endAngle,
+                         const glm::vec4 &color, float thickness) {
+  if (radius <= 0.0f) {
+    return;
+  }
+
+  Vertex *vertices = reserveShape(center - radius, center + radius);
+  if (!vertices) {
+    return;
+  }
+  m_batchFeatures |= shader_features::Shapes;
+
+  // The fragment shader measures the angle from the start, normalize it
+  float sweep = endAngle - startAngle;
+  if (sweep < TWO_PI) {
+    startAngle = std::fmod(startAngle, TWO_PI);
+    if (startAngle < 0.0f) {
+      startAngle += TWO_PI;
+    }
+    sweep = std::max(sweep, 0.0f);
+  }
+
+  const float innerRadius =
+      thickness > 0.0f ? std::max(1.0f - thickness / radius, 0.0f) : 0.0f;
+  const glm::vec4 arc = {startAngle, sweep, 0.0f, 0.0f};
+  setShapeVertex(vertices[0], center + glm::vec2(-radius, -radius), color,
+                 {-1.0f, -1.0f}, CIRCLE_SHAPE, innerRadius, arc);
+  setShapeVertex(vertices[1], center + glm::vec2(radius, -radius), color,
+                 {1.0f, -1.0f}, CIRCLE_SHAPE, innerRadius, arc);
+  setShapeVertex(vertices[2], center + glm::vec2(radius, radius), color,
+                 {1.0f, 1.0f}, CIRCLE_SHAPE, innerRadius, arc);
+  setShapeVertex(vertices[3], center + glm::vec2(-radius, radius), color,
+                 {-1.0f, 1.0f}, CIRCLE_SHAPE, innerRadius, arc);
+}
+
+void Renderer2D::drawConvexPolygon(std::span<const glm::vec2> points,
+                                   const glm::vec4 &color) {
+  if (points.size() < 3) {
+    return;
+  }
+
+  glm::vec2 min = points[0];
+  glm::vec2 max = points[0];
+  for (const auto &point : points) {
+    min = glm::min(min, point);
+    max = glm::max(max, point);
+  }
+  if (m_cullingEnabled && !m_viewBounds.intersects(AABB(min, max))) {
+    m_stats.culledQuads++;
+    return;
+  }
+
+  // A quad (a, b, c, d) is drawn as the triangles abc and cda, so fan
+  // triangles pair up as (p0, pi, pi+1, pi+2). An odd leftover gets a
+  // degenerate second triangle.
+  for (size_t i = 1; i + 1 < points.size(); i += 2) {
+    Vertex *vertices = reserveQuad();
+    setShapeVertex(vertices[0], points[0], color);
+    setShapeVertex(vertices[1], points[i], color);
+    setShapeVertex(vertices[2], points[i + 1], color);
+    setShapeVertex(vertices[3],
+                   i + 2 < points.size() ? points[i + 2] : points[0], color);
+  }
 }
 
 // Implement the vec2 position overloads
@@ -476,49 +703,64 @@ void Renderer2D::resetStats() { m_stats = Statistics(); }
 
 Renderer2D::Statistics Renderer2D::getStats() const { return m_stats; }
 
-void Renderer2D::setBlendMode(BlendMode mode) {
-  if (m_currentBlendMode != mode) {
-    m_currentBlendMode = mode;
-    applyBlendMode(mode);
+void Renderer2D::pushClipRect(const glm::vec2 &position,
+                              const glm::vec2 &size) {
+  AABB clip(glm::min(position, position + size),
+            glm::max(position, position + size));
+  if (!m_clipStack.empty()) {
+    const AABB &parent = m_clipStack.back();
+    clip.min = glm::max(clip.min, parent.min);
+    clip.max = glm::max(glm::min(clip.max, parent.max), clip.min);
   }
+  m_clipStack.push_back(clip);
+  applyClipRect();
 }
 
-void Renderer2D::applyBlendMode(BlendMode mode) {
-  switch (mode) {
-  case BlendMode::None:
-    glDisable(GL_BLEND);
-    break;
+void Renderer2D::popClipRect() {
+  if (!m_clipStack.empty()) {
+    m_clipStack.pop_back();
+    applyClipRect();
+  }
+}
 
-  case BlendMode::Alpha:
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glBlendEquation(GL_FUNC_ADD);
-    break;
+void Renderer2D::applyClipRect() {
+  // Quads already batched were clipped by the previous rectangle
+  if (m_indexCount > 0) {
+    flush(FlushReason::ClipChange);
+    startBatch();
+  }
 
-  case BlendMode::Additive:
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE);
-    glBlendEquation(GL_FUNC_ADD);
-    break;
+  if (m_clipStack.empty()) {
+    m_viewBounds = m_sceneViewBounds;
+    m_clipRect.reset();
+    return;
+  }
 
-  case BlendMode::Multiply:
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_DST_COLOR, GL_ZERO);
-    glBlendEquation(GL_FUNC_ADD);
-    break;
+  const AABB &clip = m_clipStack.back();
+  m_viewBounds.min = glm::max(m_sceneViewBounds.min, clip.min);
+  m_viewBounds.max = glm::min(m_sceneViewBounds.max, clip.max);
+
+  // The camera has no rotation, so the corners span the rectangle in NDC
+  const glm::vec4 a = m_viewProjection * glm::vec4(clip.min, 0.0f, 1.0f);
+  const glm::vec4 b = m_viewProjection * glm::vec4(clip.max, 0.0f, 1.0f);
+  const glm::vec2 ndcA = glm::vec2(a.x, a.y) / a.w;
+  const glm::vec2 ndcB = glm::vec2(b.x, b.y) / b.w;
+  const glm::vec2 ndcMin = glm::min(ndcA, ndcB);
+  const glm::vec2 ndcMax = glm::max(ndcA, ndcB);
+  m_clipRect = glm::vec4(ndcMin.x, ndcMin.y, ndcMax.x, ndcMax.y);
+}
 
-  case BlendMode::Screen:
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_COLOR);
-    glBlendEquation(GL_FUNC_ADD);
-    break;
+void Renderer2D::setBlendMode(BlendMode mode) {
+  if (m_currentBlendMode != mode) {
+    // Quads already batched were submitted with the previous mode
+    if (m_indexCount > 0) {
+      flush(FlushReason::BlendChange);
+      startBatch();
+    }
 
-  case BlendMode::Subtract:
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE);
-    glBlendEquation(GL_FUNC_REVERSE_SUBTRACT);
-    break;
+    // Applied by the backend with the next batch
+    m_currentBlendMode = mode;
   }
 }
 
-} // namespace ste
\ No newline at end of file
+} // namespace ste
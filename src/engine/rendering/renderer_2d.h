@@ -1,33 +1,49 @@
 #pragma once
 
+#include <array>
 #include <memory>
 #include <optional>
 #include <span>
+#include <string>
 #include <string_view>
+#include <unordered_set>
+#include <vector>
 
 #include <glm/glm.hpp>
 
-#include "shader.h"
+#include "engine/world/quadtree.h"
+#include "render_backend.h"
 
 namespace ste {
 
-enum class BlendMode { None, Alpha, Additive, Multiply, Screen, Subtract };
-
+// Batching front-end: culls quads, generates their vertices and groups them
+// into batches by texture slots and blend mode, which a RenderBackend then
+// draws
 class Renderer2D {
 public:
   struct CreateInfo {
     std::string errorMsg;
     bool success = true;
+    // OpenGL when empty
+    std::shared_ptr<RenderBackend> backend;
   };
 
-  struct Vertex {
-    glm::vec3 position;
-    glm::vec4 color;
-    glm::vec2 texCoords;
-    float texIndex;
-    float tilingFactor;
-    float outlineThickness;
-    glm::vec4 outlineColor;
+  // Shapes reuse the quad vertex: a negative tilingFactor marks an SDF
+  // circle, texCoords then hold the local position in [-1, 1],
+  // outlineThickness the inner radius and outlineColor.xy the arc's start
+  // angle and sweep. A negative outlineThickness on a textured quad marks a
+  // glyph sampled from a signed distance field.
+  using Vertex = QuadVertex;
+
+  // Quad description for batched submission through drawQuads
+  struct QuadDesc {
+    glm::vec3 position{0.0f};
+    glm::vec2 size{1.0f, 1.0f};
+    glm::vec4 color{1.0f, 1.0f, 1.0f, 1.0f};
+    glm::vec2 origin{0.0f, 0.0f};
+    glm::vec4 texCoords{0.0f, 0.0f, 1.0f, 1.0f};
+    float rotation = 0.0f;
+    uint32_t textureId = 0; // 0 draws an untextured quad
   };
 
   struct TextureInfo {
@@ -42,21 +58,28 @@ public:
     uint32_t quadCount = 0;
     uint32_t vertexCount = 0;
     uint32_t indexCount = 0;
+    uint32_t culledQuads = 0;
+    uint32_t opaqueQuads = 0; // drawn in the depth sorted opaque pass
+    std::array<uint32_t, static_cast<size_t>(FlushReason::Count)>
+        flushReasons{};
   };
 
   static std::shared_ptr<Renderer2D> create(CreateInfo &createInfo);
 
-  explicit Renderer2D(Shader &&shader, uint32_t vao, uint32_t vbo, uint32_t ibo,
-                      Vertex *vertices);
-  ~Renderer2D();
+  explicit Renderer2D(std::shared_ptr<RenderBackend> backend);
   Renderer2D(const Renderer2D &) = delete;
   Renderer2D &operator=(const Renderer2D &) = delete;
-  Renderer2D(Renderer2D &&other) noexcept;
-  Renderer2D &operator=(Renderer2D &&other) noexcept;
+  Renderer2D(Renderer2D &&other) noexcept = default;
+  Renderer2D &operator=(Renderer2D &&other) noexcept = default;
+
+  RenderBackend &getBackend() const { return *m_backend; }
 
   // Begin/End rendering
   void beginScene(const glm::mat4 &viewProjection);
   void endScene();
+  // Number of scenes begun so far, everything batched in earlier scenes
+  // has been handed to the backend
+  uint64_t getSceneCount() const { return m_sceneCount; }
 
   // Primitive rendering methods
   void drawQuad(const glm::vec3 &position, const glm::vec2 &size = {1.0f, 1.0f},
@@ -85,48 +108,143 @@ public:
                         const glm::vec2 &origin = {0.0f, 0.0f},
                         const glm::vec4 &texCoords = {0.0f, 0.0f, 1.0f, 1.0f});
 
+  // Batched submission, culls and transforms several quads at once with
+  // SIMD kernels. `bounds`, when known, encloses all quads and culls or
+  // accepts them at once like drawQuadRun.
+  void drawQuads(std::span<const QuadDesc> quads,
+                 const std::optional<AABB> &bounds = std::nullopt);
+
+  // Quads built ahead of time, e.g. the glyphs of a Text, 4 vertices each
+  // as the quad kernels write them. The texIndex of a quad's vertices
+  // indexes `textures`. They are copied into the batch moved by `offset`,
+  // with `color` and the texture slot filled in. `bounds` encloses the
+  // vertices and culls the whole run at once.
+  void drawQuadRun(std::span<const Vertex> vertices,
+                   std::span<const uint32_t> textures, const AABB &bounds,
+                   const glm::vec2 &offset = {0.0f, 0.0f},
+                   const glm::vec4 &color = {1.0f, 1.0f, 1.0f, 1.0f});
+
+  // Shapes, batched together with quads and sprites in the same draw call.
+  // Angles are in radians, from +x towards +y.
+  void drawLine(const glm::vec2 &from, const glm::vec2 &to,
+                const glm::vec4 &color = {1.0f, 1.0f, 1.0f, 1.0f},
+                float thickness = 1.0f);
+  // Rectangle outline, the border grows inwards from position/size
+  void drawRect(const glm::vec2 &position, const glm::vec2 &size,
+                const glm::vec4 &color = {1.0f, 1.0f, 1.0f, 1.0f},
+                float thickness = 1.0f);
+  // Filled disk when thickness is 0, otherwise a ring growing inwards
+  void drawCircle(const glm::vec2 &center, float radius,
+                  const glm::vec4 &color = {1.0f, 1.0f, 1.0f, 1.0f},
+                  float thickness = 0.0f);
+  void drawArc(const glm::vec2 &center, float radius, float startAngle,
+               float endAngle,
+               const glm::vec4 &color = {1.0f, 1.0f, 1.0f, 1.0f},
+               float thickness = 0.0f);
+  // Points in order (either winding), triangulated as a fan
+  void drawConvexPolygon(std::span<const glm::vec2> points,
+                         const glm::vec4 &color = {1.0f, 1.0f, 1.0f, 1.0f});
+
   // Statistics for debugging/profiling
   void resetStats();
   Statistics getStats() const;
 
+  // View culling, quads outside the view of the current scene are skipped
+  // before any vertices are generated
+  void setCullingEnabled(bool enabled) { m_cullingEnabled = enabled; }
+  bool isCullingEnabled() const { return m_cullingEnabled; }
+  const AABB &getViewBounds() const { return m_viewBounds; }
+
+  // Clip rectangles in world units of the current scene, the camera must
+  // not be rotated. Nested rectangles are intersected, quads outside are
+  // culled and the rest is cut by the scissor test. Every push and pop
+  // starts a new batch, the stack is reset by beginScene.
+  void pushClipRect(const glm::vec2 &position, const glm::vec2 &size);
+  void popClipRect();
+
   // Blending
   void setBlendMode(BlendMode mode);
   BlendMode getBlendMode() const { return m_currentBlendMode; }
 
+  // Depth sorted passes, applied from the next beginScene. Fully opaque
+  // quads (alpha 1 with Alpha or None blending, no outline, untextured or
+  // with an opaque texture) are held back and drawn front to back with
+  // depth test and write, hidden pixels are then rejected before shading.
+  // Everything else follows in submission order, depth tested against
+  // them. Higher position.z is in front and has to stay within the
+  // camera's [-1, 1] depth range. Needs a depth buffer to draw into.
+  void setDepthSortingEnabled(bool enabled) { m_depthSortingEnabled = enabled; }
+  bool isDepthSortingEnabled() const { return m_depthSortingEnabled; }
+  // Textures without transparent texels, only their quads can be opaque
+  void setTextureOpaque(uint32_t textureId, bool opaque = true);
+
 private:
-  static constexpr uint32_t MAX_QUADS = 10000;
-  static constexpr uint32_t MAX_VERTICES = MAX_QUADS * 4;
-  static constexpr uint32_t MAX_INDICES = MAX_QUADS * 6;
-  static constexpr uint32_t MAX_TEXTURE_SLOTS = 16;
-  static constexpr uint32_t BUFFER_COUNT = 3;
-  static constexpr uint64_t MAX_SYNC_WAIT_NANOS = 1000000000;
-
-  Shader m_shader;
-  uint32_t m_VAO{0};
-  uint32_t m_VBO{0};
-  uint32_t m_IBO{0};
+  static constexpr uint32_t MAX_INDICES = RenderBackend::MAX_INDICES;
+  static constexpr uint32_t MAX_VERTICES = RenderBackend::MAX_VERTICES;
+  static constexpr uint32_t MAX_TEXTURE_SLOTS =
+      RenderBackend::MAX_TEXTURE_SLOTS;
+  static constexpr uint32_t QUAD_RUN_SIZE = 64;
+
+  // Transparent batch of a depth sorted scene, held until the opaque pass
+  // is drawn. The spans are pointed at the copies on submission.
+  struct DeferredBatch {
+    RenderBatch batch;
+    size_t firstVertex = 0;
+    std::array<uint32_t, MAX_TEXTURE_SLOTS> textures{};
+  };
+
+  std::shared_ptr<RenderBackend> m_backend;
 
   uint32_t m_indexCount{0};
-  Vertex *m_vertexBufferBase{nullptr};
+  std::unique_ptr<Vertex[]> m_vertexBufferBase;
   Vertex *m_vertexBufferPtr{nullptr};
 
-  glm::mat4 m_viewProjection{1.0f};
   Statistics m_stats{};
 
-  uint32_t m_currentBuffer{0};
-  GLsync m_fences[BUFFER_COUNT]{nullptr};
-  uint32_t m_lastTextureId{0};
+  AABB m_viewBounds; // intersected with the clip rectangle
+  AABB m_sceneViewBounds;
+  glm::mat4 m_viewProjection{1.0f};
+  bool m_cullingEnabled = true;
+  uint64_t m_sceneCount = 0;
+
+  // Intersected world space rectangles, the top one is active
+  std::vector<AABB> m_clipStack;
+  std::optional<glm::vec4> m_clipRect; // NDC, of the batch being built
 
-  void flush();
+  void flush(FlushReason reason);
   void startBatch();
-  void waitForBuffer(uint32_t bufferIndex);
+  // Whether the quad joins the opaque pass of a depth sorted scene
+  bool isOpaque(const QuadDesc &quad) const;
+  void deferBatch(const RenderBatch &batch);
+  void applyClipRect();
+  void drawOpaquePass();
+  void submitTransparentPass();
+  bool findTextureSlot(uint32_t textureId, float &textureIndex);
+  void submitQuad(const QuadDesc &quad, float outlineThickness,
+                  const glm::vec4 &outlineColor);
+  // Visible quads of at most QUAD_RUN_SIZE, handed to the kernels in runs
+  void submitQuads(std::span<const QuadDesc> quads);
+  // Shapes write their own 4 vertices, nullptr when culled
+  Vertex *reserveShape(const glm::vec2 &min, const glm::vec2 &max);
+  Vertex *reserveQuad();
 
   BlendMode m_currentBlendMode = BlendMode::Alpha;
-  void applyBlendMode(BlendMode mode);
-
-  uint32_t m_textureSlots[MAX_TEXTURE_SLOTS];
+  // shader_features used by the current batch
+  uint32_t m_batchFeatures = 0;
+
+  bool m_depthSortingEnabled = false;
+  // Of the batch being built, Transparent batches are deferred
+  DepthMode m_depthMode = DepthMode::None;
+  std::unordered_set<uint32_t> m_opaqueTextures;
+  std::vector<QuadDesc> m_opaqueQuads;
+  // Partially culled chunks of drawQuads() are compacted here
+  std::array<QuadDesc, QUAD_RUN_SIZE> m_visibleQuads;
+  std::vector<Vertex> m_transparentVertices;
+  std::vector<DeferredBatch> m_transparentBatches;
+
+  // Slot 0 is reserved for the backend's white texture
+  uint32_t m_textureSlots[MAX_TEXTURE_SLOTS]{};
   uint32_t m_textureSlotIndex = 1;
-  uint32_t m_whiteTexture;
 };
 
 } // namespace ste
\ No newline at end of file
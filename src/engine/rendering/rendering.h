@@ -1,8 +1,22 @@
 #pragma once
 
 #include "camera_2d.h"
+#include "dynamic_resolution.h"
 #include "fonts.h"
+#include "gl_render_backend.h"
+#include "gl_state.h"
+#include "headless_context.h"
+#include "indirect_draw.h"
+#include "lighting.h"
+#include "particles.h"
+#include "program_cache.h"
+#include "recording_render_backend.h"
+#include "render_backend.h"
+#include "render_graph.h"
+#include "render_profiler.h"
+#include "render_target.h"
 #include "renderer_2d.h"
 #include "shader.h"
 #include "texture.h"
+#include "tilemap_renderer.h"
 #include "window.h"
\ No newline at end of file
@@ -1,8 +1,12 @@
 #include "shader.h"
 
+#include <cstring>
 #include <fstream>
 #include <sstream>
 
+#include "gl_state.h"
+#include "program_cache.h"
+
 namespace ste {
 
 std::optional<Shader>
@@ -25,64 +29,205 @@ Shader::createFromFilesystem(std::string_view vertexPath,
 std::optional<Shader> Shader::createFromMemory(std::string vertexSource,
                                                std::string fragmentSource,
                                                CreateInfo &createInfo) {
+  PendingProgram pending = startCompile(vertexSource, fragmentSource);
+  if (!finishCompile(pending, createInfo)) {
+    return std::nullopt;
+  }
 
-  const char *vShaderCode = vertexSource.c_str();
-  const char *fShaderCode = fragmentSource.c_str();
+  return Shader(pending.program);
+}
 
-  // Compile shaders
-  GLuint vertex;
-  if (!compileShader(GL_VERTEX_SHADER, vShaderCode, "VERTEX", createInfo,
-                     vertex)) {
+std::optional<Shader>
+Shader::createFromFilesystemAsync(std::string_view vertexPath,
+                                  std::string_view fragmentPath,
+                                  CreateInfo &createInfo) {
+  auto vertexCode = readShaderFile(vertexPath, createInfo);
+  if (!vertexCode) {
     return std::nullopt;
   }
 
-  GLuint fragment;
-  if (!compileShader(GL_FRAGMENT_SHADER, fShaderCode, "FRAGMENT", createInfo,
-                     fragment)) {
-    glDeleteShader(vertex);
+  auto fragmentCode = readShaderFile(fragmentPath, createInfo);
+  if (!fragmentCode) {
     return std::nullopt;
   }
 
-  // Create and link program
-  GLuint programId = glCreateProgram();
-  glAttachShader(programId, vertex);
-  glAttachShader(programId, fragment);
-  glLinkProgram(programId);
+  return createFromMemoryAsync(*vertexCode, *fragmentCode, createInfo);
+}
 
-  if (!checkLinkErrors(programId, createInfo)) {
-    glDeleteShader(vertex);
-    glDeleteShader(fragment);
-    glDeleteProgram(programId);
+std::optional<Shader> Shader::createFromMemoryAsync(std::string vertexSource,
+                                                    std::string fragmentSource,
+                                                    CreateInfo &createInfo) {
+  PendingProgram pending = startCompile(vertexSource, fragmentSource);
+  if (pending.program == 0) {
+    glDeleteShader(pending.vertex);
+    glDeleteShader(pending.fragment);
+    createInfo.error = Error::LinkingFailed;
+    createInfo.errorMsg = "Failed to create shader program";
     return std::nullopt;
   }
 
-  // Delete shaders as they're linked into our program
-  glDeleteShader(vertex);
-  glDeleteShader(fragment);
+  return Shader(pending);
+}
 
-  return Shader(programId);
+bool Shader::isParallelCompileSupported() {
+  return GLAD_GL_KHR_parallel_shader_compile ||
+         GLAD_GL_ARB_parallel_shader_compile;
 }
 
 Shader::Shader(GLuint id) : m_id(id) {}
 
-Shader::~Shader() {
+Shader::Shader(const PendingProgram &pending)
+    : m_pending(pending), m_status(Status::Pending) {}
+
+Shader::~Shader() { release(); }
+
+void Shader::release() {
   if (m_id != 0) {
+    GLStateCache::get().onProgramDeleted(m_id);
     glDeleteProgram(m_id);
+    m_id = 0;
+  }
+
+  if (m_pending.program != 0) {
+    glDeleteShader(m_pending.vertex);
+    glDeleteShader(m_pending.fragment);
+    glDeleteProgram(m_pending.program);
+    m_pending = PendingProgram();
   }
 }
 
-Shader::Shader(Shader &&other) noexcept : m_id(other.m_id) { other.m_id = 0; }
+Shader::Shader(Shader &&other) noexcept
+    : m_uniforms(std::move(other.m_uniforms)),
+      m_uniformBlocks(std::move(other.m_uniformBlocks)), m_id(other.m_id),
+      m_pending(other.m_pending), m_status(other.m_status),
+      m_errorMsg(std::move(other.m_errorMsg)) {
+  other.m_id = 0;
+  other.m_pending = PendingProgram();
+  other.m_uniforms.clear();
+  other.m_uniformBlocks.clear();
+}
 
 Shader &Shader::operator=(Shader &&other) noexcept {
   if (this != &other) {
-    glDeleteProgram(m_id);
+    release();
     m_id = other.m_id;
+    m_uniforms = std::move(other.m_uniforms);
+    m_uniformBlocks = std::move(other.m_uniformBlocks);
+    m_pending = other.m_pending;
+    m_status = other.m_status;
+    m_errorMsg = std::move(other.m_errorMsg);
     other.m_id = 0;
+    other.m_pending = PendingProgram();
+    other.m_uniforms.clear();
+    other.m_uniformBlocks.clear();
   }
   return *this;
 }
 
-void Shader::use() const { glUseProgram(m_id); }
+Shader::Status Shader::poll() {
+  if (m_pending.program != 0 && isComplete(m_pending)) {
+    finishPending();
+  }
+  return m_status;
+}
+
+void Shader::reload(std::string vertexSource, std::string fragmentSource) {
+  // A newer edit supersedes a reload still in flight
+  if (m_pending.program != 0) {
+    glDeleteShader(m_pending.vertex);
+    glDeleteShader(m_pending.fragment);
+    glDeleteProgram(m_pending.program);
+  }
+
+  m_pending = startCompile(vertexSource, fragmentSource);
+  if (m_id == 0) {
+    m_status = Status::Pending;
+  }
+}
+
+bool Shader::reloadFromFilesystem(std::string_view vertexPath,
+                                  std::string_view fragmentPath,
+                                  CreateInfo &createInfo) {
+  auto vertexCode = readShaderFile(vertexPath, createInfo);
+  if (!vertexCode) {
+    return false;
+  }
+
+  auto fragmentCode = readShaderFile(fragmentPath, createInfo);
+  if (!fragmentCode) {
+    return false;
+  }
+
+  reload(*vertexCode, *fragmentCode);
+  return true;
+}
+
+void Shader::finishPending() const {
+  CreateInfo createInfo;
+  if (!finishCompile(m_pending, createInfo)) {
+    // A failed reload keeps the previous program running
+    m_errorMsg = std::move(createInfo.errorMsg);
+    m_status = m_id != 0 ? Status::Ready : Status::Failed;
+    m_pending = PendingProgram();
+    return;
+  }
+
+  // Swap the new program in
+  if (m_id != 0) {
+    GLStateCache::get().onProgramDeleted(m_id);
+    glDeleteProgram(m_id);
+  }
+  m_id = m_pending.program;
+  m_pending = PendingProgram();
+  m_errorMsg.clear();
+  m_status = Status::Ready;
+  restoreUniforms();
+}
+
+void Shader::restoreUniforms() const {
+  if (m_uniforms.empty() && m_uniformBlocks.empty()) {
+    return;
+  }
+
+  GLStateCache::get().useProgram(m_id);
+  for (auto &[name, uniform] : m_uniforms) {
+    uniform.location = glGetUniformLocation(m_id, name.c_str());
+    if (uniform.location != -1 && uniform.count > 0) {
+      applyUniform(uniform);
+    }
+  }
+  for (const auto &[name, bindingPoint] : m_uniformBlocks) {
+    const GLuint blockIndex = glGetUniformBlockIndex(m_id, name.c_str());
+    if (blockIndex != GL_INVALID_INDEX) {
+      glUniformBlockBinding(m_id, blockIndex, bindingPoint);
+    }
+  }
+}
+
+void Shader::use() const {
+  if (m_id == 0 && m_pending.program != 0) {
+    finishPending();
+  }
+  GLStateCache::get().useProgram(m_id);
+}
+
+bool Shader::bindUniformBlock(std::string_view name,
+                              uint32_t bindingPoint) const {
+  std::string nameStr(name);
+  if (isFirstCompilePending()) {
+    // Bound by restoreUniforms() once the program links
+    m_uniformBlocks[std::move(nameStr)] = bindingPoint;
+    return true;
+  }
+
+  GLuint blockIndex = glGetUniformBlockIndex(m_id, nameStr.c_str());
+  if (blockIndex == GL_INVALID_INDEX)
+    return false;
+
+  glUniformBlockBinding(m_id, blockIndex, bindingPoint);
+  m_uniformBlocks[std::move(nameStr)] = bindingPoint;
+  return true;
+}
 
 std::optional<std::string> Shader::readShaderFile(std::string_view filePath,
                                                   CreateInfo &createInfo) {
@@ -107,12 +252,90 @@ std::optional<std::string> Shader::readShaderFile(std::string_view filePath,
   }
 }
 
-bool Shader::compileShader(GLenum type, const char *source, const char *typeStr,
-                           CreateInfo &createInfo, GLuint &shaderId) {
-  shaderId = glCreateShader(type);
-  glShaderSource(shaderId, 1, &source, nullptr);
-  glCompileShader(shaderId);
+Shader::PendingProgram
+Shader::startCompile(const std::string &vertexSource,
+                     const std::string &fragmentSource) {
+  // Let the driver pick the number of compiler threads, once
+  static const bool threadsConfigured = [] {
+    if (GLAD_GL_KHR_parallel_shader_compile) {
+      glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+    } else if (GLAD_GL_ARB_parallel_shader_compile) {
+      glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+    }
+    return true;
+  }();
+  (void)threadsConfigured;
+
+  // Skip the compiler entirely when the program was linked before
+  auto &cache = ProgramCache::get();
+  PendingProgram pending;
+  const uint64_t cacheKey = cache.makeKey(vertexSource, fragmentSource);
+  if (GLuint program = cache.load(cacheKey)) {
+    pending.program = program;
+    return pending;
+  }
+
+  // Issue everything without querying any status, a query would wait for
+  // the compiler
+  pending.cacheKey = cacheKey;
+  const char *vertexCode = vertexSource.c_str();
+  pending.vertex = glCreateShader(GL_VERTEX_SHADER);
+  glShaderSource(pending.vertex, 1, &vertexCode, nullptr);
+  glCompileShader(pending.vertex);
+
+  const char *fragmentCode = fragmentSource.c_str();
+  pending.fragment = glCreateShader(GL_FRAGMENT_SHADER);
+  glShaderSource(pending.fragment, 1, &fragmentCode, nullptr);
+  glCompileShader(pending.fragment);
+
+  pending.program = glCreateProgram();
+  if (cacheKey != 0) {
+    glProgramParameteri(pending.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+                        GL_TRUE);
+  }
+  glAttachShader(pending.program, pending.vertex);
+  glAttachShader(pending.program, pending.fragment);
+  glLinkProgram(pending.program);
+  return pending;
+}
 
+bool Shader::isComplete(const PendingProgram &pending) {
+  if (!isParallelCompileSupported()) {
+    return true;
+  }
+
+  // GL_COMPLETION_STATUS_KHR, the ARB extension shares the value
+  GLint complete = GL_FALSE;
+  glGetProgramiv(pending.program, GL_COMPLETION_STATUS_KHR, &complete);
+  return complete == GL_TRUE;
+}
+
+bool Shader::finishCompile(PendingProgram &pending, CreateInfo &createInfo) {
+  // Cached binaries were checked when they were loaded
+  if (pending.vertex == 0) {
+    return true;
+  }
+
+  const bool compiled =
+      checkCompileErrors(pending.vertex, "VERTEX", createInfo) &&
+      checkCompileErrors(pending.fragment, "FRAGMENT", createInfo);
+  const bool linked = compiled && checkLinkErrors(pending.program, createInfo);
+
+  // Delete shaders as they're linked into our program
+  glDeleteShader(pending.vertex);
+  glDeleteShader(pending.fragment);
+  if (!linked) {
+    glDeleteProgram(pending.program);
+    pending.program = 0;
+    return false;
+  }
+
+  ProgramCache::get().store(pending.cacheKey, pending.program);
+  return true;
+}
+
+bool Shader::checkCompileErrors(GLuint shaderId, const char *typeStr,
+                                CreateInfo &createInfo) {
   GLint success;
   glGetShaderiv(shaderId, GL_COMPILE_STATUS, &success);
   if (!success) {
@@ -123,7 +346,6 @@ bool Shader::compileShader(GLenum type, const char *source, const char *typeStr,
     createInfo.errorMsg += typeStr;
     createInfo.errorMsg += ": ";
     createInfo.errorMsg += infoLog;
-    glDeleteShader(shaderId);
     return false;
   }
   return true;
@@ -143,16 +365,71 @@ bool Shader::checkLinkErrors(GLuint programId, CreateInfo &createInfo) {
   return true;
 }
 
-GLint Shader::getUniformLocation(std::string_view name) const {
+Shader::Uniform &Shader::getUniform(std::string_view name) const {
   std::string nameStr(name);
-  auto it = m_uniformLocationCache.find(nameStr);
-  if (it != m_uniformLocationCache.end()) {
+  auto it = m_uniforms.find(nameStr);
+  if (it != m_uniforms.end()) {
     return it->second;
   }
 
-  GLint location = glGetUniformLocation(m_id, nameStr.c_str());
-  m_uniformLocationCache[nameStr] = location;
-  return location;
+  // Without a program the location is looked up by restoreUniforms()
+  Uniform uniform;
+  if (!isFirstCompilePending()) {
+    uniform.location = glGetUniformLocation(m_id, nameStr.c_str());
+  }
+  return m_uniforms.emplace(std::move(nameStr), std::move(uniform))
+      .first->second;
+}
+
+bool Shader::setUniformValue(std::string_view name, UniformType type,
+                             const void *data, GLsizei count) const {
+  Uniform &uniform = getUniform(name);
+  const bool pending = isFirstCompilePending();
+  if (uniform.location == -1 && !pending)
+    return false;
+
+  // 32 bit words per element
+  static constexpr size_t WORDS[] = {1, 1, 2, 3, 4, 4, 9, 16};
+  uniform.type = type;
+  uniform.count = count;
+  uniform.value.resize(WORDS[static_cast<size_t>(type)] * count);
+  std::memcpy(uniform.value.data(), data,
+              uniform.value.size() * sizeof(uint32_t));
+  if (!pending) {
+    applyUniform(uniform);
+  }
+  return true;
+}
+
+void Shader::applyUniform(const Uniform &uniform) {
+  const auto *ints = reinterpret_cast<const GLint *>(uniform.value.data());
+  const auto *floats = reinterpret_cast<const float *>(uniform.value.data());
+  switch (uniform.type) {
+  case UniformType::Int:
+    glUniform1iv(uniform.location, uniform.count, ints);
+    break;
+  case UniformType::Float:
+    glUniform1fv(uniform.location, uniform.count, floats);
+    break;
+  case UniformType::Vec2:
+    glUniform2fv(uniform.location, uniform.count, floats);
+    break;
+  case UniformType::Vec3:
+    glUniform3fv(uniform.location, uniform.count, floats);
+    break;
+  case UniformType::Vec4:
+    glUniform4fv(uniform.location, uniform.count, floats);
+    break;
+  case UniformType::Mat2:
+    glUniformMatrix2fv(uniform.location, uniform.count, GL_FALSE, floats);
+    break;
+  case UniformType::Mat3:
+    glUniformMatrix3fv(uniform.location, uniform.count, GL_FALSE, floats);
+    break;
+  case UniformType::Mat4:
+    glUniformMatrix4fv(uniform.location, uniform.count, GL_FALSE, floats);
+    break;
+  }
 }
 
 } // namespace ste
\ No newline at end of file
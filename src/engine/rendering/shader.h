@@ -1,10 +1,12 @@
 #pragma once
 
+#include <cstdint>
 #include <optional>
 #include <span>
 #include <string>
 #include <string_view>
 #include <unordered_map>
+#include <vector>
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
@@ -21,6 +23,8 @@ public:
     LinkingFailed
   };
 
+  enum class Status { Pending, Ready, Failed };
+
   struct CreateInfo {
     std::string errorMsg;
     Error error = Error::None;
@@ -34,6 +38,23 @@ public:
                                                 std::string fragmentSource,
                                                 CreateInfo &createInfo);
 
+  // Start compiling and return right away, the shader is Pending until
+  // poll() sees the driver finish. Only file errors and a failure to create
+  // the program are reported here, compile and link errors surface through
+  // poll(), getStatus() and getErrorMsg().
+  static std::optional<Shader>
+  createFromFilesystemAsync(std::string_view vertexPath,
+                            std::string_view fragmentPath,
+                            CreateInfo &createInfo);
+  static std::optional<Shader> createFromMemoryAsync(std::string vertexSource,
+                                                     std::string fragmentSource,
+                                                     CreateInfo &createInfo);
+
+  // Whether the driver compiles in the background
+  // (GL_KHR_parallel_shader_compile). Without it async compiles still work
+  // but poll() blocks once on the first call.
+  static bool isParallelCompileSupported();
+
   ~Shader();
 
   // Delete copy constructor and assignment operator
@@ -44,89 +65,151 @@ public:
   Shader(Shader &&other) noexcept;
   Shader &operator=(Shader &&other) noexcept;
 
+  // Finishes a pending compile or reload once the driver is done with it
+  Status poll();
+  Status getStatus() const { return m_status; }
+  bool isReady() const { return m_status == Status::Ready; }
+  const std::string &getErrorMsg() const { return m_errorMsg; }
+
+  // Compiles new sources in the background, the current program stays in
+  // use until they link and is kept if they don't. Uniform values and block
+  // bindings set on the old program carry over to the new one.
+  void reload(std::string vertexSource, std::string fragmentSource);
+  bool reloadFromFilesystem(std::string_view vertexPath,
+                            std::string_view fragmentPath,
+                            CreateInfo &createInfo);
+  bool isReloading() const { return m_pending.program != 0; }
+
+  // Using a shader whose first compile is still pending waits for it
   void use() const;
+  uint32_t getId() const { return m_id; }
 
-  // Uniform setters with template specialization for common types
+  // Attaches a uniform block of this program to a UBO binding point. While
+  // the first compile is pending the binding is recorded and applied once
+  // the program links.
+  bool bindUniformBlock(std::string_view name, uint32_t bindingPoint) const;
+
+  // Uniform setters with template specialization for common types. The
+  // values are kept and restored when a reload swaps the program, values set
+  // while the first compile is pending are applied once it links.
   template <typename T>
   bool setUniform(std::string_view name, const T &value) const {
-    const GLint location = getUniformLocation(name);
-    if (location == -1)
-      return false;
-
     if constexpr (std::is_same_v<T, bool>) {
-      glUniform1i(location, static_cast<int>(value));
+      const int intValue = static_cast<int>(value);
+      return setUniformValue(name, UniformType::Int, &intValue, 1);
     } else if constexpr (std::is_same_v<T, int>) {
-      glUniform1i(location, value);
+      return setUniformValue(name, UniformType::Int, &value, 1);
     } else if constexpr (std::is_same_v<T, float>) {
-      glUniform1f(location, value);
+      return setUniformValue(name, UniformType::Float, &value, 1);
     } else if constexpr (std::is_same_v<T, glm::vec2>) {
-      glUniform2fv(location, 1, &value[0]);
+      return setUniformValue(name, UniformType::Vec2, &value[0], 1);
     } else if constexpr (std::is_same_v<T, glm::vec3>) {
-      glUniform3fv(location, 1, &value[0]);
+      return setUniformValue(name, UniformType::Vec3, &value[0], 1);
     } else if constexpr (std::is_same_v<T, glm::vec4>) {
-      glUniform4fv(location, 1, &value[0]);
+      return setUniformValue(name, UniformType::Vec4, &value[0], 1);
     } else if constexpr (std::is_same_v<T, glm::mat2>) {
-      glUniformMatrix2fv(location, 1, GL_FALSE, &value[0][0]);
+      return setUniformValue(name, UniformType::Mat2, &value[0][0], 1);
     } else if constexpr (std::is_same_v<T, glm::mat3>) {
-      glUniformMatrix3fv(location, 1, GL_FALSE, &value[0][0]);
+      return setUniformValue(name, UniformType::Mat3, &value[0][0], 1);
     } else if constexpr (std::is_same_v<T, glm::mat4>) {
-      glUniformMatrix4fv(location, 1, GL_FALSE, &value[0][0]);
+      return setUniformValue(name, UniformType::Mat4, &value[0][0], 1);
     } else {
       static_assert(!sizeof(T), "Unsupported uniform type");
       return false;
     }
-    return true;
   }
 
   // Array uniform setter
   template <typename T>
   bool setUniformArray(std::string_view name, std::span<const T> values) const {
-    const GLint location = getUniformLocation(name);
-    if (location == -1)
-      return false;
-
+    const auto count = static_cast<GLsizei>(values.size());
     if constexpr (std::is_same_v<T, int>) {
-      glUniform1iv(location, values.size(), values.data());
+      return setUniformValue(name, UniformType::Int, values.data(), count);
     } else if constexpr (std::is_same_v<T, float>) {
-      glUniform1fv(location, values.size(), values.data());
+      return setUniformValue(name, UniformType::Float, values.data(), count);
     } else if constexpr (std::is_same_v<T, glm::vec2>) {
-      glUniform2fv(location, values.size(),
-                   reinterpret_cast<const float *>(values.data()));
+      return setUniformValue(name, UniformType::Vec2, values.data(), count);
     } else if constexpr (std::is_same_v<T, glm::vec3>) {
-      glUniform3fv(location, values.size(),
-                   reinterpret_cast<const float *>(values.data()));
+      return setUniformValue(name, UniformType::Vec3, values.data(), count);
     } else if constexpr (std::is_same_v<T, glm::vec4>) {
-      glUniform4fv(location, values.size(),
-                   reinterpret_cast<const float *>(values.data()));
+      return setUniformValue(name, UniformType::Vec4, values.data(), count);
     } else {
       static_assert(!sizeof(T), "Unsupported uniform array type");
       return false;
     }
-    return true;
   }
 
   template <size_t N>
   bool setUniformArray(std::string_view name, const int (&values)[N]) const {
-    const GLint location = getUniformLocation(name);
-    if (location == -1)
-      return false;
-    glUniform1iv(location, N, values);
-    return true;
+    return setUniformValue(name, UniformType::Int, values, N);
   }
 
 private:
-  GLuint m_id{0};
-  mutable std::unordered_map<std::string, GLint> m_uniformLocationCache;
+  enum class UniformType : uint8_t {
+    Int,
+    Float,
+    Vec2,
+    Vec3,
+    Vec4,
+    Mat2,
+    Mat3,
+    Mat4
+  };
+
+  // Location of a uniform and the last value set through it, as raw 32 bit
+  // int or float words
+  struct Uniform {
+    GLint location = -1;
+    UniformType type = UniformType::Int;
+    GLsizei count = 0; // zero until a value is set
+    std::vector<uint32_t> value;
+  };
+
+  // A program whose compile and link were issued but not checked yet.
+  // Programs from the ProgramCache come without stages.
+  struct PendingProgram {
+    GLuint program = 0;
+    GLuint vertex = 0;
+    GLuint fragment = 0;
+    uint64_t cacheKey = 0; // stored to the cache once linked
+  };
+
+  mutable std::unordered_map<std::string, Uniform> m_uniforms;
+  mutable std::unordered_map<std::string, uint32_t> m_uniformBlocks;
+
+  // Mutable so use() can finish a pending first compile
+  mutable GLuint m_id{0};
+  mutable PendingProgram m_pending;
+  mutable Status m_status{Status::Ready};
+  mutable std::string m_errorMsg;
 
   explicit Shader(GLuint id);
+  explicit Shader(const PendingProgram &pending);
 
   static std::optional<std::string> readShaderFile(std::string_view filePath,
                                                    CreateInfo &createInfo);
-  static bool compileShader(GLenum type, const char *source,
-                            const char *typeStr, CreateInfo &createInfo,
-                            GLuint &shaderId);
+  static PendingProgram startCompile(const std::string &vertexSource,
+                                     const std::string &fragmentSource);
+  static bool isComplete(const PendingProgram &pending);
+  // Checks the compile and link results, frees the stages and on failure
+  // the program
+  static bool finishCompile(PendingProgram &pending, CreateInfo &createInfo);
+  static bool checkCompileErrors(GLuint shaderId, const char *typeStr,
+                                 CreateInfo &createInfo);
   static bool checkLinkErrors(GLuint programId, CreateInfo &createInfo);
-  GLint getUniformLocation(std::string_view name) const;
+  void finishPending() const;
+  // No program exists yet, uniforms and blocks can only be recorded
+  bool isFirstCompilePending() const {
+    return m_id == 0 && m_pending.program != 0;
+  }
+  // Looks the uniforms and blocks up in a newly swapped in program and
+  // sets the values the old one had
+  void restoreUniforms() const;
+  void release();
+  Uniform &getUniform(std::string_view name) const;
+  bool setUniformValue(std::string_view name, UniformType type,
+                       const void *data, GLsizei count) const;
+  static void applyUniform(const Uniform &uniform);
 };
 
 } // namespace ste
\ No newline at end of file
@@ -1,6 +1,8 @@
 // texture.cpp
 #include "texture.h"
 
+#include "gl_state.h"
+
 namespace ste {
 
 std::optional<Texture> Texture::createFromFile(const std::string &path,
@@ -58,7 +60,7 @@ std::optional<Texture> Texture::createFromSurface(SDL_Surface *surface,
   // Generate OpenGL texture
   GLuint textureId;
   glGenTextures(1, &textureId);
-  glBindTexture(GL_TEXTURE_2D, textureId);
+  GLStateCache::get().bindTexture(textureId);
 
   // Set texture parameters
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, createInfo.wrapS);
@@ -79,6 +81,7 @@ std::optional<Texture> Texture::createFromSurface(SDL_Surface *surface,
     format = GL_RED;
     break;
   default:
+    GLStateCache::get().onTextureDeleted(textureId);
     glDeleteTextures(1, &textureId);
     createInfo.success = false;
     createInfo.errorMsg = "Unsupported image format";
@@ -94,8 +97,6 @@ std::optional<Texture> Texture::createFromSurface(SDL_Surface *surface,
     glGenerateMipmap(GL_TEXTURE_2D);
   }
 
-  glBindTexture(GL_TEXTURE_2D, 0);
-
   return Texture(textureId, surface->w, surface->h);
 }
 
@@ -104,6 +105,7 @@ Texture::Texture(uint32_t id, int width, int height)
 
 Texture::~Texture() {
   if (m_id != 0) {
+    GLStateCache::get().onTextureDeleted(m_id);
     glDeleteTextures(1, &m_id);
   }
 }
@@ -116,6 +118,7 @@ Texture::Texture(Texture &&other) noexcept
 Texture &Texture::operator=(Texture &&other) noexcept {
   if (this != &other) {
     if (m_id != 0) {
+      GLStateCache::get().onTextureDeleted(m_id);
       glDeleteTextures(1, &m_id);
     }
     m_id = other.m_id;
@@ -127,10 +130,9 @@ Texture &Texture::operator=(Texture &&other) noexcept {
 }
 
 void Texture::bind(uint32_t slot) const {
-  glActiveTexture(GL_TEXTURE0 + slot);
-  glBindTexture(GL_TEXTURE_2D, m_id);
+  GLStateCache::get().bindTexture(slot, m_id);
 }
 
-void Texture::unbind() const { glBindTexture(GL_TEXTURE_2D, 0); }
+void Texture::unbind() const { GLStateCache::get().bindTexture(0); }
 
 } // namespace ste
\ No newline at end of file
@@ -0,0 +1,401 @@
+#include "tilemap_renderer.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <glad/glad.h>
+
+#include "gl_render_backend.h"
+#include "gl_state.h"
+#include "render_profiler.h"
+
+namespace ste {
+
+namespace {
+constexpr uint32_t ATLAS_UNIT = 0;
+constexpr uint32_t INDEX_UNIT = 1;
+constexpr uint32_t CHUNK_ATTRIBUTE = 0;
+
+const char *tilemapVertexShaderSource = R"(
+        #version 330 core
+        layout (std140) uniform SceneData {
+            mat4 u_ViewProjection;
+        };
+
+        layout (location = 0) in vec3 a_Chunk; // origin, texture array layer
+
+        uniform vec2 u_ChunkExtent;
+
+        out vec2 v_Local;
+        flat out int v_Layer;
+
+        const vec2 corners[4] = vec2[](vec2(0.0, 0.0), vec2(1.0, 0.0),
+                                       vec2(0.0, 1.0), vec2(1.0, 1.0));
+
+        void main() {
+            v_Local = corners[gl_VertexID] * u_ChunkExtent;
+            v_Layer = int(a_Chunk.z);
+            gl_Position = u_ViewProjection * vec4(a_Chunk.xy + v_Local,
+                                                  0.0, 1.0);
+        }
+    )";
+
+const char *tilemapFragmentShaderSource = R"(
+        #version 330 core
+        out vec4 FragColor;
+
+        in vec2 v_Local;
+        flat in int v_Layer;
+
+        uniform usampler2DArray u_TileIndices;
+        uniform sampler2D u_Atlas;
+        uniform vec2 u_TileSize;
+        uniform vec2 u_AtlasTiles;
+        uniform int u_HasAtlas;
+        uniform vec4 u_Tint;
+
+        void main() {
+            vec2 tileCoord = v_Local / u_TileSize;
+
+            // Gradients of the continuous coordinate, the fract() below
+            // would break them at every tile edge
+            vec2 gradX = dFdx(tileCoord) / u_AtlasTiles;
+            vec2 gradY = dFdy(tileCoord) / u_AtlasTiles;
+
+            ivec2 lastCell = textureSize(u_TileIndices, 0).xy - 1;
+            ivec2 cell = clamp(ivec2(floor(tileCoord)), ivec2(0), lastCell);
+            uint value = texelFetch(u_TileIndices, ivec3(cell, v_Layer), 0).r;
+            if (value == 0u) {
+                discard;
+            }
+
+            if (u_HasAtlas == 0) {
+                FragColor = u_Tint;
+                return;
+            }
+
+            float type = float(value - 1u);
+            vec2 atlasCell = vec2(mod(type, u_AtlasTiles.x),
+                                  floor(type / u_AtlasTiles.x));
+            vec2 uv = (atlasCell + fract(tileCoord)) / u_AtlasTiles;
+            FragColor = textureGrad(u_Atlas, uv, gradX, gradY) * u_Tint;
+        }
+    )";
+
+uint64_t chunkKey(const glm::ivec2 &coord) {
+  return (static_cast<uint64_t>(static_cast<uint32_t>(coord.x)) << 32) |
+         static_cast<uint32_t>(coord.y);
+}
+
+int floorDiv(int value, int divisor) {
+  return value >= 0 ? value / divisor : (value - divisor + 1) / divisor;
+}
+} // namespace
+
+std::shared_ptr<TilemapRenderer>
+TilemapRenderer::create(CreateInfo &createInfo) {
+  if (createInfo.tileSize.x <= 0.0f || createInfo.tileSize.y <= 0.0f ||
+      createInfo.atlasTiles.x <= 0 || createInfo.atlasTiles.y <= 0) {
+    createInfo.success = false;
+    createInfo.errorMsg = "Tile size and atlas dimensions must be positive";
+    return nullptr;
+  }
+
+  Shader::CreateInfo shaderInfo;
+  auto shader = Shader::createFromMemory(tilemapVertexShaderSource,
+                                         tilemapFragmentShaderSource,
+                                         shaderInfo);
+  if (!shader) {
+    createInfo.success = false;
+    createInfo.errorMsg = std::move(shaderInfo.errorMsg);
+    return nullptr;
+  }
+
+  shader->bindUniformBlock("SceneData", GLRenderBackend::SCENE_DATA_BINDING);
+  shader->use();
+  shader->setUniform("u_Atlas", static_cast<int>(ATLAS_UNIT));
+  shader->setUniform("u_TileIndices", static_cast<int>(INDEX_UNIT));
+  shader->setUniform("u_TileSize", createInfo.tileSize);
+  shader->setUniform("u_AtlasTiles", glm::vec2(createInfo.atlasTiles));
+  shader->setUniform("u_HasAtlas", createInfo.atlasTexture != 0 ? 1 : 0);
+
+  // Corners come from gl_VertexID, the only attribute is the per chunk
+  // instance data
+  auto &state = GLStateCache::get();
+  uint32_t vao, chunkBuffer;
+  glGenVertexArrays(1, &vao);
+  glGenBuffers(1, &chunkBuffer);
+  state.bindVertexArray(vao);
+  state.bindArrayBuffer(chunkBuffer);
+  glVertexAttribPointer(CHUNK_ATTRIBUTE, 3, GL_FLOAT, GL_FALSE,
+                        sizeof(ChunkInstance), (void *)0);
+  glVertexAttribDivisor(CHUNK_ATTRIBUTE, 1);
+
+  return std::make_shared<TilemapRenderer>(std::move(*shader), vao,
+                                           chunkBuffer, createInfo);
+}
+
+TilemapRenderer::TilemapRenderer(Shader &&shader, uint32_t vao,
+                                 uint32_t chunkBuffer,
+                                 const CreateInfo &createInfo)
+    : m_shader(std::move(shader)), m_VAO(vao), m_chunkBuffer(chunkBuffer),
+      m_tileSize(createInfo.tileSize),
+      m_atlasTexture(createInfo.atlasTexture),
+      m_atlasTiles(createInfo.atlasTiles) {
+  setMultiDrawIndirect(true);
+}
+
+TilemapRenderer::~TilemapRenderer() {
+  clear();
+
+  auto &state = GLStateCache::get();
+  state.onBufferDeleted(m_chunkBuffer);
+  glDeleteBuffers(1, &m_chunkBuffer);
+  state.onVertexArrayDeleted(m_VAO);
+  glDeleteVertexArrays(1, &m_VAO);
+}
+
+void TilemapRenderer::clear() {
+  auto &state = GLStateCache::get();
+  for (uint32_t page : m_pages) {
+    state.onTextureDeleted(page);
+    glDeleteTextures(1, &page);
+  }
+  m_pages.clear();
+  m_instances.clear();
+  m_layers.clear();
+}
+
+void TilemapRenderer::setMultiDrawIndirect(bool enabled) {
+  m_commands.setIndirectEnabled(enabled);
+
+  // The loop fallback sets the attribute's current value per draw instead
+  GLStateCache::get().bindVertexArray(m_VAO);
+  if (m_commands.isIndirectEnabled()) {
+    glEnableVertexAttribArray(CHUNK_ATTRIBUTE);
+  } else {
+    glDisableVertexAttribArray(CHUNK_ATTRIBUTE);
+  }
+}
+
+glm::ivec2 TilemapRenderer::getCell(const glm::vec2 &position) const {
+  return glm::ivec2(glm::floor(position / m_tileSize));
+}
+
+TilemapRenderer::ChunkLayer &TilemapRenderer::getLayer(const std::string &name,
+                                                       int depth) {
+  for (auto &layer : m_layers) {
+    if (layer.name == name) {
+      return layer;
+    }
+  }
+
+  // Keep the layers sorted so drawing needs no sort
+  auto it = std::upper_bound(
+      m_layers.begin(), m_layers.end(), depth,
+      [](int depth, const ChunkLayer &layer) { return depth < layer.depth; });
+  it = m_layers.insert(it, ChunkLayer{.name = name, .depth = depth});
+  return *it;
+}
+
+TilemapRenderer::Chunk &TilemapRenderer::getChunk(ChunkLayer &layer,
+                                                  const glm::ivec2 &coord) {
+  auto [it, inserted] = layer.chunks.try_emplace(chunkKey(coord));
+  if (inserted) {
+    it->second.coord = coord;
+    it->second.cells.assign(CHUNK_SIZE * CHUNK_SIZE, EMPTY_CELL);
+  }
+  return it->second;
+}
+
+void TilemapRenderer::allocateSlot(Chunk &chunk) {
+  const auto slot = static_cast<int32_t>(m_instances.size());
+  const int32_t layer = slot % CHUNKS_PER_PAGE;
+  if (layer == 0) {
+    uint32_t page;
+    glGenTextures(1, &page);
+    GLStateCache::get().bindTextureArray(INDEX_UNIT, page);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_R16UI, CHUNK_SIZE, CHUNK_SIZE,
+                 CHUNKS_PER_PAGE, 0, GL_RED_INTEGER, GL_UNSIGNED_SHORT,
+                 nullptr);
+    m_pages.push_back(page);
+  }
+
+  const glm::vec2 chunkExtent = m_tileSize * static_cast<float>(CHUNK_SIZE);
+  m_instances.push_back(ChunkInstance{
+      .origin = glm::vec2(chunk.coord) * chunkExtent,
+      .layer = static_cast<float>(layer),
+  });
+  m_instancesDirty = true;
+  chunk.slot = slot;
+}
+
+void TilemapRenderer::uploadChunk(Chunk &chunk) {
+  if (chunk.slot < 0) {
+    allocateSlot(chunk);
+  }
+
+  // Every allocated layer is uploaded whole once, pages start undefined
+  GLStateCache::get().bindTextureArray(
+      INDEX_UNIT, m_pages[chunk.slot / CHUNKS_PER_PAGE]);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+  glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, chunk.slot % CHUNKS_PER_PAGE,
+                  CHUNK_SIZE, CHUNK_SIZE, 1, GL_RED_INTEGER,
+                  GL_UNSIGNED_SHORT, chunk.cells.data());
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  m_stats.texelUploads += CHUNK_SIZE * CHUNK_SIZE;
+}
+
+void TilemapRenderer::build(const Map &map) {
+  clear();
+
+  // Fill the CPU side first, then upload each chunk once
+  for (const auto &layer : map.layers()) {
+    ChunkLayer &chunkLayer = getLayer(layer.getName(), layer.getDepth());
+    for (const auto &tile : layer.getTiles()) {
+      // Snap to the grid, larger tiles cover every cell they overlap
+      const glm::ivec2 first = getCell(tile.getPosition() + m_tileSize * 0.5f);
+      const glm::ivec2 count = glm::max(
+          glm::ivec2(glm::round(tile.getSize() / m_tileSize)), glm::ivec2(1));
+      const auto value = static_cast<uint16_t>(
+          std::min<Tile::Id>(tile.getTileType() + 1, UINT16_MAX));
+
+      for (int y = first.y; y < first.y + count.y; y++) {
+        for (int x = first.x; x < first.x + count.x; x++) {
+          const glm::ivec2 chunkCoord = {floorDiv(x, CHUNK_SIZE),
+                                         floorDiv(y, CHUNK_SIZE)};
+          Chunk &chunk = getChunk(chunkLayer, chunkCoord);
+          const glm::ivec2 local = glm::ivec2(x, y) - chunkCoord * CHUNK_SIZE;
+          chunk.cells[local.y * CHUNK_SIZE + local.x] = value;
+        }
+      }
+    }
+  }
+
+  for (auto &layer : m_layers) {
+    for (auto &[key, chunk] : layer.chunks) {
+      uploadChunk(chunk);
+    }
+  }
+}
+
+void TilemapRenderer::setTile(const std::string &layerName,
+                              const glm::ivec2 &cell,
+                              std::optional<Tile::Id> tileType,
+                              int layerDepth) {
+  const uint16_t value =
+      tileType ? static_cast<uint16_t>(
+                     std::min<Tile::Id>(*tileType + 1, UINT16_MAX))
+               : EMPTY_CELL;
+
+  ChunkLayer &layer = getLayer(layerName, layerDepth);
+  const glm::ivec2 chunkCoord = {floorDiv(cell.x, CHUNK_SIZE),
+                                 floorDiv(cell.y, CHUNK_SIZE)};
+  Chunk &chunk = getChunk(layer, chunkCoord);
+  const glm::ivec2 local = cell - chunkCoord * CHUNK_SIZE;
+  uint16_t &stored = chunk.cells[local.y * CHUNK_SIZE + local.x];
+  if (stored == value) {
+    return;
+  }
+  stored = value;
+
+  // New chunks upload whole, edits only touch the changed texel
+  if (chunk.slot < 0) {
+    uploadChunk(chunk);
+    return;
+  }
+
+  GLStateCache::get().bindTextureArray(
+      INDEX_UNIT, m_pages[chunk.slot / CHUNKS_PER_PAGE]);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+  glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, local.x, local.y,
+                  chunk.slot % CHUNKS_PER_PAGE, 1, 1, 1, GL_RED_INTEGER,
+                  GL_UNSIGNED_SHORT, &stored);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  m_stats.texelUploads++;
+}
+
+void TilemapRenderer::setTileAt(const std::string &layerName,
+                                const glm::vec2 &position,
+                                std::optional<Tile::Id> tileType,
+                                int layerDepth) {
+  setTile(layerName, getCell(position), tileType, layerDepth);
+}
+
+void TilemapRenderer::submitCommands(const PageRun &run) {
+  GLStateCache::get().bindTextureArray(INDEX_UNIT, m_pages[run.page]);
+  m_stats.drawCalls += m_commands.submit(
+      GL_TRIANGLE_STRIP, run.first, run.count,
+      [this](const IndirectDrawBuffer::Command &command) {
+        const ChunkInstance &instance = m_instances[command.baseInstance];
+        glVertexAttrib3f(CHUNK_ATTRIBUTE, instance.origin.x,
+                         instance.origin.y, instance.layer);
+      });
+}
+
+void TilemapRenderer::draw(const AABB &viewBounds, const glm::vec4 &tint) {
+  RenderProfiler::Scope scope("Tilemap");
+  auto &state = GLStateCache::get();
+
+  m_shader.use();
+  m_shader.setUniform("u_Tint", tint);
+  state.bindVertexArray(m_VAO);
+  state.setBlendMode(BlendMode::Alpha);
+  if (m_atlasTexture != 0) {
+    state.bindTexture(ATLAS_UNIT, m_atlasTexture);
+  }
+
+  const glm::vec2 chunkExtent = m_tileSize * static_cast<float>(CHUNK_SIZE);
+  m_shader.setUniform("u_ChunkExtent", chunkExtent);
+
+  // Instance data only changes when chunks are added
+  if (m_instancesDirty && m_commands.isIndirectEnabled()) {
+    RenderProfiler::CpuTimer timer(RenderProfiler::CpuCounter::Upload);
+    state.bindArrayBuffer(m_chunkBuffer);
+    glBufferData(GL_ARRAY_BUFFER, m_instances.size() * sizeof(ChunkInstance),
+                 m_instances.data(), GL_STATIC_DRAW);
+    m_instancesDirty = false;
+  }
+
+  // One command per visible chunk, a run of chunks on the same page is
+  // submitted together. Chunks of a layer don't overlap, sorting them by
+  // slot keeps the runs long while the layers stay in order.
+  m_commands.clear();
+  m_pageRuns.clear();
+  for (const auto &layer : m_layers) {
+    m_visibleSlots.clear();
+    for (const auto &[key, chunk] : layer.chunks) {
+      const glm::vec2 origin = glm::vec2(chunk.coord) * chunkExtent;
+      if (chunk.slot < 0 ||
+          !viewBounds.intersects(AABB(origin, origin + chunkExtent))) {
+        m_stats.culledChunks++;
+        continue;
+      }
+      m_visibleSlots.push_back(chunk.slot);
+    }
+    std::sort(m_visibleSlots.begin(), m_visibleSlots.end());
+
+    for (int32_t slot : m_visibleSlots) {
+      const int32_t page = slot / CHUNKS_PER_PAGE;
+      if (m_pageRuns.empty() || m_pageRuns.back().page != page) {
+        m_pageRuns.push_back({.page = page, .first = m_commands.size()});
+      }
+      m_pageRuns.back().count++;
+      m_commands.add({.count = 4,
+                      .instanceCount = 1,
+                      .first = 0,
+                      .baseInstance = static_cast<uint32_t>(slot)});
+    }
+    m_stats.chunksDrawn += static_cast<uint32_t>(m_visibleSlots.size());
+  }
+
+  for (const auto &run : m_pageRuns) {
+    submitCommands(run);
+  }
+}
+
+} // namespace ste
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "engine/world/map/map.h"
+#include "indirect_draw.h"
+#include "shader.h"
+
+namespace ste {
+
+// Draws grid aligned Map layers on the GPU. Every layer is split into
+// CHUNK_SIZE x CHUNK_SIZE chunks whose tile types live in a layer of an
+// integer texture array, a chunk is one quad and the fragment shader
+// resolves each pixel's tile through the atlas. Vertex work doesn't depend
+// on the tile count and editing a tile uploads a single texel.
+//
+// Visible chunks are recorded as indirect draw commands, with multi-draw
+// indirect all chunks sharing a page of the texture array are one draw call.
+class TilemapRenderer {
+public:
+  static constexpr int CHUNK_SIZE = 64;
+  // Texture array layers allocated at once, 512 KiB of R16UI texels
+  static constexpr int CHUNKS_PER_PAGE = 64;
+
+  struct CreateInfo {
+    std::string errorMsg;
+    bool success = true;
+    glm::vec2 tileSize{32.0f, 32.0f};
+    // Atlas with tile type N in cell N, laid out left to right, top to
+    // bottom. Without an atlas tiles are drawn in a solid color.
+    uint32_t atlasTexture = 0;
+    glm::ivec2 atlasTiles{1, 1}; // columns, rows
+  };
+
+  struct Statistics {
+    uint32_t drawCalls = 0;
+    uint32_t chunksDrawn = 0;
+    uint32_t culledChunks = 0;
+    uint32_t texelUploads = 0;
+  };
+
+  static std::shared_ptr<TilemapRenderer> create(CreateInfo &createInfo);
+
+  TilemapRenderer(Shader &&shader, uint32_t vao, uint32_t chunkBuffer,
+                  const CreateInfo &createInfo);
+  ~TilemapRenderer();
+  TilemapRenderer(const TilemapRenderer &) = delete;
+  TilemapRenderer &operator=(const TilemapRenderer &) = delete;
+
+  // Rebuilds all chunks from the map, tiles are snapped to the grid
+  void build(const Map &map);
+  void clear();
+
+  // Single tile edits, nullopt clears the cell
+  void setTile(const std::string &layerName, const glm::ivec2 &cell,
+               std::optional<Tile::Id> tileType, int layerDepth = 0);
+  void setTileAt(const std::string &layerName, const glm::vec2 &position,
+                 std::optional<Tile::Id> tileType, int layerDepth = 0);
+  glm::ivec2 getCell(const glm::vec2 &position) const;
+
+  // Draws the chunks overlapping `viewBounds`, layers in depth order. Uses
+  // the camera of the current Renderer2D scene, quads batched before are
+  // not flushed first.
+  void draw(const AABB &viewBounds, const glm::vec4 &tint = {1.0f, 1.0f, 1.0f,
+                                                              1.0f});
+
+  // Falls back to one draw per chunk when disabled or unsupported
+  void setMultiDrawIndirect(bool enabled);
+  bool isMultiDrawIndirect() const { return m_commands.isIndirectEnabled(); }
+
+  void resetStats() { m_stats = Statistics(); }
+  Statistics getStats() const { return m_stats; }
+
+private:
+  // Texel value of an empty cell, tile types are stored plus one
+  static constexpr uint16_t EMPTY_CELL = 0;
+
+  struct Chunk {
+    glm::ivec2 coord;
+    // Index into the texture array pages, page * CHUNKS_PER_PAGE + layer
+    int32_t slot = -1;
+    std::vector<uint16_t> cells;
+  };
+
+  // Per chunk vertex data, read through the draw's base instance
+  struct ChunkInstance {
+    glm::vec2 origin;
+    float layer;
+  };
+
+  // Consecutive draw commands whose chunks share a page
+  struct PageRun {
+    int32_t page;
+    size_t first;
+    size_t count = 0;
+  };
+
+  struct ChunkLayer {
+    std::string name;
+    int depth = 0;
+    std::unordered_map<uint64_t, Chunk> chunks;
+  };
+
+  ChunkLayer &getLayer(const std::string &name, int depth);
+  Chunk &getChunk(ChunkLayer &layer, const glm::ivec2 &chunkCoord);
+  void allocateSlot(Chunk &chunk);
+  void uploadChunk(Chunk &chunk);
+  void submitCommands(const PageRun &run);
+
+  Shader m_shader;
+  uint32_t m_VAO{0};
+  uint32_t m_chunkBuffer{0};
+  glm::vec2 m_tileSize;
+  uint32_t m_atlasTexture;
+  glm::ivec2 m_atlasTiles;
+
+  // Sorted by depth
+  std::vector<ChunkLayer> m_layers;
+  std::vector<uint32_t> m_pages; // texture arrays
+  std::vector<ChunkInstance> m_instances; // by slot
+  bool m_instancesDirty{false};
+  IndirectDrawBuffer m_commands;
+  std::vector<PageRun> m_pageRuns;
+  std::vector<int32_t> m_visibleSlots;
+  Statistics m_stats{};
+};
+
+} // namespace ste
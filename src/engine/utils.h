@@ -2,6 +2,7 @@
 
 #include <cinttypes>
 #include <string>
+#include <string_view>
 
 // Sized type aliases
 using u8 = unsigned char;
@@ -26,4 +27,52 @@ inline std::string getAssetPath(const std::string &filename) noexcept {
   return std::string(ASSET_PATH) + "/" + filename;
 }
 
+// Decodes the UTF-8 sequence at `offset` and moves past it. Malformed,
+// overlong or truncated sequences decode to U+FFFD and skip one byte.
+inline uint32_t decodeUtf8(std::string_view text, size_t &offset) noexcept {
+  constexpr uint32_t REPLACEMENT = 0xFFFD;
+  const auto lead = static_cast<uint8_t>(text[offset++]);
+  if (lead < 0x80) {
+    return lead;
+  }
+
+  size_t length;
+  uint32_t codepoint;
+  uint32_t minimum; // smaller values are overlong
+  if ((lead & 0xE0) == 0xC0) {
+    length = 1;
+    codepoint = lead & 0x1F;
+    minimum = 0x80;
+  } else if ((lead & 0xF0) == 0xE0) {
+    length = 2;
+    codepoint = lead & 0x0F;
+    minimum = 0x800;
+  } else if ((lead & 0xF8) == 0xF0) {
+    length = 3;
+    codepoint = lead & 0x07;
+    minimum = 0x10000;
+  } else {
+    return REPLACEMENT;
+  }
+
+  if (offset + length > text.size()) {
+    return REPLACEMENT;
+  }
+  for (size_t i = 0; i < length; i++) {
+    const auto byte = static_cast<uint8_t>(text[offset + i]);
+    if ((byte & 0xC0) != 0x80) {
+      return REPLACEMENT;
+    }
+    codepoint = (codepoint << 6) | (byte & 0x3F);
+  }
+  // Surrogates are only valid in UTF-16
+  if (codepoint < minimum || codepoint > 0x10FFFF ||
+      (codepoint >= 0xD800 && codepoint <= 0xDFFF)) {
+    return REPLACEMENT;
+  }
+
+  offset += length;
+  return codepoint;
+}
+
 } // namespace ste
\ No newline at end of file
@@ -7,6 +7,7 @@
 #include <functional>
 #include <limits>
 #include <memory>
+#include <span>
 #include <string>
 #include <type_traits>
 #include <typeindex>
@@ -169,6 +170,9 @@ public:
   auto end() { return dense_components.end(); }
   const auto &entities() const { return dense_entities; }
 
+  // Contiguous storage, index i belongs to entities()[i]
+  std::span<T> components() { return dense_components; }
+
 private:
   std::vector<T> dense_components;
   std::vector<size_t> dense_entities;
@@ -220,6 +224,15 @@ public:
         ->has(entityId);
   }
 
+  // Dense storage of a component type for systems that process every
+  // instance in one pass, nullptr if no entity ever had the component
+  template <Component T> ComponentArray<T> *getComponentArray() {
+    auto it = components.find(ComponentId::get<T>());
+    if (it == components.end())
+      return nullptr;
+    return static_cast<ComponentArray<T> *>(it->second.get());
+  }
+
   template <Resource T> void addResource(std::shared_ptr<T> resource) {
     resources[std::type_index(typeid(T))] = resource;
   }
@@ -0,0 +1,188 @@
+#include "sprite_animation.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "engine/rendering/renderer_2d.h"
+
+namespace ste {
+
+std::optional<SpriteAnimationLibrary::ClipId>
+SpriteAnimationLibrary::addClip(const ClipDesc &desc) {
+  if (desc.frames.empty() || m_clipNames.contains(desc.name)) {
+    return std::nullopt;
+  }
+
+  Clip clip{};
+  clip.firstFrame = static_cast<uint32_t>(m_frameTexCoords.size());
+  clip.frameCount = static_cast<uint32_t>(desc.frames.size());
+  clip.textureId = desc.textureId;
+  clip.loopMode = desc.loopMode;
+  clip.uniformFrameDuration = desc.frames.front().duration;
+
+  float endTime = 0.0f;
+  for (const auto &frame : desc.frames) {
+    const float duration = std::max(frame.duration, 0.0f);
+    if (duration != clip.uniformFrameDuration) {
+      clip.uniformFrameDuration = 0.0f;
+    }
+
+    endTime += duration;
+    m_frameTexCoords.push_back(frame.texCoords);
+    m_frameEndTimes.push_back(endTime);
+  }
+  clip.duration = endTime;
+
+  const auto id = static_cast<ClipId>(m_clips.size());
+  m_clips.push_back(clip);
+  m_clipNames.emplace(desc.name, id);
+  return id;
+}
+
+std::optional<SpriteAnimationLibrary::ClipId>
+SpriteAnimationLibrary::findClip(const std::string &name) const {
+  auto it = m_clipNames.find(name);
+  if (it == m_clipNames.end()) {
+    return std::nullopt;
+  }
+  return it->second;
+}
+
+std::vector<SpriteAnimationLibrary::Frame>
+SpriteAnimationLibrary::gridFrames(int sheetWidth, int sheetHeight,
+                                   int frameWidth, int frameHeight,
+                                   int firstFrame, int frameCount,
+                                   float frameDuration) {
+  std::vector<Frame> frames;
+  if (sheetWidth <= 0 || sheetHeight <= 0 || frameWidth <= 0 ||
+      frameHeight <= 0) {
+    return frames;
+  }
+
+  const int columns = std::max(sheetWidth / frameWidth, 1);
+  const glm::vec2 frameSize = {
+      static_cast<float>(frameWidth) / static_cast<float>(sheetWidth),
+      static_cast<float>(frameHeight) / static_cast<float>(sheetHeight)};
+
+  frames.reserve(frameCount);
+  for (int i = firstFrame; i < firstFrame + frameCount; i++) {
+    const glm::vec2 min = {(i % columns) * frameSize.x,
+                           (i / columns) * frameSize.y};
+    frames.push_back({.texCoords = {min.x, min.y, min.x + frameSize.x,
+                                    min.y + frameSize.y},
+                      .duration = frameDuration});
+  }
+  return frames;
+}
+
+uint32_t SpriteAnimationLibrary::frameAt(ClipId clip, float time) const {
+  const Clip &data = m_clips[clip];
+  time = std::max(time, 0.0f);
+
+  if (data.uniformFrameDuration > 0.0f) {
+    return std::min(static_cast<uint32_t>(time / data.uniformFrameDuration),
+                    data.frameCount - 1);
+  }
+
+  const auto begin = m_frameEndTimes.begin() + data.firstFrame;
+  const auto end = begin + data.frameCount;
+  const auto it = std::upper_bound(begin, end, time);
+  return std::min(static_cast<uint32_t>(it - begin), data.frameCount - 1);
+}
+
+namespace {
+float wrap(float time, float period) {
+  if (period <= 0.0f) {
+    return 0.0f;
+  }
+  time = std::fmod(time, period);
+  return time < 0.0f ? time + period : time;
+}
+} // namespace
+
+void updateSpriteAnimations(World &world) {
+  auto *animations = world.getComponentArray<SpriteAnimation>();
+  if (!animations || animations->size() == 0) {
+    return;
+  }
+
+  const float deltaSeconds = world.getResource<Time>()->deltaSeconds;
+  const auto &library = *world.getResource<SpriteAnimationLibrary>();
+  const auto &clips = library.m_clips;
+  std::span<SpriteAnimation> states = animations->components();
+
+  // Advance all timers first, a branch free loop over the dense component
+  // storage
+  for (auto &state : states) {
+    state.time += deltaSeconds * state.speed;
+  }
+
+  // Then apply the loop mode and look the frame up in the clip tables
+  for (auto &state : states) {
+    if (state.clip >= clips.size()) {
+      continue;
+    }
+
+    const auto &clip = clips[state.clip];
+    float localTime = state.time;
+    switch (clip.loopMode) {
+    case AnimationLoopMode::Once:
+      state.time = std::clamp(state.time, 0.0f, clip.duration);
+      state.finished = state.speed >= 0.0f ? state.time >= clip.duration
+                                           : state.time <= 0.0f;
+      localTime = state.time;
+      break;
+
+    case AnimationLoopMode::Loop:
+      state.time = wrap(state.time, clip.duration);
+      localTime = state.time;
+      break;
+
+    case AnimationLoopMode::PingPong:
+      state.time = wrap(state.time, clip.duration * 2.0f);
+      localTime = state.time <= clip.duration
+                      ? state.time
+                      : clip.duration * 2.0f - state.time;
+      break;
+    }
+
+    state.frame =
+        static_cast<uint16_t>(library.frameAt(state.clip, localTime));
+  }
+}
+
+void renderSpriteAnimations(World &world, Renderer2D &renderer) {
+  auto *animations = world.getComponentArray<SpriteAnimation>();
+  auto *sprites = world.getComponentArray<Sprite>();
+  if (!animations || !sprites) {
+    return;
+  }
+
+  const auto &library = *world.getResource<SpriteAnimationLibrary>();
+  std::span<SpriteAnimation> states = animations->components();
+  const auto &entities = animations->entities();
+
+  // Reused from frame to frame, per thread as worlds sharing a library may
+  // render concurrently
+  static thread_local std::vector<Renderer2D::QuadDesc> quads;
+  quads.clear();
+  for (size_t i = 0; i < states.size(); i++) {
+    const auto &state = states[i];
+    if (state.clip >= library.getClipCount() || !sprites->has(entities[i])) {
+      continue;
+    }
+
+    const Sprite &sprite = sprites->get(entities[i]);
+    quads.push_back({.position = sprite.position,
+                     .size = sprite.size,
+                     .color = sprite.tint,
+                     .origin = sprite.origin,
+                     .texCoords = library.getTexCoords(state.clip, state.frame),
+                     .rotation = sprite.rotation,
+                     .textureId = library.getTextureId(state.clip)});
+  }
+
+  renderer.drawQuads(quads);
+}
+
+} // namespace ste
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "ecs.h"
+
+namespace ste {
+
+class Renderer2D;
+
+enum class AnimationLoopMode : uint8_t { Once, Loop, PingPong };
+
+// Clip data shared by every animated entity, stored in flat tables indexed
+// by clip id. Clips are immutable once added, so ids stay valid and the
+// library can be shared between worlds.
+class SpriteAnimationLibrary {
+public:
+  using ClipId = uint32_t;
+
+  struct Frame {
+    glm::vec4 texCoords{0.0f, 0.0f, 1.0f, 1.0f}; // min uv, max uv
+    float duration = 0.1f;                       // seconds
+  };
+
+  struct ClipDesc {
+    std::string name;
+    uint32_t textureId = 0;
+    std::vector<Frame> frames;
+    AnimationLoopMode loopMode = AnimationLoopMode::Loop;
+  };
+
+  // Returns nullopt if the clip has no frames or the name is taken
+  std::optional<ClipId> addClip(const ClipDesc &desc);
+  std::optional<ClipId> findClip(const std::string &name) const;
+
+  // Frames laid out left to right, top to bottom on a uniform grid
+  static std::vector<Frame> gridFrames(int sheetWidth, int sheetHeight,
+                                       int frameWidth, int frameHeight,
+                                       int firstFrame, int frameCount,
+                                       float frameDuration);
+
+  size_t getClipCount() const { return m_clips.size(); }
+  uint32_t getTextureId(ClipId clip) const { return m_clips[clip].textureId; }
+  float getDuration(ClipId clip) const { return m_clips[clip].duration; }
+  uint32_t getFrameCount(ClipId clip) const {
+    return m_clips[clip].frameCount;
+  }
+
+  // Frame index within the clip at a local time in [0, duration]
+  uint32_t frameAt(ClipId clip, float time) const;
+  const glm::vec4 &getTexCoords(ClipId clip, uint32_t frame) const {
+    return m_frameTexCoords[m_clips[clip].firstFrame + frame];
+  }
+
+private:
+  struct Clip {
+    uint32_t firstFrame;
+    uint32_t frameCount;
+    uint32_t textureId;
+    AnimationLoopMode loopMode;
+    float duration;
+    // Set when every frame lasts the same, the frame is then a division
+    // instead of a search
+    float uniformFrameDuration;
+  };
+
+  friend void updateSpriteAnimations(World &world);
+
+  std::vector<Clip> m_clips;
+  // Frame tables shared by all clips, a clip owns a contiguous range
+  std::vector<glm::vec4> m_frameTexCoords;
+  std::vector<float> m_frameEndTimes; // cumulative within the clip
+  std::unordered_map<std::string, ClipId> m_clipNames;
+};
+
+// Per-entity playback state, the clip data itself lives in the library.
+// Kept at 16 bytes so four states share a cache line.
+struct SpriteAnimation {
+  SpriteAnimationLibrary::ClipId clip = 0;
+  float time = 0.0f;
+  float speed = 1.0f; // 0 pauses
+  uint16_t frame = 0;
+  bool finished = false;
+};
+
+static_assert(sizeof(SpriteAnimation) == 16);
+
+// Where an animated sprite is drawn
+struct Sprite {
+  glm::vec3 position{0.0f};
+  glm::vec2 size{1.0f, 1.0f};
+  glm::vec2 origin{0.0f, 0.0f};
+  glm::vec4 tint{1.0f, 1.0f, 1.0f, 1.0f};
+  float rotation = 0.0f;
+};
+
+// Advances every SpriteAnimation by the Time resource and resolves its
+// frame. Requires a SpriteAnimationLibrary resource, register as an update
+// system: world.addSystem("sprite_animation", updateSpriteAnimations)
+void updateSpriteAnimations(World &world);
+
+// Submits all entities with Sprite and SpriteAnimation as one batched
+// drawQuads call, inside the caller's beginScene/endScene
+void renderSpriteAnimations(World &world, Renderer2D &renderer);
+
+} // namespace ste
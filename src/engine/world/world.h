@@ -2,4 +2,5 @@
 
 #include "ecs.h"
 #include "map.h"
-#include "quadtree.h"
\ No newline at end of file
+#include "quadtree.h"
+#include "sprite_animation.h"
\ No newline at end of file